@@ -1,8 +1,9 @@
-QT += core gui network multimedia winextras
+QT += core gui network multimedia
+win32: QT += winextras
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
-CONFIG += c++11
+CONFIG += c++14
 
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
@@ -12,26 +13,84 @@ RESOURCES += resource.qrc
 
 SOURCES += \
     addaddressdialog.cpp \
+    addressfiltermodel.cpp \
+    addressformat.cpp \
+    addresslistmodel.cpp \
+    addressquery.cpp \
+    addresssearchindex.cpp \
+    benchmark.cpp \
+    captureservice.cpp \
     customaddresslistwidget.cpp \
+    devicelister.cpp \
+    driftchecker.cpp \
+    driftdetector.cpp \
     firewalltool.cpp \
     iptool.cpp \
+    ipv4address.cpp \
     main.cpp \
     mainwindow.cpp \
+    memoryfirewalltool.cpp \
+    metrics.cpp \
+    metricsserver.cpp \
+    pcapresource.cpp \
+    replayharness.cpp \
+    scopebuilder.cpp \
+    scopetool.cpp \
     selectdevicedialog.cpp \
     sessiondialog.cpp \
+    sessiontracker.cpp \
+    settingsstore.cpp \
+    settingswriter.cpp \
     sniffer.cpp \
-    snifferthread.cpp
+    snifferthread.cpp \
+    tracing.cpp \
+    whitelistfile.cpp
 
 HEADERS += \
     addaddressdialog.h \
+    addressfiltermodel.h \
+    addressformat.h \
+    addresslistmodel.h \
+    addressquery.h \
+    addresssearchindex.h \
+    benchmark.h \
+    captureservice.h \
     customaddresslistwidget.h \
+    devicelister.h \
+    driftchecker.h \
+    driftdetector.h \
     firewalltool.h \
     iptool.h \
+    ipv4address.h \
+    ipv6address.h \
     mainwindow.h \
+    memoryfirewalltool.h \
+    metrics.h \
+    metricsserver.h \
+    pcapresource.h \
+    replayharness.h \
+    reservedranges.h \
+    scopebuilder.h \
+    scopetool.h \
     selectdevicedialog.h \
     sessiondialog.h \
+    sessiontracker.h \
+    settingsstore.h \
+    settingswriter.h \
     sniffer.h \
-    snifferthread.h
+    snifferthread.h \
+    tracing.h \
+    whitelistfile.h
+
+win32 {
+    SOURCES += windowsfirewalltool.cpp
+    HEADERS += windowsfirewalltool.h
+}
+
+unix {
+    SOURCES += nftablesfirewalltool.cpp
+    HEADERS += nftablesfirewalltool.h
+}
 
 FORMS += \
     addaddressdialog.ui \
@@ -44,10 +103,14 @@ qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
-LIBS += -L$$PWD/../../Downloads/npcap-sdk-1.06/Lib/x64/ -lPacket -lwpcap
-INCLUDEPATH += $$PWD/../../Downloads/npcap-sdk-1.06/Include
+win32 {
+    LIBS += -L$$PWD/../../Downloads/npcap-sdk-1.06/Lib/x64/ -lPacket -lwpcap
+    INCLUDEPATH += $$PWD/../../Downloads/npcap-sdk-1.06/Include
+
+    LIBS += -lws2_32 -lole32 -loleaut32 -lcomsuppw
+}
 
-LIBS += -lws2_32 -lole32 -loleaut32 -lcomsuppw
+unix: LIBS += -lpcap
 
 RC_ICONS = icons/icon.ico
 
@@ -1,21 +1,23 @@
 #include "addaddressdialog.h"
 #include "ui_addaddressdialog.h"
 
-AddAddressDialog::AddAddressDialog(QWidget *parent) :
+AddAddressDialog::AddAddressDialog(CaptureService *captureService, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::AddAddressDialog)
 {
     ui->setupUi(this);
 
+    this->captureService = captureService;
+
     insertLineEdit = ui->insertLineEdit;
     insertPushButton = ui->insertPushButton;
     sessionPushButton = ui->sessionPushButton;
-    addressListWidget = ui->addressListWidget;
+    addressListView = ui->addressListView;
     selectCountLabel = ui->selectCountLabel;
 
-    customAddressListWidget = new CustomAddressListWidget(addressListWidget, selectCountLabel, true, this);
+    customAddressListWidget = new CustomAddressListWidget(addressListView, selectCountLabel, true, this);
 
-    QRegularExpression re(IP_PATTERN);
+    QRegularExpression re(ADDRESS_INPUT_PATTERN);
     QValidator *validator = new QRegularExpressionValidator(re, this);
     insertLineEdit->setValidator(validator);
 
@@ -55,35 +57,30 @@ void AddAddressDialog::onInsertButtonClicked(bool checked)
 
 void AddAddressDialog::onSessionButtonClicked(bool checked)
 {
-    Sniffer *sniffer = new Sniffer(this);
-
-    SelectDeviceDialog selectDeviceDialog(sniffer, this);
+    SelectDeviceDialog selectDeviceDialog(captureService->getSniffer(), this);
+    selectDeviceDialog.setSelectedDevice(captureService->getDevice());
     if (selectDeviceDialog.exec() == QDialog::Accepted) {
         QString deviceName = selectDeviceDialog.getSelectedDevice();
 
         if (!deviceName.isEmpty()) {
-            SessionDialog sessionDialog(sniffer, deviceName, this);
+            SessionDialog sessionDialog(captureService, deviceName, this);
             if (sessionDialog.exec() == QDialog::Accepted) {
-                QStringList addresses = sessionDialog.getSelectedAddresses();
-                for (int i = 0; i < addresses.count(); i += 1) {
-                    insertAddressToList(addresses[i]);
+                QStringList duplicates;
+                QStringList invalid;
+                QStringList added = customAddressListWidget->addAddressesToList(sessionDialog.getSelectedAddresses(), &duplicates, &invalid);
+
+                QString report = CustomAddressListWidget::getAddReport(added.count(), duplicates, invalid);
+                if (!report.isEmpty()) {
+                    QMessageBox::information(this, "Information", report);
                 }
             }
         }
     }
-
-    sniffer->deleteLater();
 }
 
 bool AddAddressDialog::isAddressInList(QString address)
 {
-    for (int i = 0; i < addressListWidget->count(); i += 1) {
-        if (QString::compare(addressListWidget->item(i)->text(), address, Qt::CaseSensitive) == 0) {
-            return true;
-        }
-    }
-
-    return false;
+    return customAddressListWidget->containsAddress(address);
 }
 
 void AddAddressDialog::insertAddressToList(QString address)
@@ -99,6 +96,9 @@ void AddAddressDialog::insertAddressToList(QString address)
         return;
     }
 
+    // IPv6 addresses have many spellings, keep the canonical one so duplicates are found
+    address = AddressFormat::toString(IPTool::getAnyQHostAddress(address));
+
     if (isAddressInList(address)) {
         QString text = QString("IP Address already exists - %1").arg(address);
         QMessageBox::information(this, "Information", text);
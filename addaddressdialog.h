@@ -1,11 +1,12 @@
 #include <QDialog>
 #include <QLineEdit>
 #include <QPushButton>
-#include <QListWidget>
+#include <QListView>
 #include <QKeyEvent>
 #include <QRegularExpression>
 
 #include "sniffer.h"
+#include "captureservice.h"
 #include "sessiondialog.h"
 #include "selectdevicedialog.h"
 #include "iptool.h"
@@ -23,16 +24,17 @@ class AddAddressDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit AddAddressDialog(QWidget *parent = nullptr);
+    explicit AddAddressDialog(CaptureService *captureService, QWidget *parent = nullptr);
     ~AddAddressDialog();
     QStringList getAddresses();
 
 private:
     Ui::AddAddressDialog *ui;
+    CaptureService *captureService;
     QLineEdit *insertLineEdit;
     QPushButton *insertPushButton;
     QPushButton *sessionPushButton;
-    QListWidget *addressListWidget;
+    QListView *addressListView;
     QLabel *selectCountLabel;
     CustomAddressListWidget *customAddressListWidget;
 
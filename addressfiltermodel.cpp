@@ -0,0 +1,209 @@
+#include "addressfiltermodel.h"
+
+#include <algorithm>
+#include <climits>
+
+AddressFilterModel::AddressFilterModel(AddressListModel *model, QObject *parent) : QAbstractProxyModel(parent)
+{
+    this->model = model;
+
+    searchIndex = new AddressSearchIndex(model, this);
+
+    setSourceModel(model);
+
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &AddressFilterModel::onSourceAboutToChange);
+    connect(model, &QAbstractItemModel::modelReset, this, &AddressFilterModel::onSourceChanged);
+    connect(model, &QAbstractItemModel::rowsAboutToBeInserted, this, &AddressFilterModel::onSourceRowsAboutToBeInserted);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &AddressFilterModel::onSourceRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &AddressFilterModel::onSourceRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &AddressFilterModel::onSourceRowsRemoved);
+    connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this, &AddressFilterModel::onSourceLayoutAboutToChange);
+    connect(model, &QAbstractItemModel::layoutChanged, this, &AddressFilterModel::onSourceLayoutChanged);
+}
+
+QModelIndex AddressFilterModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid()) {
+        return QModelIndex();
+    }
+
+    if (!isFiltered()) {
+        return model->index(proxyIndex.row(), 0);
+    }
+
+    // offsets holds the first proxy row of every range
+    int rangeIndex = (std::upper_bound(offsets.constBegin(), offsets.constEnd(), proxyIndex.row()) - offsets.constBegin()) - 1;
+    if (rangeIndex < 0 || rangeIndex >= ranges.count()) {
+        return QModelIndex();
+    }
+
+    return model->index(ranges[rangeIndex].first + (proxyIndex.row() - offsets[rangeIndex]), 0);
+}
+
+QModelIndex AddressFilterModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid()) {
+        return QModelIndex();
+    }
+
+    int row = sourceIndex.row();
+    if (!isFiltered()) {
+        return index(row, 0);
+    }
+
+    QVector<RowRange>::const_iterator it = std::upper_bound(ranges.constBegin(), ranges.constEnd(), RowRange(row, INT_MAX));
+    if (it == ranges.constBegin()) {
+        return QModelIndex();
+    }
+
+    int rangeIndex = (it - ranges.constBegin()) - 1;
+    if (row > ranges[rangeIndex].second) {
+        return QModelIndex();
+    }
+
+    return index(offsets[rangeIndex] + (row - ranges[rangeIndex].first), 0);
+}
+
+QModelIndex AddressFilterModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() || column != 0) {
+        return QModelIndex();
+    }
+
+    return createIndex(row, column);
+}
+
+QModelIndex AddressFilterModel::parent(const QModelIndex &child) const
+{
+    Q_UNUSED(child);
+
+    return QModelIndex();
+}
+
+int AddressFilterModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return isFiltered() ? count : model->rowCount();
+}
+
+int AddressFilterModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 1;
+}
+
+bool AddressFilterModel::isFiltered() const
+{
+    return query.getKind() != AddressQuery::KindAll;
+}
+
+void AddressFilterModel::setQuery(const AddressQuery &query)
+{
+    beginResetModel();
+    this->query = query;
+    updateRanges();
+    endResetModel();
+}
+
+void AddressFilterModel::updateRanges()
+{
+    ranges.clear();
+    offsets.clear();
+    count = 0;
+
+    if (!isFiltered()) {
+        return;
+    }
+
+    ranges = searchIndex->search(query);
+    offsets.reserve(ranges.count());
+    for (int i = 0; i < ranges.count(); i += 1) {
+        offsets.append(count);
+        count += ranges[i].second - ranges[i].first + 1;
+    }
+}
+
+void AddressFilterModel::onSourceAboutToChange()
+{
+    beginResetModel();
+}
+
+void AddressFilterModel::onSourceChanged()
+{
+    updateRanges();
+    endResetModel();
+}
+
+void AddressFilterModel::onSourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+
+    // Unfiltered rows map one to one, so the view can keep its scroll position and selection
+    if (isFiltered()) {
+        onSourceLayoutAboutToChange();
+    } else {
+        beginInsertRows(QModelIndex(), first, last);
+    }
+}
+
+void AddressFilterModel::onSourceRowsInserted()
+{
+    if (isFiltered()) {
+        onSourceLayoutChanged();
+    } else {
+        endInsertRows();
+    }
+}
+
+void AddressFilterModel::onSourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    Q_UNUSED(parent);
+
+    if (isFiltered()) {
+        onSourceLayoutAboutToChange();
+    } else {
+        beginRemoveRows(QModelIndex(), first, last);
+    }
+}
+
+void AddressFilterModel::onSourceRowsRemoved()
+{
+    if (isFiltered()) {
+        onSourceLayoutChanged();
+    } else {
+        endRemoveRows();
+    }
+}
+
+void AddressFilterModel::onSourceLayoutAboutToChange()
+{
+    emit layoutAboutToBeChanged();
+
+    // The source keeps its own persistent indexes up to date, so remember which source row each of ours shows
+    layoutIndexes = persistentIndexList();
+    layoutSourceIndexes.clear();
+    layoutSourceIndexes.reserve(layoutIndexes.count());
+    for (int i = 0; i < layoutIndexes.count(); i += 1) {
+        layoutSourceIndexes.append(QPersistentModelIndex(mapToSource(layoutIndexes[i])));
+    }
+}
+
+void AddressFilterModel::onSourceLayoutChanged()
+{
+    updateRanges();
+
+    // Rows that were removed or no longer match the query are dropped
+    QModelIndexList toIndexes;
+    toIndexes.reserve(layoutIndexes.count());
+    for (int i = 0; i < layoutSourceIndexes.count(); i += 1) {
+        toIndexes.append(mapFromSource(layoutSourceIndexes[i]));
+    }
+
+    changePersistentIndexList(layoutIndexes, toIndexes);
+    layoutIndexes.clear();
+    layoutSourceIndexes.clear();
+
+    emit layoutChanged();
+}
@@ -0,0 +1,56 @@
+#include <QAbstractProxyModel>
+#include <QVector>
+
+#include "addresslistmodel.h"
+#include "addressquery.h"
+#include "addresssearchindex.h"
+
+#ifndef ADDRESSFILTERMODEL_H
+#define ADDRESSFILTERMODEL_H
+
+/*
+ * Shows the rows of an AddressListModel that match a query. Matches are kept as
+ * row ranges from AddressSearchIndex, so mapping a row is a bisection and
+ * changing the query never walks the whole list. With no query the source rows
+ * are passed through, including their insert and remove notifications. With a
+ * query, source changes become a layout change that keeps the views' rows.
+ */
+class AddressFilterModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit AddressFilterModel(AddressListModel *model, QObject *parent = nullptr);
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    void setQuery(const AddressQuery &query);
+    bool isFiltered() const;
+
+private:
+    AddressListModel *model;
+    AddressSearchIndex *searchIndex;
+    AddressQuery query;
+    QVector<RowRange> ranges;
+    QVector<int> offsets;
+    int count = 0;
+    QModelIndexList layoutIndexes;
+    QList<QPersistentModelIndex> layoutSourceIndexes;
+
+    void updateRanges();
+    void onSourceAboutToChange();
+    void onSourceChanged();
+    void onSourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+    void onSourceRowsInserted();
+    void onSourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void onSourceRowsRemoved();
+    void onSourceLayoutAboutToChange();
+    void onSourceLayoutChanged();
+};
+
+#endif // ADDRESSFILTERMODEL_H
@@ -0,0 +1,178 @@
+#include "addressformat.h"
+
+#include <cstring>
+
+/* Text of every octet value, the last byte holds the text length */
+struct OctetTable
+{
+    char text[256][4];
+
+    constexpr OctetTable() : text()
+    {
+        for (int i = 0; i < 256; i += 1) {
+            int n = 0;
+            if (i >= 100) {
+                text[i][n++] = (char) ('0' + i / 100);
+            }
+            if (i >= 10) {
+                text[i][n++] = (char) ('0' + (i / 10) % 10);
+            }
+            text[i][n++] = (char) ('0' + i % 10);
+            text[i][3] = (char) n;
+        }
+    }
+};
+
+static constexpr OctetTable octetTable;
+static const char hexDigits[] = "0123456789abcdef";
+
+static inline int appendOctet(char *buffer, int n, quint8 octet)
+{
+    // Copying the whole entry is one store, the length byte is overwritten by what follows
+    memcpy(buffer + n, octetTable.text[octet], 4);
+    return n + octetTable.text[octet][3];
+}
+
+static inline int appendGroup(char *buffer, int n, quint16 group)
+{
+    bool started = false;
+    for (int shift = 12; shift >= 0; shift -= 4) {
+        int digit = (group >> shift) & 0xF;
+        if (digit != 0 || started || shift == 0) {
+            buffer[n++] = hexDigits[digit];
+            started = true;
+        }
+    }
+
+    return n;
+}
+
+int AddressFormat::formatIpv4(quint32 address, char *buffer)
+{
+    int n = 0;
+    n = appendOctet(buffer, n, (quint8) (address >> 24));
+    buffer[n++] = '.';
+    n = appendOctet(buffer, n, (quint8) (address >> 16));
+    buffer[n++] = '.';
+    n = appendOctet(buffer, n, (quint8) (address >> 8));
+    buffer[n++] = '.';
+    n = appendOctet(buffer, n, (quint8) address);
+    buffer[n] = '\0';
+
+    return n;
+}
+
+int AddressFormat::formatIpv4Bytes(const quint8 *bytes, char *buffer)
+{
+    return formatIpv4(((quint32) bytes[0] << 24) | ((quint32) bytes[1] << 16) | ((quint32) bytes[2] << 8) | bytes[3], buffer);
+}
+
+int AddressFormat::formatIpv6Bytes(const quint8 *bytes, char *buffer)
+{
+    quint16 groups[8];
+    for (int i = 0; i < 8; i += 1) {
+        groups[i] = (quint16) ((bytes[2 * i] << 8) | bytes[2 * i + 1]);
+    }
+
+    // IPv4-mapped addresses keep the dotted tail, same as QHostAddress
+    if (groups[0] == 0 && groups[1] == 0 && groups[2] == 0 && groups[3] == 0 && groups[4] == 0 && groups[5] == 0xFFFF) {
+        memcpy(buffer, "::ffff:", 7);
+        return 7 + formatIpv4Bytes(bytes + 12, buffer + 7);
+    }
+
+    // RFC 5952: compress the first longest run of two or more zero groups
+    int zeroStart = -1;
+    int zeroLength = 1;
+    for (int i = 0; i < 8; ) {
+        if (groups[i] != 0) {
+            i += 1;
+            continue;
+        }
+
+        int j = i;
+        while (j < 8 && groups[j] == 0) {
+            j += 1;
+        }
+
+        if (j - i > zeroLength) {
+            zeroStart = i;
+            zeroLength = j - i;
+        }
+
+        i = j;
+    }
+
+    int n = 0;
+    for (int i = 0; i < 8; i += 1) {
+        if (i == zeroStart) {
+            buffer[n++] = ':';
+            buffer[n++] = ':';
+            i += zeroLength - 1;
+            continue;
+        }
+
+        if (n > 0 && buffer[n - 1] != ':') {
+            buffer[n++] = ':';
+        }
+
+        n = appendGroup(buffer, n, groups[i]);
+    }
+
+    buffer[n] = '\0';
+
+    return n;
+}
+
+AddressString AddressFormat::toAddressString(quint32 address)
+{
+    AddressString addressString;
+    addressString.length = formatIpv4(address, addressString.data);
+
+    return addressString;
+}
+
+AddressString AddressFormat::toAddressString6(const quint8 *bytes)
+{
+    AddressString addressString;
+    addressString.length = formatIpv6Bytes(bytes, addressString.data);
+
+    return addressString;
+}
+
+QString AddressFormat::toString(quint32 address)
+{
+    char buffer[IPV4_STRING_SIZE];
+    int length = formatIpv4(address, buffer);
+
+    return QString::fromLatin1(buffer, length);
+}
+
+QString AddressFormat::toString4(const quint8 *bytes)
+{
+    char buffer[IPV4_STRING_SIZE];
+    int length = formatIpv4Bytes(bytes, buffer);
+
+    return QString::fromLatin1(buffer, length);
+}
+
+QString AddressFormat::toString6(const quint8 *bytes)
+{
+    char buffer[IPV6_STRING_SIZE];
+    int length = formatIpv6Bytes(bytes, buffer);
+
+    return QString::fromLatin1(buffer, length);
+}
+
+QString AddressFormat::toString(const QHostAddress &hostAddress)
+{
+    if (hostAddress.protocol() == QAbstractSocket::IPv4Protocol) {
+        return toString(hostAddress.toIPv4Address());
+    }
+
+    if (hostAddress.protocol() == QAbstractSocket::IPv6Protocol) {
+        Q_IPV6ADDR bytes = hostAddress.toIPv6Address();
+        return toString6(bytes.c);
+    }
+
+    return QString();
+}
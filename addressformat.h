@@ -0,0 +1,43 @@
+#include <QtGlobal>
+#include <QString>
+#include <QHostAddress>
+
+#ifndef ADDRESSFORMAT_H
+#define ADDRESSFORMAT_H
+
+#define IPV4_STRING_SIZE 16 // "255.255.255.255" and the terminator
+#define IPV6_STRING_SIZE 46 // Same as INET6_ADDRSTRLEN
+
+/* Fixed capacity address text that lives on the stack */
+struct AddressString
+{
+    char data[IPV6_STRING_SIZE];
+    int length;
+
+    const char *constData() const { return data; }
+    int size() const { return length; }
+    QString toQString() const { return QString::fromLatin1(data, length); }
+};
+
+/*
+ * Address to text conversion without heap allocation or shared state, so it
+ * can be called from any thread. The buffer versions write a terminated string
+ * and return its length.
+ */
+class AddressFormat
+{
+public:
+    static int formatIpv4(quint32 address, char *buffer);
+    static int formatIpv4Bytes(const quint8 *bytes, char *buffer);
+    static int formatIpv6Bytes(const quint8 *bytes, char *buffer);
+
+    static AddressString toAddressString(quint32 address);
+    static AddressString toAddressString6(const quint8 *bytes);
+
+    static QString toString(quint32 address);
+    static QString toString4(const quint8 *bytes);
+    static QString toString6(const quint8 *bytes);
+    static QString toString(const QHostAddress &hostAddress);
+};
+
+#endif // ADDRESSFORMAT_H
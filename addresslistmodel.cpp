@@ -0,0 +1,341 @@
+#include "addresslistmodel.h"
+
+#include <algorithm>
+
+AddressListModel::AddressListModel(QObject *parent) : QAbstractListModel(parent)
+{
+
+}
+
+int AddressListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+
+    return addresses.count() + addresses6.count();
+}
+
+QVariant AddressListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= rowCount()) {
+        return QVariant();
+    }
+
+    int row = index.row();
+    if (role == Qt::DisplayRole || role == Qt::UserRole) {
+        return getAddressText(row);
+    }
+
+    if (role == ADDRESS_ROLE) {
+        if (row < addresses.count()) {
+            return QVariant::fromValue(addresses[row]);
+        }
+
+        return QVariant::fromValue(addresses6[row - addresses.count()]);
+    }
+
+    return QVariant();
+}
+
+int AddressListModel::insertAddress(Ipv4Address address)
+{
+    int row = findRow(address);
+    if (row < addresses.count() && addresses[row] == address) {
+        return row;
+    }
+
+    beginInsertRows(QModelIndex(), row, row);
+    addresses.insert(row, address);
+    generation += 1;
+    emit addressesInserted(QVector<Ipv4Address>(1, address), QVector<Ipv6Address>());
+    endInsertRows();
+
+    return row;
+}
+
+int AddressListModel::insertAddress(Ipv6Address address)
+{
+    int row = findRow(address);
+    int index = row - addresses.count();
+    if (index < addresses6.count() && addresses6[index] == address) {
+        return row;
+    }
+
+    beginInsertRows(QModelIndex(), row, row);
+    addresses6.insert(index, address);
+    generation += 1;
+    emit addressesInserted(QVector<Ipv4Address>(), QVector<Ipv6Address>(1, address));
+    endInsertRows();
+
+    return row;
+}
+
+template <typename T>
+QVector<T> AddressListModel::getNewSorted(const QVector<T> &current, QVector<T> added)
+{
+    std::sort(added.begin(), added.end());
+    added.erase(std::unique(added.begin(), added.end()), added.end());
+
+    QVector<T> newAddresses;
+    newAddresses.reserve(added.count());
+    std::set_difference(added.constBegin(), added.constEnd(), current.constBegin(), current.constEnd(), std::back_inserter(newAddresses));
+
+    return newAddresses;
+}
+
+template <typename T>
+QVector<T> AddressListModel::mergeSorted(const QVector<T> &current, const QVector<T> &added)
+{
+    QVector<T> merged;
+    merged.reserve(current.count() + added.count());
+    std::merge(current.constBegin(), current.constEnd(), added.constBegin(), added.constEnd(), std::back_inserter(merged));
+
+    return merged;
+}
+
+template <typename T>
+QList<QPair<int, int>> AddressListModel::getInsertRuns(const QVector<T> &current, const QVector<T> &added, int offset)
+{
+    // (row in the current list, number of new addresses that go in before it), in row order
+    QList<QPair<int, int>> runs;
+    for (int i = 0; i < added.count(); i += 1) {
+        int row = offset + (std::lower_bound(current.constBegin(), current.constEnd(), added[i]) - current.constBegin());
+        if (!runs.isEmpty() && runs.last().first == row) {
+            runs.last().second += 1;
+        } else {
+            runs.append(QPair<int, int>(row, 1));
+        }
+    }
+
+    return runs;
+}
+
+int AddressListModel::insertAddresses(QVector<Ipv4Address> addedAddresses, QVector<Ipv6Address> addedAddresses6)
+{
+    QVector<Ipv4Address> newAddresses = getNewSorted(addresses, addedAddresses);
+    QVector<Ipv6Address> newAddresses6 = getNewSorted(addresses6, addedAddresses6);
+
+    int count = newAddresses.count() + newAddresses6.count();
+    if (count == 0) {
+        return 0;
+    }
+
+    QList<QPair<int, int>> runs = getInsertRuns(addresses, newAddresses, 0);
+    runs += getInsertRuns(addresses6, newAddresses6, addresses.count());
+
+    // A few runs are inserted one by one, the views then only shift the rows after each
+    if (runs.count() <= ADDRESS_LAYOUT_CHANGE_RUNS) {
+        int inserted = 0;
+        int inserted6 = 0;
+        for (int i = 0; i < runs.count(); i += 1) {
+            int first = runs[i].first + inserted + inserted6;
+            int length = runs[i].second;
+
+            beginInsertRows(QModelIndex(), first, first + length - 1);
+            if (inserted < newAddresses.count()) {
+                int position = runs[i].first + inserted;
+                addresses.insert(position, length, Ipv4Address());
+                std::copy(newAddresses.constBegin() + inserted, newAddresses.constBegin() + inserted + length, addresses.begin() + position);
+                generation += 1;
+                emit addressesInserted(newAddresses.mid(inserted, length), QVector<Ipv6Address>());
+                inserted += length;
+            } else {
+                int position = runs[i].first - (addresses.count() - inserted) + inserted6;
+                addresses6.insert(position, length, Ipv6Address());
+                std::copy(newAddresses6.constBegin() + inserted6, newAddresses6.constBegin() + inserted6 + length, addresses6.begin() + position);
+                generation += 1;
+                emit addressesInserted(QVector<Ipv4Address>(), newAddresses6.mid(inserted6, length));
+                inserted6 += length;
+            }
+            endInsertRows();
+        }
+
+        return count;
+    }
+
+    // Scattered inserts go in with one merge, and every row the views hold moves down by the new rows before it
+    emit layoutAboutToBeChanged();
+
+    QModelIndexList fromIndexes = persistentIndexList();
+    QVector<int> toRows;
+    toRows.reserve(fromIndexes.count());
+    for (int i = 0; i < fromIndexes.count(); i += 1) {
+        int row = fromIndexes[i].row();
+        if (row < addresses.count()) {
+            row += std::lower_bound(newAddresses.constBegin(), newAddresses.constEnd(), addresses[row]) - newAddresses.constBegin();
+        } else {
+            int position = row - addresses.count();
+            row = addresses.count() + newAddresses.count() + position + (std::lower_bound(newAddresses6.constBegin(), newAddresses6.constEnd(), addresses6[position]) - newAddresses6.constBegin());
+        }
+        toRows.append(row);
+    }
+
+    addresses = mergeSorted(addresses, newAddresses);
+    addresses6 = mergeSorted(addresses6, newAddresses6);
+    generation += 1;
+    emit addressesInserted(newAddresses, newAddresses6);
+
+    // The new rows have to exist before indexes to them can be made
+    QModelIndexList toIndexes;
+    toIndexes.reserve(toRows.count());
+    for (int i = 0; i < toRows.count(); i += 1) {
+        toIndexes.append(index(toRows[i], 0));
+    }
+
+    changePersistentIndexList(fromIndexes, toIndexes);
+    emit layoutChanged();
+
+    return count;
+}
+
+template <typename T>
+void AddressListModel::removeIndexes(QVector<T> *vector, const QVector<bool> &removed, int offset, QVector<T> *removedValues)
+{
+    int kept = 0;
+    for (int i = 0; i < vector->count(); i += 1) {
+        if (!removed[offset + i]) {
+            (*vector)[kept] = (*vector)[i];
+            kept += 1;
+        } else {
+            removedValues->append((*vector)[i]);
+        }
+    }
+
+    vector->resize(kept);
+}
+
+void AddressListModel::removeAddressRows(QList<int> rows)
+{
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.isEmpty()) {
+        return;
+    }
+
+    // Contiguous runs, split where the IPv6 rows start
+    QList<QPair<int, int>> runs;
+    for (int i = 0; i < rows.count(); i += 1) {
+        if (!runs.isEmpty() && runs.last().second + 1 == rows[i] && rows[i] != addresses.count()) {
+            runs.last().second = rows[i];
+        } else {
+            runs.append(QPair<int, int>(rows[i], rows[i]));
+        }
+    }
+
+    // A scattered selection is cheaper to compact in one pass than to erase run by run
+    if (runs.count() > ADDRESS_LAYOUT_CHANGE_RUNS) {
+        QVector<bool> removed(rowCount(), false);
+        for (int i = 0; i < rows.count(); i += 1) {
+            removed[rows[i]] = true;
+        }
+
+        emit layoutAboutToBeChanged();
+
+        // Rows the views hold move up by the removed rows before them, removed ones are dropped
+        QVector<int> newRows(removed.count());
+        int kept = 0;
+        for (int i = 0; i < removed.count(); i += 1) {
+            newRows[i] = removed[i] ? -1 : kept;
+            kept += removed[i] ? 0 : 1;
+        }
+
+        QModelIndexList fromIndexes = persistentIndexList();
+        QModelIndexList toIndexes;
+        toIndexes.reserve(fromIndexes.count());
+        for (int i = 0; i < fromIndexes.count(); i += 1) {
+            int row = newRows[fromIndexes[i].row()];
+            toIndexes.append(row < 0 ? QModelIndex() : index(row, 0));
+        }
+
+        int ipv4Count = addresses.count();
+        QVector<Ipv4Address> removedAddresses;
+        QVector<Ipv6Address> removedAddresses6;
+        removeIndexes(&addresses, removed, 0, &removedAddresses);
+        removeIndexes(&addresses6, removed, ipv4Count, &removedAddresses6);
+        generation += 1;
+        emit addressesRemoved(removedAddresses, removedAddresses6);
+
+        changePersistentIndexList(fromIndexes, toIndexes);
+        emit layoutChanged();
+        return;
+    }
+
+    for (int i = runs.count() - 1; i >= 0; i -= 1) {
+        int first = runs[i].first;
+        int last = runs[i].second;
+
+        beginRemoveRows(QModelIndex(), first, last);
+        if (first < addresses.count()) {
+            QVector<Ipv4Address> removedAddresses = addresses.mid(first, last - first + 1);
+            addresses.erase(addresses.begin() + first, addresses.begin() + last + 1);
+            generation += 1;
+            emit addressesRemoved(removedAddresses, QVector<Ipv6Address>());
+        } else {
+            int index = first - addresses.count();
+            QVector<Ipv6Address> removedAddresses6 = addresses6.mid(index, last - first + 1);
+            addresses6.erase(addresses6.begin() + index, addresses6.begin() + index + (last - first) + 1);
+            generation += 1;
+            emit addressesRemoved(QVector<Ipv4Address>(), removedAddresses6);
+        }
+        endRemoveRows();
+    }
+}
+
+void AddressListModel::clear()
+{
+    beginResetModel();
+    addresses.clear();
+    addresses6.clear();
+    generation += 1;
+    endResetModel();
+}
+
+int AddressListModel::findRow(Ipv4Address address) const
+{
+    return std::lower_bound(addresses.constBegin(), addresses.constEnd(), address) - addresses.constBegin();
+}
+
+int AddressListModel::findRow(Ipv6Address address) const
+{
+    return addresses.count() + (std::lower_bound(addresses6.constBegin(), addresses6.constEnd(), address) - addresses6.constBegin());
+}
+
+bool AddressListModel::contains(Ipv4Address address) const
+{
+    int row = findRow(address);
+
+    return row < addresses.count() && addresses[row] == address;
+}
+
+bool AddressListModel::contains(Ipv6Address address) const
+{
+    int index = findRow(address) - addresses.count();
+
+    return index < addresses6.count() && addresses6[index] == address;
+}
+
+QString AddressListModel::getAddressText(int row) const
+{
+    if (row < addresses.count()) {
+        return addresses[row].toString();
+    }
+
+    return addresses6[row - addresses.count()].toString();
+}
+
+const QVector<Ipv4Address> &AddressListModel::getIpv4Addresses() const
+{
+    return addresses;
+}
+
+const QVector<Ipv6Address> &AddressListModel::getIpv6Addresses() const
+{
+    return addresses6;
+}
+
+quint64 AddressListModel::getGeneration() const
+{
+    // Bumped by every change before the views hear about it, so dependent indexes can tell they are stale
+    return generation;
+}
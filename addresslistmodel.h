@@ -0,0 +1,61 @@
+#include <QAbstractListModel>
+#include <QVector>
+
+#include "ipv4address.h"
+#include "ipv6address.h"
+
+#ifndef ADDRESSLISTMODEL_H
+#define ADDRESSLISTMODEL_H
+
+#define ADDRESS_ROLE (Qt::UserRole + 1)
+#define ADDRESS_LAYOUT_CHANGE_RUNS 64
+
+/*
+ * Sorted set of addresses kept in two contiguous vectors, IPv4 rows first then
+ * IPv6. Text is only produced when a row is painted or serialised. Bulk edits
+ * are announced as row inserts and removes per contiguous run, or as one layout
+ * change with the persistent indexes moved when there are many runs, so views
+ * keep their selection and scroll position.
+ */
+class AddressListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    explicit AddressListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    int insertAddress(Ipv4Address address);
+    int insertAddress(Ipv6Address address);
+    int insertAddresses(QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6);
+    void removeAddressRows(QList<int> rows);
+    void clear();
+
+    int findRow(Ipv4Address address) const;
+    int findRow(Ipv6Address address) const;
+    bool contains(Ipv4Address address) const;
+    bool contains(Ipv6Address address) const;
+    QString getAddressText(int row) const;
+    const QVector<Ipv4Address> &getIpv4Addresses() const;
+    const QVector<Ipv6Address> &getIpv6Addresses() const;
+    quint64 getGeneration() const;
+
+private:
+    QVector<Ipv4Address> addresses;
+    QVector<Ipv6Address> addresses6;
+    quint64 generation = 0;
+
+    template <typename T> static QVector<T> getNewSorted(const QVector<T> &current, QVector<T> added);
+    template <typename T> static QVector<T> mergeSorted(const QVector<T> &current, const QVector<T> &added);
+    template <typename T> static QList<QPair<int, int>> getInsertRuns(const QVector<T> &current, const QVector<T> &added, int offset);
+    template <typename T> static void removeIndexes(QVector<T> *vector, const QVector<bool> &removed, int offset, QVector<T> *removedValues);
+
+signals:
+    // Sorted, and emitted before the row notifications so dependent indexes are current when views react
+    void addressesInserted(const QVector<Ipv4Address> &addresses, const QVector<Ipv6Address> &addresses6);
+    void addressesRemoved(const QVector<Ipv4Address> &addresses, const QVector<Ipv6Address> &addresses6);
+};
+
+#endif // ADDRESSLISTMODEL_H
@@ -0,0 +1,163 @@
+#include "addressquery.h"
+
+AddressQuery AddressQuery::parse(QString text)
+{
+    AddressQuery query;
+    query.text = text.trimmed().toLower();
+
+    if (query.text.isEmpty()) {
+        query.kind = KindAll;
+        return query;
+    }
+
+    if (query.text.startsWith('*')) {
+        query.text = query.text.mid(1);
+        query.kind = query.text.isEmpty() ? KindAll : KindText;
+        return query;
+    }
+
+    // A range only means something once it is complete, until then nothing matches
+    if (query.text.contains('/') || query.text.contains('-')) {
+        if (query.text.contains(':')) {
+            query.kind = ScopeTool::parseRange6(query.text, &query.range6) ? KindRange6 : KindNone;
+        } else {
+            query.kind = ScopeTool::parseRange(query.text, &query.range) ? KindRange : KindNone;
+        }
+
+        return query;
+    }
+
+    query.kind = KindPrefix;
+    query.prefixRanges = getIpv4PrefixRanges(query.text);
+
+    return query;
+}
+
+QList<AddressRange> AddressQuery::getIpv4PrefixRanges(QString prefix)
+{
+    // Canonical IPv4 text sorts with its value, so a text prefix is at most three numeric ranges
+    QList<AddressRange> ranges;
+
+    QStringList groups = prefix.split('.');
+    if (groups.count() > 4) {
+        return ranges;
+    }
+
+    quint32 base = 0;
+    int fixed = groups.count() - 1;
+    for (int i = 0; i < fixed; i += 1) {
+        bool ok = false;
+        int octet = groups[i].toInt(&ok);
+        if (!ok || groups[i].length() > 3 || octet < 0 || octet > 255 || groups[i] != QString::number(octet)) {
+            return ranges;
+        }
+
+        base |= (quint32) octet << (24 - 8 * i);
+    }
+
+    if (fixed == 4) {
+        return ranges;
+    }
+
+    // The partially typed octet, as the octet values whose text starts with it
+    QList<QPair<int, int>> octetRanges;
+    QString partial = groups.last();
+    if (partial.isEmpty()) {
+        octetRanges.append(QPair<int, int>(0, 255));
+    } else {
+        bool ok = false;
+        int value = partial.toInt(&ok);
+        if (!ok || partial.length() > 3 || value < 0 || partial != QString::number(value)) {
+            return ranges;
+        }
+
+        if (value == 0) {
+            octetRanges.append(QPair<int, int>(0, 0));
+        } else {
+            for (int first = value, width = 1; first <= 255; first *= 10, width *= 10) {
+                octetRanges.append(QPair<int, int>(first, qMin(first + width - 1, 255)));
+            }
+        }
+    }
+
+    int shift = 24 - 8 * fixed;
+    quint32 rest = (shift == 0) ? 0 : ((1u << shift) - 1);
+    for (int i = 0; i < octetRanges.count(); i += 1) {
+        quint32 first = base | ((quint32) octetRanges[i].first << shift);
+        quint32 last = base | ((quint32) octetRanges[i].second << shift) | rest;
+        ranges.append(AddressRange(first, last));
+    }
+
+    return ranges;
+}
+
+AddressQuery::Kind AddressQuery::getKind() const
+{
+    return kind;
+}
+
+QString AddressQuery::getText() const
+{
+    return text;
+}
+
+AddressRange AddressQuery::getRange() const
+{
+    return range;
+}
+
+Address6Range AddressQuery::getRange6() const
+{
+    return range6;
+}
+
+QList<AddressRange> AddressQuery::getPrefixRanges() const
+{
+    return prefixRanges;
+}
+
+bool AddressQuery::isNarrowingOf(const AddressQuery &other) const
+{
+    // Typing one more character can only drop matches, so the previous results can be filtered instead of searched again
+    if (other.kind == KindAll) {
+        return true;
+    }
+
+    if (kind == KindPrefix && other.kind == KindPrefix) {
+        return text.startsWith(other.text);
+    }
+
+    if ((kind == KindPrefix || kind == KindText) && other.kind == KindText) {
+        return text.contains(other.text);
+    }
+
+    return false;
+}
+
+bool AddressQuery::matches(QString address) const
+{
+    switch (kind) {
+    case KindAll:
+        return true;
+    case KindPrefix:
+        return address.startsWith(text, Qt::CaseInsensitive);
+    case KindText:
+        return address.contains(text, Qt::CaseInsensitive);
+    case KindRange: {
+        bool ok = false;
+        Ipv4Address ipv4Address = Ipv4Address::fromString(address, &ok);
+        return ok && ipv4Address.toUInt32() >= range.first && ipv4Address.toUInt32() <= range.second;
+    }
+    case KindRange6: {
+        QHostAddress hostAddress = IPTool::getIpv6QHostAddress(address);
+        if (hostAddress.isNull()) {
+            return false;
+        }
+
+        Ipv6Address ipv6Address = Ipv6Address::fromQHostAddress(hostAddress);
+        return ipv6Address >= range6.first && ipv6Address <= range6.second;
+    }
+    default:
+        return false;
+    }
+}
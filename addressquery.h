@@ -0,0 +1,43 @@
+#include <QString>
+#include <QList>
+
+#include "iptool.h"
+#include "ipv4address.h"
+#include "ipv6address.h"
+#include "scopetool.h"
+
+#ifndef ADDRESSQUERY_H
+#define ADDRESSQUERY_H
+
+/*
+ * Parsed search box text:
+ *   "192.168.1"      prefix of the canonical address text
+ *   "*.255"          substring anywhere in the address text
+ *   "10.0.0.0/8"     containment in a CIDR block or a first-last range
+ */
+class AddressQuery
+{
+public:
+    enum Kind { KindAll, KindPrefix, KindText, KindRange, KindRange6, KindNone };
+
+    static AddressQuery parse(QString text);
+
+    Kind getKind() const;
+    QString getText() const;
+    AddressRange getRange() const;
+    Address6Range getRange6() const;
+    QList<AddressRange> getPrefixRanges() const;
+    bool isNarrowingOf(const AddressQuery &other) const;
+    bool matches(QString address) const;
+
+private:
+    Kind kind = KindAll;
+    QString text;
+    AddressRange range;
+    Address6Range range6;
+    QList<AddressRange> prefixRanges;
+
+    static QList<AddressRange> getIpv4PrefixRanges(QString prefix);
+};
+
+#endif // ADDRESSQUERY_H
@@ -0,0 +1,302 @@
+#include "addresssearchindex.h"
+
+#include <algorithm>
+
+AddressSearchIndex::AddressSearchIndex(AddressListModel *model, QObject *parent) : QObject(parent)
+{
+    this->model = model;
+
+    connect(model, &AddressListModel::addressesInserted, this, &AddressSearchIndex::onAddressesInserted);
+    connect(model, &AddressListModel::addressesRemoved, this, &AddressSearchIndex::onAddressesRemoved);
+    connect(model, &QAbstractItemModel::modelReset, this, &AddressSearchIndex::onModelReset);
+}
+
+quint32 AddressSearchIndex::getGramKey(const QChar *data, int length)
+{
+    // Address text is ASCII, so a run of up to three characters packs into one integer. Case is folded, IPv6 hex digits may be typed in upper case.
+    quint32 key = (quint32) length << 24;
+    for (int i = 0; i < length; i += 1) {
+        ushort c = data[i].unicode();
+        if (c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+
+        key |= (quint32) (c & 0xFF) << (16 - 8 * i);
+    }
+
+    return key;
+}
+
+template <typename T>
+QHash<quint32, QVector<T>> AddressSearchIndex::getGrams(const QVector<T> &addresses)
+{
+    QHash<quint32, QVector<T>> grams;
+    for (int i = 0; i < addresses.count(); i += 1) {
+        QString text = addresses[i].toString();
+        const QChar *data = text.constData();
+        for (int length = 1; length <= SEARCH_GRAM_MAX_LENGTH; length += 1) {
+            for (int j = 0; j + length <= text.length(); j += 1) {
+                // Addresses are visited in order, so a repeated run in one address only needs comparing with the last entry
+                QVector<T> &entries = grams[getGramKey(data + j, length)];
+                if (entries.isEmpty() || entries.last() != addresses[i]) {
+                    entries.append(addresses[i]);
+                }
+            }
+        }
+    }
+
+    return grams;
+}
+
+template <typename T>
+void AddressSearchIndex::addPostings(QHash<quint32, QVector<T>> *postings, const QVector<T> &addresses)
+{
+    QHash<quint32, QVector<T>> grams = getGrams(addresses);
+    for (typename QHash<quint32, QVector<T>>::const_iterator it = grams.constBegin(); it != grams.constEnd(); ++it) {
+        QVector<T> &entries = (*postings)[it.key()];
+        if (entries.isEmpty()) {
+            entries = it.value();
+            continue;
+        }
+
+        QVector<T> merged;
+        merged.reserve(entries.count() + it.value().count());
+        std::merge(entries.constBegin(), entries.constEnd(), it.value().constBegin(), it.value().constEnd(), std::back_inserter(merged));
+        entries = merged;
+    }
+}
+
+template <typename T>
+void AddressSearchIndex::removePostings(QHash<quint32, QVector<T>> *postings, const QVector<T> &addresses)
+{
+    QHash<quint32, QVector<T>> grams = getGrams(addresses);
+    for (typename QHash<quint32, QVector<T>>::const_iterator it = grams.constBegin(); it != grams.constEnd(); ++it) {
+        typename QHash<quint32, QVector<T>>::iterator entries = postings->find(it.key());
+        if (entries == postings->end()) {
+            continue;
+        }
+
+        QVector<T> kept;
+        kept.reserve(entries.value().count());
+        std::set_difference(entries.value().constBegin(), entries.value().constEnd(), it.value().constBegin(), it.value().constEnd(), std::back_inserter(kept));
+        if (kept.isEmpty()) {
+            postings->erase(entries);
+        } else {
+            entries.value() = kept;
+        }
+    }
+}
+
+void AddressSearchIndex::buildIndex()
+{
+    if (indexBuilt) {
+        return;
+    }
+
+    postings.clear();
+    postings6.clear();
+    addPostings(&postings, model->getIpv4Addresses());
+    addPostings(&postings6, model->getIpv6Addresses());
+
+    indexBuilt = true;
+}
+
+void AddressSearchIndex::onAddressesInserted(const QVector<Ipv4Address> &addresses, const QVector<Ipv6Address> &addresses6)
+{
+    // Only the runs of the new addresses are touched, the rest of the index stays as it is
+    if (!indexBuilt) {
+        return;
+    }
+
+    addPostings(&postings, addresses);
+    addPostings(&postings6, addresses6);
+}
+
+void AddressSearchIndex::onAddressesRemoved(const QVector<Ipv4Address> &addresses, const QVector<Ipv6Address> &addresses6)
+{
+    if (!indexBuilt) {
+        return;
+    }
+
+    removePostings(&postings, addresses);
+    removePostings(&postings6, addresses6);
+}
+
+void AddressSearchIndex::onModelReset()
+{
+    indexBuilt = false;
+    postings.clear();
+    postings6.clear();
+}
+
+template <typename T>
+void AddressSearchIndex::appendRows(QVector<int> *rows, const QVector<T> *candidates, const QVector<T> &addresses, int offset, const AddressQuery &query, bool exact)
+{
+    // Candidates are sorted like the list, so each one is looked up after the previous
+    typename QVector<T>::const_iterator position = addresses.constBegin();
+    for (int i = 0; i < candidates->count(); i += 1) {
+        const T &address = (*candidates)[i];
+        if (!exact && !query.matches(address.toString())) {
+            continue;
+        }
+
+        position = std::lower_bound(position, addresses.constEnd(), address);
+        rows->append(offset + (position - addresses.constBegin()));
+    }
+}
+
+QVector<RowRange> AddressSearchIndex::toRowRanges(const QVector<int> &rows)
+{
+    QVector<RowRange> ranges;
+    for (int i = 0; i < rows.count(); i += 1) {
+        if (!ranges.isEmpty() && ranges.last().second + 1 == rows[i]) {
+            ranges.last().second = rows[i];
+        } else {
+            ranges.append(RowRange(rows[i], rows[i]));
+        }
+    }
+
+    return ranges;
+}
+
+int AddressSearchIndex::getRowCount(const QVector<RowRange> &ranges)
+{
+    int count = 0;
+    for (int i = 0; i < ranges.count(); i += 1) {
+        count += ranges[i].second - ranges[i].first + 1;
+    }
+
+    return count;
+}
+
+QVector<int> AddressSearchIndex::searchText(const AddressQuery &query, int firstRow)
+{
+    static const QVector<Ipv4Address> noAddresses;
+    static const QVector<Ipv6Address> noAddresses6;
+
+    buildIndex();
+
+    QString text = query.getText();
+    int length = qMin(text.length(), SEARCH_GRAM_MAX_LENGTH);
+    bool includeIpv4 = firstRow == 0;
+
+    // The rarest run of the query bounds the candidates, every match has to contain it
+    const QVector<Ipv4Address> *candidates = nullptr;
+    const QVector<Ipv6Address> *candidates6 = nullptr;
+    int candidateCount = -1;
+    for (int i = 0; i + length <= text.length(); i += 1) {
+        quint32 key = getGramKey(text.constData() + i, length);
+        QHash<quint32, QVector<Ipv4Address>>::const_iterator it = postings.constFind(key);
+        QHash<quint32, QVector<Ipv6Address>>::const_iterator it6 = postings6.constFind(key);
+        const QVector<Ipv4Address> *entries = (includeIpv4 && it != postings.constEnd()) ? &it.value() : &noAddresses;
+        const QVector<Ipv6Address> *entries6 = (it6 != postings6.constEnd()) ? &it6.value() : &noAddresses6;
+
+        int count = entries->count() + entries6->count();
+        if (count == 0) {
+            return QVector<int>();
+        }
+
+        if (candidateCount < 0 || count < candidateCount) {
+            candidates = entries;
+            candidates6 = entries6;
+            candidateCount = count;
+        }
+    }
+
+    if (candidateCount < 0) {
+        return QVector<int>();
+    }
+
+    QVector<int> rows;
+
+    // While typing, the previous answer is usually the smaller set to filter. It has to be an answer for these rows
+    if (lastValid && query.isNarrowingOf(lastQuery) && getRowCount(lastRanges) < candidateCount) {
+        for (int i = 0; i < lastRanges.count(); i += 1) {
+            for (int row = qMax(lastRanges[i].first, firstRow); row <= lastRanges[i].second; row += 1) {
+                if (query.matches(model->getAddressText(row))) {
+                    rows.append(row);
+                }
+            }
+        }
+
+        return rows;
+    }
+
+    // A substring no longer than a run is exactly its posting list
+    bool exact = query.getKind() == AddressQuery::KindText && text.length() <= SEARCH_GRAM_MAX_LENGTH;
+    if (exact) {
+        rows.reserve(candidateCount);
+    }
+
+    appendRows(&rows, candidates, model->getIpv4Addresses(), 0, query, exact);
+    appendRows(&rows, candidates6, model->getIpv6Addresses(), model->getIpv4Addresses().count(), query, exact);
+
+    return rows;
+}
+
+QVector<RowRange> AddressSearchIndex::search(const AddressQuery &query)
+{
+    if (lastGeneration != model->getGeneration()) {
+        lastValid = false;
+        lastRanges.clear();
+        lastGeneration = model->getGeneration();
+    }
+
+    const QVector<Ipv4Address> &addresses = model->getIpv4Addresses();
+    const QVector<Ipv6Address> &addresses6 = model->getIpv6Addresses();
+    int ipv4Count = addresses.count();
+
+    QVector<RowRange> ranges;
+    switch (query.getKind()) {
+    case AddressQuery::KindAll:
+        if (model->rowCount() > 0) {
+            ranges.append(RowRange(0, model->rowCount() - 1));
+        }
+        break;
+    case AddressQuery::KindRange: {
+        AddressRange range = query.getRange();
+        int first = std::lower_bound(addresses.constBegin(), addresses.constEnd(), Ipv4Address(range.first)) - addresses.constBegin();
+        int last = (std::upper_bound(addresses.constBegin(), addresses.constEnd(), Ipv4Address(range.second)) - addresses.constBegin()) - 1;
+        if (first <= last) {
+            ranges.append(RowRange(first, last));
+        }
+        break;
+    }
+    case AddressQuery::KindRange6: {
+        Address6Range range = query.getRange6();
+        int first = std::lower_bound(addresses6.constBegin(), addresses6.constEnd(), range.first) - addresses6.constBegin();
+        int last = (std::upper_bound(addresses6.constBegin(), addresses6.constEnd(), range.second) - addresses6.constBegin()) - 1;
+        if (first <= last) {
+            ranges.append(RowRange(ipv4Count + first, ipv4Count + last));
+        }
+        break;
+    }
+    case AddressQuery::KindPrefix: {
+        // IPv4 text sorts with its value, so its prefixes are bisected; IPv6 text does not, because of "::"
+        QList<AddressRange> prefixRanges = query.getPrefixRanges();
+        for (int i = 0; i < prefixRanges.count(); i += 1) {
+            int first = std::lower_bound(addresses.constBegin(), addresses.constEnd(), Ipv4Address(prefixRanges[i].first)) - addresses.constBegin();
+            int last = (std::upper_bound(addresses.constBegin(), addresses.constEnd(), Ipv4Address(prefixRanges[i].second)) - addresses.constBegin()) - 1;
+            if (first <= last) {
+                ranges.append(RowRange(first, last));
+            }
+        }
+
+        if (!addresses6.isEmpty()) {
+            ranges += toRowRanges(searchText(query, ipv4Count));
+        }
+        break;
+    }
+    case AddressQuery::KindText:
+        ranges = toRowRanges(searchText(query, 0));
+        break;
+    default:
+        break;
+    }
+
+    lastQuery = query;
+    lastRanges = ranges;
+    lastValid = true;
+
+    return ranges;
+}
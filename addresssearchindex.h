@@ -0,0 +1,57 @@
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QPair>
+
+#include "addresslistmodel.h"
+#include "addressquery.h"
+
+#ifndef ADDRESSSEARCHINDEX_H
+#define ADDRESSSEARCHINDEX_H
+
+#define SEARCH_GRAM_MAX_LENGTH 3
+
+/* Matching rows as sorted, inclusive first-last pairs */
+typedef QPair<int, int> RowRange;
+
+/*
+ * Answers AddressQuery against an AddressListModel without scanning it.
+ * Ranges and IPv4 prefixes are bisected on the sorted addresses; substrings and
+ * IPv6 prefixes go through posting lists of every 1 to 3 character run of the
+ * address text. The lists hold addresses rather than rows, so they are built on
+ * first use and then only updated for the addresses the model adds or removes.
+ */
+class AddressSearchIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AddressSearchIndex(AddressListModel *model, QObject *parent = nullptr);
+    QVector<RowRange> search(const AddressQuery &query);
+
+private:
+    AddressListModel *model;
+    bool indexBuilt = false;
+    QHash<quint32, QVector<Ipv4Address>> postings;
+    QHash<quint32, QVector<Ipv6Address>> postings6;
+
+    quint64 lastGeneration = 0;
+    bool lastValid = false;
+    AddressQuery lastQuery;
+    QVector<RowRange> lastRanges;
+
+    void buildIndex();
+    void onAddressesInserted(const QVector<Ipv4Address> &addresses, const QVector<Ipv6Address> &addresses6);
+    void onAddressesRemoved(const QVector<Ipv4Address> &addresses, const QVector<Ipv6Address> &addresses6);
+    void onModelReset();
+    QVector<int> searchText(const AddressQuery &query, int firstRow);
+    template <typename T> static QHash<quint32, QVector<T>> getGrams(const QVector<T> &addresses);
+    template <typename T> static void addPostings(QHash<quint32, QVector<T>> *postings, const QVector<T> &addresses);
+    template <typename T> static void removePostings(QHash<quint32, QVector<T>> *postings, const QVector<T> &addresses);
+    template <typename T> static void appendRows(QVector<int> *rows, const QVector<T> *candidates, const QVector<T> &addresses, int offset, const AddressQuery &query, bool exact);
+    static quint32 getGramKey(const QChar *data, int length);
+    static QVector<RowRange> toRowRanges(const QVector<int> &rows);
+    static int getRowCount(const QVector<RowRange> &ranges);
+};
+
+#endif // ADDRESSSEARCHINDEX_H
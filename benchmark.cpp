@@ -0,0 +1,646 @@
+#include "benchmark.h"
+
+#include <QApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QLabel>
+#include <QListView>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+#include "addressformat.h"
+#include "addressquery.h"
+#include "addresssearchindex.h"
+#include "customaddresslistwidget.h"
+#include "iptool.h"
+#include "scopetool.h"
+#include "sniffer.h"
+#include "snifferthread.h"
+#include "tracing.h"
+#include "whitelistfile.h"
+
+/* Results are summed in here so the timed work cannot be optimised away */
+static volatile quint64 benchmarkSink = 0;
+
+Benchmark::Benchmark(QObject *parent) : QObject(parent)
+{
+
+}
+
+void Benchmark::setFilter(QString filter)
+{
+    this->filter = filter;
+}
+
+bool Benchmark::isRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], BENCHMARK_ARGUMENT) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int Benchmark::main(QStringList arguments)
+{
+    Benchmark benchmark;
+
+    int index = arguments.indexOf(BENCHMARK_FILTER_ARGUMENT);
+    if (index != -1) {
+        benchmark.setFilter(arguments.value(index + 1));
+    }
+
+    QByteArray json = QJsonDocument(benchmark.run()).toJson();
+    int exitCode = benchmark.isPassed() ? 0 : 1;
+
+    index = arguments.indexOf(BENCHMARK_OUTPUT_ARGUMENT);
+    if (index == -1) {
+        QFile output;
+        output.open(stdout, QIODevice::WriteOnly);
+        output.write(json);
+        return exitCode;
+    }
+
+    QSaveFile file(arguments.value(index + 1));
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        qDebug() << "Unable to write" << file.fileName() << file.errorString();
+        return 1;
+    }
+
+    return exitCode;
+}
+
+bool Benchmark::isPassed()
+{
+    return passed;
+}
+
+QJsonObject Benchmark::run()
+{
+    results = QJsonArray();
+    passed = true;
+
+    benchmarkScope();
+    benchmarkBlockRanges();
+    benchmarkAddressList();
+    benchmarkStartup();
+    benchmarkIpTool();
+    benchmarkAddressFormat();
+    benchmarkDecoder();
+    benchmarkSearch();
+    benchmarkTracing();
+
+    QJsonObject report;
+    report["Version"] = BENCHMARK_FORMAT_VERSION;
+    report["Qt"] = QString(qVersion());
+    report["Abi"] = QSysInfo::buildAbi();
+    report["Time"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["Results"] = results;
+    report["Passed"] = passed;
+
+    return report;
+}
+
+void Benchmark::measure(QString name, int size, std::function<void()> setup, std::function<void()> body)
+{
+    if (!filter.isEmpty() && !name.contains(filter)) {
+        return;
+    }
+
+    // Repeat until the case has run long enough to be stable, but always at least once
+    QVector<qint64> times;
+    QElapsedTimer total;
+    total.start();
+    while (times.isEmpty() || (total.elapsed() < BENCHMARK_MIN_TIME_MS && times.count() < BENCHMARK_MAX_ITERATIONS)) {
+        if (setup) {
+            setup();
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        body();
+        times.append(timer.nsecsElapsed());
+    }
+
+    std::sort(times.begin(), times.end());
+
+    qint64 sum = 0;
+    for (int i = 0; i < times.count(); i += 1) {
+        sum += times[i];
+    }
+
+    qint64 median = times[times.count() / 2];
+
+    QJsonObject result;
+    result["Name"] = name;
+    result["Size"] = size;
+    result["Iterations"] = times.count();
+    result["MinNs"] = times.first();
+    result["MedianNs"] = median;
+    result["MeanNs"] = sum / times.count();
+    result["MedianNsPerItem"] = (double) median / qMax(size, 1);
+    result["ItemsPerSecond"] = (median > 0) ? size * 1000000000.0 / median : 0.0;
+    results.append(result);
+
+    qDebug() << name << size << median / 1000000.0 << "ms" << result["ItemsPerSecond"].toDouble() / 1000000.0 << "M/s";
+}
+
+void Benchmark::report(QString name, int size, QJsonObject counts)
+{
+    if (!filter.isEmpty() && !name.contains(filter)) {
+        return;
+    }
+
+    QJsonObject result = counts;
+    result["Name"] = name;
+    result["Size"] = size;
+    results.append(result);
+
+    qDebug() << name << size << counts;
+}
+
+QVector<quint32> Benchmark::getRandomAddresses(int count, quint32 seed)
+{
+    // Distinct addresses outside 0/8, 10/8, 127/8 and multicast, like a real whitelist
+    QRandomGenerator generator(seed);
+
+    QVector<quint32> addresses;
+    addresses.reserve(count);
+    QSet<quint32> seen;
+    while (addresses.count() < count) {
+        quint32 address = generator.generate();
+        quint32 firstOctet = address >> 24;
+        if (firstOctet == 0 || firstOctet == 10 || firstOctet == 127 || firstOctet >= 224 || seen.contains(address)) {
+            continue;
+        }
+
+        seen.insert(address);
+        addresses.append(address);
+    }
+
+    return addresses;
+}
+
+QVector<quint32> Benchmark::getWhitelistAddresses(int count, quint32 seed)
+{
+    // Mostly public peers, plus one in BENCHMARK_LOCAL_SHARE from a LAN, CGNAT or VPN block
+    QStringList localBlocks;
+    localBlocks.append("10.0.0.0/8");
+    localBlocks.append("100.64.0.0/10");
+    localBlocks.append("172.16.0.0/12");
+    localBlocks.append("192.168.0.0/16");
+    QList<AddressRange> localRanges = ScopeTool::parseRanges(localBlocks);
+    QList<AddressRange> reserved = ScopeTool::getReservedRanges();
+
+    QRandomGenerator generator(seed);
+
+    QVector<quint32> addresses;
+    addresses.reserve(count);
+    QSet<quint32> seen;
+    while (addresses.count() < count) {
+        quint32 address;
+        if (addresses.count() % BENCHMARK_LOCAL_SHARE == BENCHMARK_LOCAL_SHARE - 1) {
+            AddressRange range = localRanges[addresses.count() / BENCHMARK_LOCAL_SHARE % localRanges.count()];
+            address = range.first + generator.bounded(range.second - range.first + 1);
+        } else {
+            address = generator.generate();
+
+            bool isReserved = false;
+            for (int i = 0; i < reserved.count() && !isReserved; i += 1) {
+                isReserved = (address >= reserved[i].first && address <= reserved[i].second);
+            }
+
+            if (isReserved) {
+                continue;
+            }
+        }
+
+        if (seen.contains(address)) {
+            continue;
+        }
+
+        seen.insert(address);
+        addresses.append(address);
+    }
+
+    return addresses;
+}
+
+QList<QByteArray> Benchmark::getPackets(int count)
+{
+    // Ethernet frames carrying UDP on the session port, one IPv6 for every three IPv4
+    QRandomGenerator generator(BENCHMARK_SEED);
+
+    QList<QByteArray> packets;
+    for (int i = 0; i < count; i += 1) {
+        bool ipv6 = (i % 4 == 3);
+        int ipLength = ipv6 ? IPV6_HEADER_LENGTH : 20;
+
+        QByteArray packet(ETHERNET_HEADER_LENGTH + ipLength + (int) sizeof(udp_header), '\0');
+        uchar *data = (uchar *) packet.data();
+        qToBigEndian<quint16>(ipv6 ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4, data + 12);
+
+        uchar *ip = data + ETHERNET_HEADER_LENGTH;
+        if (ipv6) {
+            ip[0] = 0x60;
+            ip[6] = IPPROTO_UDP_NUMBER;
+            for (int j = 8; j < IPV6_HEADER_LENGTH; j += 1) {
+                ip[j] = (uchar) generator.bounded(256);
+            }
+            ip[8] = 0x20;
+            ip[24] = 0x20;
+        } else {
+            ip[0] = 0x45;
+            ip[9] = IPPROTO_UDP_NUMBER;
+            qToBigEndian<quint32>(getRandomAddresses(1, generator.generate()).first(), ip + 12);
+            qToBigEndian<quint32>(getRandomAddresses(1, generator.generate()).first(), ip + 16);
+        }
+
+        uchar *udp = ip + ipLength;
+        qToBigEndian<quint16>(SNIFF_PORT, udp);
+        qToBigEndian<quint16>(SNIFF_PORT, udp + 2);
+
+        packets.append(packet);
+    }
+
+    return packets;
+}
+
+void Benchmark::benchmarkScope()
+{
+    QList<AddressRange> universe = ScopeTool::subtractRanges(AddressRange(0, 0xFFFFFFFFu), ScopeTool::getReservedRanges());
+
+    for (int size = 10; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getRandomAddresses(size, BENCHMARK_SEED);
+
+        // The same steps as MainWindow::getScopeForAddresses, without the settings lookups
+        measure("scope.getAddressScope", size, nullptr, [&]() {
+            QList<AddressRange> singleRanges;
+            singleRanges.reserve(addresses.count());
+            for (int i = 0; i < addresses.count(); i += 1) {
+                singleRanges.append(AddressRange(addresses[i], addresses[i]));
+            }
+
+            QList<AddressRange> blockRanges = ScopeTool::getBlockRangesForRanges(ScopeTool::mergeRanges(singleRanges), universe);
+            benchmarkSink += ScopeTool::formatRanges(blockRanges).length();
+        });
+    }
+}
+
+void Benchmark::benchmarkBlockRanges()
+{
+    // Block ranges a whitelist needs with the old fixed universe and with reserved space trimmed
+    AddressRange bounds;
+    ScopeTool::parseRange(BENCHMARK_LEGACY_UNIVERSE, &bounds);
+
+    QList<AddressRange> legacyUniverse;
+    legacyUniverse.append(bounds);
+    QList<AddressRange> trimmedUniverse = ScopeTool::subtractRanges(bounds, ScopeTool::getReservedRanges());
+
+    for (int size = 10; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getWhitelistAddresses(size, BENCHMARK_SEED);
+
+        QList<AddressRange> singleRanges;
+        singleRanges.reserve(addresses.count());
+        for (int i = 0; i < addresses.count(); i += 1) {
+            singleRanges.append(AddressRange(addresses[i], addresses[i]));
+        }
+        QList<AddressRange> allowedRanges = ScopeTool::mergeRanges(singleRanges);
+
+        int legacyRanges = ScopeTool::getBlockRangesForRanges(allowedRanges, legacyUniverse).count();
+        int trimmedRanges = ScopeTool::getBlockRangesForRanges(allowedRanges, trimmedUniverse).count();
+
+        QJsonObject counts;
+        counts["LegacyRanges"] = legacyRanges;
+        counts["TrimmedRanges"] = trimmedRanges;
+        counts["ReductionPercent"] = (legacyRanges > 0) ? 100.0 * (legacyRanges - trimmedRanges) / legacyRanges : 0.0;
+        report("scope.blockRanges", size, counts);
+    }
+}
+
+void Benchmark::benchmarkAddressList()
+{
+    QListView listView;
+    QLabel label;
+    CustomAddressListWidget *listWidget = nullptr;
+
+    // Each iteration starts from an empty list
+    std::function<void()> setup = [&]() {
+        CustomAddressListWidget *previous = listWidget;
+        listWidget = new CustomAddressListWidget(&listView, &label);
+        delete previous;
+    };
+
+    for (int size = 10; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getRandomAddresses(size, BENCHMARK_SEED);
+        QStringList texts;
+        texts.reserve(size);
+        for (int i = 0; i < size; i += 1) {
+            texts.append(AddressFormat::toString(addresses[i]));
+        }
+
+        measure("list.addAddressToList", size, setup, [&]() {
+            for (int i = 0; i < texts.count(); i += 1) {
+                benchmarkSink += listWidget->addAddressToList(texts[i]);
+            }
+        });
+
+        measure("list.addAddressesToList", size, setup, [&]() {
+            benchmarkSink += listWidget->addAddressesToList(texts).count();
+        });
+    }
+
+    delete listWidget;
+}
+
+void Benchmark::benchmarkStartup()
+{
+    // Cold start of the list from each format, from reading the file to a filled list
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        return;
+    }
+
+    QString jsonFilename = dir.filePath("settings.json");
+    QString binaryFilename = dir.filePath("whitelist.bin");
+
+    QListView listView;
+    QLabel label;
+    CustomAddressListWidget *listWidget = nullptr;
+
+    std::function<void()> setup = [&]() {
+        CustomAddressListWidget *previous = listWidget;
+        listWidget = new CustomAddressListWidget(&listView, &label);
+        delete previous;
+    };
+
+    for (int size = 1000; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getWhitelistAddresses(size, BENCHMARK_SEED);
+        QJsonArray jsonArray;
+        QVector<Ipv4Address> ipv4Addresses;
+        ipv4Addresses.reserve(size);
+        for (int i = 0; i < size; i += 1) {
+            jsonArray.append(AddressFormat::toString(addresses[i]));
+            ipv4Addresses.append(Ipv4Address(addresses[i]));
+        }
+        std::sort(ipv4Addresses.begin(), ipv4Addresses.end());
+
+        QJsonObject settings;
+        settings["Addresses"] = jsonArray;
+        QSaveFile jsonFile(jsonFilename);
+        if (!jsonFile.open(QIODevice::WriteOnly) || jsonFile.write(QJsonDocument(settings).toJson()) < 0 || !jsonFile.commit()) {
+            return;
+        }
+
+        if (!WhitelistFile::write(binaryFilename, ipv4Addresses, QVector<Ipv6Address>())) {
+            return;
+        }
+
+        measure("startup.loadJson", size, setup, [&]() {
+            QFile file(jsonFilename);
+            file.open(QIODevice::ReadOnly);
+            QJsonArray array = QJsonDocument::fromJson(file.readAll()).object()["Addresses"].toArray();
+
+            QStringList texts;
+            texts.reserve(array.count());
+            for (int i = 0; i < array.count(); i += 1) {
+                texts.append(array[i].toString());
+            }
+
+            benchmarkSink += listWidget->addAddressesToList(texts).count();
+        });
+
+        measure("startup.loadBinary", size, setup, [&]() {
+            WhitelistFile file;
+            QVector<Ipv4Address> loaded;
+            QVector<Ipv6Address> loaded6;
+            if (file.open(binaryFilename) && file.getAddresses(&loaded, &loaded6)) {
+                benchmarkSink += listWidget->addAddressesToList(loaded, loaded6);
+            }
+        });
+    }
+
+    delete listWidget;
+}
+
+void Benchmark::benchmarkIpTool()
+{
+    for (int size = 10; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getRandomAddresses(size, BENCHMARK_SEED);
+        QStringList texts;
+        texts.reserve(size);
+        for (int i = 0; i < size; i += 1) {
+            texts.append(AddressFormat::toString(addresses[i]));
+        }
+
+        // Before the hand-written parser: a freshly compiled regex, then QHostAddress parsing the text again
+        measure("iptool.regex", size, nullptr, [&]() {
+            for (int i = 0; i < texts.count(); i += 1) {
+                QRegularExpression re(BENCHMARK_REGEX_IP_PATTERN);
+                if (!re.match(texts[i]).hasMatch()) {
+                    continue;
+                }
+
+                QHostAddress hostAddress;
+                if (hostAddress.setAddress(texts[i])) {
+                    benchmarkSink += hostAddress.toIPv4Address();
+                }
+            }
+        });
+
+        measure("iptool.parseIpv4Address", size, nullptr, [&]() {
+            for (int i = 0; i < texts.count(); i += 1) {
+                quint32 address = 0;
+                IPTool::parseIpv4Address(texts[i].constData(), texts[i].size(), &address);
+                benchmarkSink += address;
+            }
+        });
+
+        measure("iptool.getAnyQHostAddress", size, nullptr, [&]() {
+            for (int i = 0; i < texts.count(); i += 1) {
+                benchmarkSink += IPTool::getAnyQHostAddress(texts[i]).toIPv4Address();
+            }
+        });
+
+        // The bulk API over one buffer of newline-separated addresses, as an imported file would be
+        QByteArray buffer = texts.join("\n").toLatin1();
+        QVector<quint32> parsed;
+        parsed.reserve(size);
+        measure("iptool.parseIpv4Addresses", size, [&]() {
+            parsed.clear();
+        }, [&]() {
+            benchmarkSink += IPTool::parseIpv4Addresses(buffer.constData(), buffer.size(), &parsed);
+        });
+    }
+}
+
+void Benchmark::benchmarkAddressFormat()
+{
+    for (int size = 10; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getRandomAddresses(size, BENCHMARK_SEED);
+
+        measure("addressformat.toString", size, nullptr, [&]() {
+            for (int i = 0; i < addresses.count(); i += 1) {
+                benchmarkSink += AddressFormat::toString(addresses[i]).length();
+            }
+        });
+    }
+}
+
+void Benchmark::benchmarkDecoder()
+{
+    QList<QByteArray> packets = getPackets(64);
+    QVector<struct pcap_pkthdr> headers(packets.count());
+    for (int i = 0; i < packets.count(); i += 1) {
+        memset(&headers[i], 0, sizeof(struct pcap_pkthdr));
+        headers[i].caplen = packets[i].size();
+        headers[i].len = packets[i].size();
+    }
+
+    for (int size = 1; size <= 1000000; size *= 100) {
+        measure("snifferthread.decodePacket", size, nullptr, [&]() {
+            for (int i = 0; i < size; i += 1) {
+                int index = i % packets.count();
+                QMap<QString, QVariant> result;
+                if (SnifferThread::decodePacket(&headers[index], (const u_char *) packets[index].constData(), &result)) {
+                    benchmarkSink += result.count();
+                }
+            }
+        });
+    }
+}
+
+void Benchmark::benchmarkSearch()
+{
+    QStringList keystrokes;
+    keystrokes.append("1");
+    keystrokes.append("19");
+    keystrokes.append("192");
+    keystrokes.append("192.");
+    keystrokes.append("192.1");
+    keystrokes.append("*.2");
+    keystrokes.append("*.25");
+    keystrokes.append("*.255");
+    keystrokes.append("192.0.0.0/8");
+
+    for (int size = 10; size <= 100000; size *= 10) {
+        QVector<quint32> addresses = getRandomAddresses(size, BENCHMARK_SEED);
+        QVector<Ipv4Address> ipv4Addresses;
+        ipv4Addresses.reserve(size);
+        for (int i = 0; i < size; i += 1) {
+            ipv4Addresses.append(Ipv4Address(addresses[i]));
+        }
+
+        AddressListModel model;
+        model.insertAddresses(ipv4Addresses, QVector<Ipv6Address>());
+
+        AddressSearchIndex searchIndex(&model);
+        searchIndex.search(AddressQuery::parse("*0"));
+
+        // One iteration types the whole sequence, starting from an unfiltered list
+        measure("search.keystrokes", size, [&]() {
+            searchIndex.search(AddressQuery::parse(QString()));
+        }, [&]() {
+            for (int i = 0; i < keystrokes.count(); i += 1) {
+                benchmarkSink += searchIndex.search(AddressQuery::parse(keystrokes[i])).count();
+            }
+        });
+    }
+
+    // Checked the way the list filter types: never through the empty query, on a fresh index and after edits
+    QStringList queries = keystrokes;
+    queries.append("*2A00");
+    queries.append("*2a00:1");
+    queries.append("2a00");
+    queries.append("2a00:");
+    queries.append("*:");
+
+    QVector<quint32> addresses = getRandomAddresses(2000, BENCHMARK_SEED);
+    QVector<Ipv4Address> firstAddresses;
+    QVector<Ipv4Address> laterAddresses;
+    QVector<Ipv6Address> addresses6;
+    for (int i = 0; i < 1000; i += 1) {
+        firstAddresses.append(Ipv4Address(addresses[i]));
+        laterAddresses.append(Ipv4Address(addresses[1000 + i]));
+        if (i < 200) {
+            addresses6.append(Ipv6Address(0x2a00000000000000ull | addresses[i], addresses[1000 + i]));
+        }
+    }
+
+    AddressListModel model;
+    model.insertAddresses(firstAddresses, addresses6);
+    AddressSearchIndex searchIndex(&model);
+
+    int mismatches = 0;
+    for (int pass = 0; pass < 2; pass += 1) {
+        for (int i = 0; i < queries.count(); i += 1) {
+            AddressQuery query = AddressQuery::parse(queries[i]);
+
+            QVector<bool> found(model.rowCount(), false);
+            QVector<RowRange> ranges = searchIndex.search(query);
+            for (int j = 0; j < ranges.count(); j += 1) {
+                for (int row = ranges[j].first; row <= ranges[j].second; row += 1) {
+                    found[row] = true;
+                }
+            }
+
+            for (int row = 0; row < model.rowCount(); row += 1) {
+                if (found[row] != query.matches(model.getAddressText(row))) {
+                    mismatches += 1;
+                }
+            }
+        }
+
+        // The second pass starts on a list that changed while a query was active
+        model.insertAddresses(laterAddresses, QVector<Ipv6Address>());
+    }
+
+    QJsonObject counts;
+    counts["Queries"] = 2 * queries.count();
+    counts["Mismatches"] = mismatches;
+    report("search.matchesScan", model.rowCount(), counts);
+
+    if (mismatches > 0) {
+        passed = false;
+    }
+}
+
+void Benchmark::benchmarkTracing()
+{
+    // Cost of a span with tracing off (the switch is read) and on (written to the ring)
+    bool wasEnabled = Tracing::isEnabled();
+
+    for (int size = 1000; size <= 1000000; size *= 1000) {
+        measure("tracing.span.disabled", size, [&]() {
+            Tracing::setEnabled(false);
+        }, [&]() {
+            for (int i = 0; i < size; i += 1) {
+                TraceSpan span("benchmark.span");
+                benchmarkSink += i;
+            }
+        });
+
+        measure("tracing.span.enabled", size, [&]() {
+            Tracing::setEnabled(true);
+        }, [&]() {
+            for (int i = 0; i < size; i += 1) {
+                TraceSpan span("benchmark.span");
+                benchmarkSink += i;
+            }
+        });
+    }
+
+    Tracing::setEnabled(wasEnabled);
+}
@@ -0,0 +1,67 @@
+#include <QObject>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QVector>
+#include <functional>
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#define BENCHMARK_ARGUMENT "--benchmark"
+#define BENCHMARK_OUTPUT_ARGUMENT "--benchmark-output"
+#define BENCHMARK_FILTER_ARGUMENT "--benchmark-filter"
+#define BENCHMARK_FORMAT_VERSION 1
+#define BENCHMARK_MIN_TIME_MS 200
+#define BENCHMARK_MAX_ITERATIONS 1000
+#define BENCHMARK_SEED 6672
+#define BENCHMARK_LEGACY_UNIVERSE "1.1.1.1-255.255.255.254"
+#define BENCHMARK_LOCAL_SHARE 8
+/* The validation IPTool did per call before the hand-written parser, kept as the baseline */
+#define BENCHMARK_REGEX_IP_PATTERN "^((25[0-5]|(2[0-4]|1[0-9]|[1-9]|)[0-9])(\\.(?!$)|$)){4}$"
+
+/*
+ * Times the hot paths (scope building, list inserts, address parsing and
+ * formatting, packet decoding, list search, trace spans and loading the list
+ * at startup from settings.json or whitelist.bin) over a range of
+ * sizes and reports them as JSON, so runs from different commits can be diffed.
+ * Every case uses fixed seeds, and setup is kept out of the timed section.
+ * Cases that are not about time (block range counts) report their counts.
+ * The search is also checked against a plain scan of every row; a mismatch
+ * fails the run with exit code 1.
+ */
+class Benchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Benchmark(QObject *parent = nullptr);
+    void setFilter(QString filter);
+    QJsonObject run();
+    bool isPassed();
+
+    static bool isRequested(int argc, char *argv[]);
+    static int main(QStringList arguments);
+
+private:
+    QString filter;
+    QJsonArray results;
+    bool passed = true;
+
+    void measure(QString name, int size, std::function<void()> setup, std::function<void()> body);
+    void report(QString name, int size, QJsonObject counts);
+    void benchmarkScope();
+    void benchmarkBlockRanges();
+    void benchmarkAddressList();
+    void benchmarkStartup();
+    void benchmarkIpTool();
+    void benchmarkAddressFormat();
+    void benchmarkDecoder();
+    void benchmarkSearch();
+    void benchmarkTracing();
+
+    static QVector<quint32> getRandomAddresses(int count, quint32 seed);
+    static QVector<quint32> getWhitelistAddresses(int count, quint32 seed);
+    static QList<QByteArray> getPackets(int count);
+};
+
+#endif // BENCHMARK_H
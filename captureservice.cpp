@@ -0,0 +1,161 @@
+#include "captureservice.h"
+
+CaptureService::CaptureService(QObject *parent) : QObject(parent)
+{
+    sessionTracker = new SessionTracker(CAPTURE_RECENT_SECS, this);
+
+    interfaceTimer = new QTimer(this);
+    interfaceTimer->setInterval(CAPTURE_INTERFACE_POLL_MS);
+    connect(interfaceTimer, &QTimer::timeout, this, &CaptureService::onInterfaceTimeout);
+
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(CAPTURE_IDLE_CLOSE_MS);
+    connect(idleTimer, &QTimer::timeout, this, &CaptureService::onIdleTimeout);
+}
+
+Sniffer *CaptureService::getSniffer()
+{
+    // Npcap is loaded and the devices are listed on first use, not at startup
+    if (sniffer == nullptr) {
+        sniffer = new Sniffer(this);
+        connect(sniffer, &Sniffer::devicesChanged, this, &CaptureService::onDevicesChanged);
+
+        interfaceFingerprint = getInterfaceFingerprint();
+        interfaceTimer->start();
+    }
+
+    return sniffer;
+}
+
+bool CaptureService::start(QString deviceName)
+{
+    static MetricCounter *warmCounter = Metrics::counter("capture_warm_starts_total", "Sessions started on an adapter that was already open");
+    static MetricCounter *openCounter = Metrics::counter("capture_adapter_opens_total", "Times a capture adapter was opened");
+
+    if (isCapturing(deviceName)) {
+        warmCounter->add();
+        viewCount += 1;
+        idleTimer->stop();
+        return true;
+    }
+
+    // Peers remembered from another device are not in this session
+    stop();
+
+    if (!getSniffer()->startSniffing(deviceName)) {
+        return false;
+    }
+
+    openCounter->add();
+    this->deviceName = deviceName;
+    localAddresses = sniffer->getDeviceAddresses(deviceName);
+
+    // Same selection as the session view: packets our own address sent from the game port
+    sniffer->addSightingSink(sessionTracker, localAddresses);
+
+    viewCount += 1;
+    idleTimer->stop();
+
+    return true;
+}
+
+void CaptureService::release()
+{
+    viewCount = qMax(viewCount - 1, 0);
+    if (viewCount == 0 && !deviceName.isEmpty()) {
+        idleTimer->start();
+    }
+}
+
+void CaptureService::stop()
+{
+    if (sniffer != nullptr) {
+        sniffer->removeSightingSink(sessionTracker);
+        sniffer->stopSniffing();
+    }
+
+    idleTimer->stop();
+    deviceName.clear();
+    localAddresses.clear();
+    sessionTracker->clear();
+}
+
+bool CaptureService::isCapturing(QString deviceName)
+{
+    return sniffer != nullptr && sniffer->isSniffing(deviceName);
+}
+
+QString CaptureService::getDevice()
+{
+    return deviceName;
+}
+
+QVector<SessionEntry> CaptureService::getRecentSightings()
+{
+    return sessionTracker->takeSnapshot(QDateTime::currentSecsSinceEpoch()).entries;
+}
+
+void CaptureService::onInterfaceTimeout()
+{
+    static MetricCounter *refreshCounter = Metrics::counter("capture_device_refreshes_total", "Device list reads caused by interface changes");
+
+    // Also lets peers that went quiet expire while no session view is open
+    sessionTracker->takeSnapshot(QDateTime::currentSecsSinceEpoch());
+
+    // Listing the interfaces is cheap, asking Npcap for its device list is not
+    QByteArray fingerprint = getInterfaceFingerprint();
+    if (fingerprint == interfaceFingerprint) {
+        return;
+    }
+
+    interfaceFingerprint = fingerprint;
+    refreshCounter->add();
+
+    sniffer->refreshDevices();
+}
+
+void CaptureService::onDevicesChanged()
+{
+    // The adapter we capture on is gone or has other addresses now
+    if (!deviceName.isEmpty()) {
+        if (sniffer->getDeviceIndex(deviceName) == -1) {
+            stop();
+        } else if (sniffer->getDeviceAddresses(deviceName) != localAddresses) {
+            localAddresses = sniffer->getDeviceAddresses(deviceName);
+            sniffer->addSightingSink(sessionTracker, localAddresses);
+        }
+    }
+
+    emit devicesChanged();
+}
+
+void CaptureService::onIdleTimeout()
+{
+    static MetricCounter *idleCloseCounter = Metrics::counter("capture_idle_closes_total", "Adapters closed after no session view used them for a while");
+
+    if (viewCount > 0 || deviceName.isEmpty()) {
+        return;
+    }
+
+    idleCloseCounter->add();
+    stop();
+}
+
+QByteArray CaptureService::getInterfaceFingerprint()
+{
+    QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
+
+    QStringList parts;
+    for (int i = 0; i < interfaces.count(); i += 1) {
+        parts.append(interfaces[i].name());
+        parts.append(QString::number((int) interfaces[i].flags()));
+
+        QList<QNetworkAddressEntry> entries = interfaces[i].addressEntries();
+        for (int j = 0; j < entries.count(); j += 1) {
+            parts.append(entries[j].ip().toString());
+        }
+    }
+
+    return QCryptographicHash::hash(parts.join(";").toUtf8(), QCryptographicHash::Sha1);
+}
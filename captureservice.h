@@ -0,0 +1,60 @@
+#include <QObject>
+#include <QTimer>
+#include <QDateTime>
+#include <QNetworkInterface>
+#include <QCryptographicHash>
+
+#include "sniffer.h"
+#include "sessiontracker.h"
+#include "metrics.h"
+
+#ifndef CAPTURESERVICE_H
+#define CAPTURESERVICE_H
+
+#define CAPTURE_INTERFACE_POLL_MS 2000
+#define CAPTURE_RECENT_SECS 5
+#define CAPTURE_IDLE_CLOSE_MS (10 * 60 * 1000)
+
+/*
+ * Keeps one Sniffer for the lifetime of the program. The device list is read
+ * once and only read again, in the background, when the host's interfaces
+ * change. The adapter a session was started on stays open after the session
+ * view closes, and the peers it keeps seeing are recorded on the capture
+ * thread, so reopening the view on the same device shows them on the first
+ * frame. Each successful start() is released by its view; the adapter closes
+ * once no view has held it for CAPTURE_IDLE_CLOSE_MS.
+ */
+class CaptureService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureService(QObject *parent = nullptr);
+    Sniffer *getSniffer();
+    bool start(QString deviceName);
+    void release();
+    void stop();
+    bool isCapturing(QString deviceName);
+    QString getDevice();
+    QVector<SessionEntry> getRecentSightings();
+
+private:
+    Sniffer *sniffer = nullptr;
+    SessionTracker *sessionTracker;
+    QTimer *interfaceTimer;
+    QTimer *idleTimer;
+    int viewCount = 0;
+    QByteArray interfaceFingerprint;
+    QString deviceName;
+    QStringList localAddresses;
+
+    void onInterfaceTimeout();
+    void onDevicesChanged();
+    void onIdleTimeout();
+    static QByteArray getInterfaceFingerprint();
+
+signals:
+    void devicesChanged();
+};
+
+#endif // CAPTURESERVICE_H
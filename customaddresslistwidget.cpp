@@ -1,23 +1,32 @@
 #include "customaddresslistwidget.h"
 
-CustomAddressListWidget::CustomAddressListWidget(QListWidget *listWidget, QLabel *selectCountLabel, bool customContextMenu, QObject *parent): QObject(parent)
+#include <algorithm>
+
+CustomAddressListWidget::CustomAddressListWidget(QListView *listView, QLabel *selectCountLabel, bool customContextMenu, QObject *parent): QObject(parent)
 {
-    this->listWidget = listWidget;
+    this->listView = listView;
     this->selectCountLabel = selectCountLabel;
 
     selectCountLabel->setText("");
 
+    // Every row has the same height, so the view never has to measure rows it does not paint
+    model = new AddressListModel(this);
+    filterModel = new AddressFilterModel(model, this);
+    listView->setUniformItemSizes(true);
+    listView->setModel(filterModel);
+
     if (customContextMenu) {
-        listWidget->setContextMenuPolicy(Qt::CustomContextMenu);
-        connect(listWidget, &QListWidget::customContextMenuRequested, this, &CustomAddressListWidget::onCustomContextMenuRequested);
+        listView->setContextMenuPolicy(Qt::CustomContextMenu);
+        connect(listView, &QListView::customContextMenuRequested, this, &CustomAddressListWidget::onCustomContextMenuRequested);
     }
 
-    connect(listWidget, &QListWidget::itemSelectionChanged, this, &CustomAddressListWidget::onListSelectionChanged);
+    connect(listView->selectionModel(), &QItemSelectionModel::selectionChanged, this, &CustomAddressListWidget::onListSelectionChanged);
+    connect(filterModel, &QAbstractItemModel::modelReset, this, &CustomAddressListWidget::onListSelectionChanged);
 }
 
 void CustomAddressListWidget::onListSelectionChanged()
 {
-    int count = listWidget->selectedItems().count();
+    int count = listView->selectionModel()->selectedRows().count();
     if (count == 0) {
         selectCountLabel->clear();
         return;
@@ -28,11 +37,11 @@ void CustomAddressListWidget::onListSelectionChanged()
 
 void CustomAddressListWidget::onCustomContextMenuRequested(const QPoint &pos)
 {
-    if (listWidget->selectedItems().isEmpty()) {
+    if (!listView->selectionModel()->hasSelection()) {
         return;
     }
 
-    QPoint globalPos = listWidget->mapToGlobal(pos);
+    QPoint globalPos = listView->mapToGlobal(pos);
 
     QMenu menu;
     menu.addAction("Remove Selected", this, &CustomAddressListWidget::removeSelection);
@@ -43,72 +52,226 @@ void CustomAddressListWidget::removeSelection()
 {
     QMap<QString, QVariant> removedItems;
 
-    QList<QListWidgetItem *> items = listWidget->selectedItems();
-    for (int i = 0; i < items.count(); i += 1) {
-        QListWidgetItem *item = items[i];
-
-        removedItems[item->text()] = item->data(Qt::UserRole);
-
-        listWidget->removeItemWidget(item);
-        delete item;
+    QList<int> rows = getSelectedRows();
+    for (int i = 0; i < rows.count(); i += 1) {
+        QString address = model->getAddressText(rows[i]);
+        removedItems[address] = address;
     }
 
+    model->removeAddressRows(rows);
+
     emit selectionRemoved(removedItems);
 }
 
 int CustomAddressListWidget::addAddressToList(QString address)
 {
-    QHostAddress hostAddress = IPTool::getQHostAddress(address);
-    if (hostAddress.isNull()) {
-        return -1;
+    bool ok = false;
+    Ipv4Address ipv4Address = Ipv4Address::fromString(address, &ok);
+    if (ok) {
+        return model->insertAddress(ipv4Address);
     }
 
-    int row = 0;
-    for (int i = 0; i < listWidget->count(); i += 1) {
-        QHostAddress hostAddress2 = QHostAddress(listWidget->item(i)->text());
-        if (!hostAddress2.isNull() && hostAddress.toIPv4Address() < hostAddress2.toIPv4Address()) {
-            break;
+    QHostAddress hostAddress = IPTool::getIpv6QHostAddress(address);
+    if (!hostAddress.isNull()) {
+        return model->insertAddress(Ipv6Address::fromQHostAddress(hostAddress));
+    }
+
+    return -1;
+}
+
+int CustomAddressListWidget::addAddressToList(Ipv4Address address)
+{
+    return model->insertAddress(address);
+}
+
+int CustomAddressListWidget::addAddressToList(Ipv6Address address)
+{
+    return model->insertAddress(address);
+}
+
+QStringList CustomAddressListWidget::addAddressesToList(QStringList addresses, QStringList *duplicates, QStringList *invalid)
+{
+    // The list is checked by bisection and the batch itself through hash sets, nothing is compared as text
+    QVector<Ipv4Address> ipv4Addresses;
+    QVector<Ipv6Address> ipv6Addresses;
+    QSet<Ipv4Address> batch;
+    QSet<Ipv6Address> batch6;
+    for (int i = 0; i < addresses.count(); i += 1) {
+        bool ok = false;
+        Ipv4Address ipv4Address = Ipv4Address::fromString(addresses[i], &ok);
+        if (ok) {
+            if (model->contains(ipv4Address) || batch.contains(ipv4Address)) {
+                if (duplicates != nullptr) {
+                    duplicates->append(ipv4Address.toString());
+                }
+            } else {
+                batch.insert(ipv4Address);
+                ipv4Addresses.append(ipv4Address);
+            }
+
+            continue;
+        }
+
+        QHostAddress hostAddress = IPTool::getIpv6QHostAddress(addresses[i]);
+        if (hostAddress.isNull()) {
+            if (invalid != nullptr) {
+                invalid->append(addresses[i]);
+            }
+
+            continue;
+        }
+
+        Ipv6Address ipv6Address = Ipv6Address::fromQHostAddress(hostAddress);
+        if (model->contains(ipv6Address) || batch6.contains(ipv6Address)) {
+            if (duplicates != nullptr) {
+                duplicates->append(ipv6Address.toString());
+            }
+        } else {
+            batch6.insert(ipv6Address);
+            ipv6Addresses.append(ipv6Address);
         }
+    }
+
+    std::sort(ipv4Addresses.begin(), ipv4Addresses.end());
+    std::sort(ipv6Addresses.begin(), ipv6Addresses.end());
 
-        row += 1;
+    QStringList added;
+    added.reserve(ipv4Addresses.count() + ipv6Addresses.count());
+    for (int i = 0; i < ipv4Addresses.count(); i += 1) {
+        added.append(ipv4Addresses[i].toString());
+    }
+    for (int i = 0; i < ipv6Addresses.count(); i += 1) {
+        added.append(ipv6Addresses[i].toString());
     }
 
-    QListWidgetItem *item = new QListWidgetItem(address);
-    item->setData(Qt::UserRole, address);
-    listWidget->insertItem(row, item);
+    model->insertAddresses(ipv4Addresses, ipv6Addresses);
 
-    return row;
+    return added;
+}
+
+QString CustomAddressListWidget::getAddReport(int addedCount, QStringList duplicates, QStringList invalid)
+{
+    if (duplicates.isEmpty() && invalid.isEmpty()) {
+        return QString();
+    }
+
+    QStringList lines;
+    lines.append(QString("%1 IP Address(es) added").arg(addedCount));
+
+    QList<QPair<QString, QStringList>> groups;
+    groups.append(QPair<QString, QStringList>("already exist", duplicates));
+    groups.append(QPair<QString, QStringList>("are invalid", invalid));
+    for (int i = 0; i < groups.count(); i += 1) {
+        QStringList addresses = groups[i].second;
+        if (addresses.isEmpty()) {
+            continue;
+        }
+
+        lines.append("");
+        lines.append(QString("%1 IP Address(es) %2:").arg(addresses.count()).arg(groups[i].first));
+        lines.append(addresses.mid(0, ADD_REPORT_MAX_LISTED).join("\n"));
+        if (addresses.count() > ADD_REPORT_MAX_LISTED) {
+            lines.append(QString("... and %1 more").arg(addresses.count() - ADD_REPORT_MAX_LISTED));
+        }
+    }
+
+    return lines.join("\n");
+}
+
+int CustomAddressListWidget::addAddressesToList(QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6)
+{
+    return model->insertAddresses(addresses, addresses6);
+}
+
+bool CustomAddressListWidget::containsAddress(QString address)
+{
+    bool ok = false;
+    Ipv4Address ipv4Address = Ipv4Address::fromString(address, &ok);
+    if (ok) {
+        return model->contains(ipv4Address);
+    }
+
+    QHostAddress hostAddress = IPTool::getIpv6QHostAddress(address);
+    if (!hostAddress.isNull()) {
+        return model->contains(Ipv6Address::fromQHostAddress(hostAddress));
+    }
+
+    return false;
+}
+
+void CustomAddressListWidget::clearAddresses()
+{
+    model->clear();
+}
+
+int CustomAddressListWidget::getAddressCount()
+{
+    return model->rowCount();
+}
+
+QString CustomAddressListWidget::getAddress(int row)
+{
+    return model->getAddressText(row);
+}
+
+QVector<Ipv4Address> CustomAddressListWidget::getIpv4Addresses()
+{
+    return model->getIpv4Addresses();
+}
+
+QVector<Ipv6Address> CustomAddressListWidget::getIpv6Addresses()
+{
+    return model->getIpv6Addresses();
 }
 
 QStringList CustomAddressListWidget::getAddresses()
 {
+    int count = model->rowCount();
+
     QStringList addresses;
-    for (int i = 0; i < listWidget->count(); i += 1) {
-        QListWidgetItem *item = listWidget->item(i);
-        QVariant data = item->data(Qt::UserRole);
-        if (!data.isNull()) {
-            addresses.append(data.toString());
-        }
+    addresses.reserve(count);
+    for (int i = 0; i < count; i += 1) {
+        addresses.append(model->getAddressText(i));
     }
 
     return addresses;
 }
 
+QList<int> CustomAddressListWidget::getSelectedRows()
+{
+    // The view shows filtered rows, the model is addressed by its own
+    QModelIndexList indexes = listView->selectionModel()->selectedRows();
+
+    QList<int> rows;
+    rows.reserve(indexes.count());
+    for (int i = 0; i < indexes.count(); i += 1) {
+        QModelIndex index = filterModel->mapToSource(indexes[i]);
+        if (index.isValid()) {
+            rows.append(index.row());
+        }
+    }
+
+    return rows;
+}
+
 QStringList CustomAddressListWidget::getSelectedAddresses()
 {
-    QList<QListWidgetItem *> selectedItems = listWidget->selectedItems();
-    if (selectedItems.isEmpty()) {
+    QList<int> rows = getSelectedRows();
+    if (rows.isEmpty()) {
         return QStringList();
     }
 
     QStringList addresses;
-    for (int i = 0; i < selectedItems.count(); i += 1) {
-        QListWidgetItem *item = selectedItems[i];
-        QVariant data = item->data(Qt::UserRole);
-        if (!data.isNull()) {
-            addresses.append(data.toString());
-        }
+    for (int i = 0; i < rows.count(); i += 1) {
+        addresses.append(model->getAddressText(rows[i]));
     }
 
     return addresses;
 }
+
+int CustomAddressListWidget::setFilter(QString text)
+{
+    filterModel->setQuery(AddressQuery::parse(text));
+
+    return filterModel->rowCount();
+}
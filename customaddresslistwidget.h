@@ -1,31 +1,51 @@
 #include <QObject>
-#include <QListWidget>
+#include <QListView>
 #include <QLabel>
 #include <QMenu>
 #include <QHostAddress>
+#include <QSet>
 
 #include "iptool.h"
+#include "addresslistmodel.h"
+#include "addressfiltermodel.h"
 
 #ifndef CUSTOMADDRESSLISTWIDGET_H
 #define CUSTOMADDRESSLISTWIDGET_H
 
+#define ADD_REPORT_MAX_LISTED 20
+
 class CustomAddressListWidget : public QObject
 {
     Q_OBJECT
 
 public:
-    CustomAddressListWidget(QListWidget *listWidget, QLabel *selectCountLabel, bool customContextMenu = false, QObject *parent = nullptr);
+    CustomAddressListWidget(QListView *listView, QLabel *selectCountLabel, bool customContextMenu = false, QObject *parent = nullptr);
     int addAddressToList(QString address);
+    int addAddressToList(Ipv4Address address);
+    int addAddressToList(Ipv6Address address);
+    QStringList addAddressesToList(QStringList addresses, QStringList *duplicates = nullptr, QStringList *invalid = nullptr);
+    int addAddressesToList(QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6);
+    bool containsAddress(QString address);
+    void clearAddresses();
+    int getAddressCount();
+    QString getAddress(int row);
     QStringList getAddresses();
     QStringList getSelectedAddresses();
+    QVector<Ipv4Address> getIpv4Addresses();
+    QVector<Ipv6Address> getIpv6Addresses();
+    static QString getAddReport(int addedCount, QStringList duplicates, QStringList invalid);
+    int setFilter(QString text);
 
 private:
-    QListWidget *listWidget;
+    QListView *listView;
     QLabel *selectCountLabel;
+    AddressListModel *model;
+    AddressFilterModel *filterModel;
 
     void onListSelectionChanged();
     void onCustomContextMenuRequested(const QPoint &pos);
     void removeSelection();
+    QList<int> getSelectedRows();
 
 signals:
     void selectionRemoved(QMap<QString, QVariant> itemsRemoved);
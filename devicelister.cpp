@@ -0,0 +1,91 @@
+#include "devicelister.h"
+
+DeviceLister::DeviceLister(QObject *parent) : QObject(parent)
+{
+
+}
+
+void DeviceLister::refreshDevices(quint64 generation)
+{
+    static MetricHistogram *listHistogram = Metrics::histogram("capture_device_list_seconds", "Time to read the capture device list in the background");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<CaptureDevice> devices;
+    bool success = listDevices(&devices);
+    listHistogram->record(timer.nsecsElapsed());
+
+    emit devicesListed(generation, success, devices);
+}
+
+bool DeviceLister::listDevices(QVector<CaptureDevice> *devices)
+{
+    TraceSpan span("capture.loadDevices");
+
+    char errbuf[PCAP_ERRBUF_SIZE];
+    pcap_if_t *alldevs;
+
+    if (pcap_findalldevs_ex(PCAP_SRC_IF_STRING, NULL, &alldevs, errbuf) == -1)
+    {
+        qDebug() << "Error in pcap_findalldevs: " << QString(errbuf);
+        return false;
+    }
+
+    // The list is walked once into plain values and freed
+    for (pcap_if_t *d = alldevs; d != NULL; d = d->next) {
+        devices->append(getCaptureDevice(d));
+    }
+
+    pcap_freealldevs(alldevs);
+
+    return true;
+}
+
+CaptureDevice DeviceLister::getCaptureDevice(pcap_if_t *device)
+{
+    CaptureDevice captureDevice;
+    captureDevice.name = QString(device->name);
+    captureDevice.description = QString(device->description);
+    captureDevice.loopback = (device->flags & PCAP_IF_LOOPBACK) != 0;
+
+    for (pcap_addr_t *a = device->addresses; a; a = a->next) {
+        if (a->addr && a->addr->sa_family == AF_INET) {
+            QMap<QString, QVariant> addressInfo;
+
+            if (a->addr) {
+                addressInfo["Address"] = AddressFormat::toString4((const quint8 *) &((struct sockaddr_in *)a->addr)->sin_addr);
+            }
+
+            if (a->netmask) {
+                addressInfo["Netmask"] = AddressFormat::toString4((const quint8 *) &((struct sockaddr_in *)a->netmask)->sin_addr);
+            }
+
+            if (a->broadaddr) {
+                addressInfo["Broadcast"] = AddressFormat::toString4((const quint8 *) &((struct sockaddr_in *)a->broadaddr)->sin_addr);
+            }
+
+            if (a->dstaddr) {
+                addressInfo["Destination"] = AddressFormat::toString4((const quint8 *) &((struct sockaddr_in *)a->dstaddr)->sin_addr);
+            }
+
+            /* The filter uses the mask of the first IPv4 address, a class C network is assumed without one */
+            if (a->netmask && captureDevice.addresses.isEmpty()) {
+                captureDevice.netmask = ((struct sockaddr_in *)(a->netmask))->sin_addr.s_addr;
+            }
+
+            captureDevice.addressesWithInfo.append(addressInfo);
+            captureDevice.addresses.append(addressInfo["Address"].toString());
+        } else if (a->addr && a->addr->sa_family == AF_INET6) {
+            QMap<QString, QVariant> addressInfo;
+
+            // Formatted from the raw bytes, so no scope id and the same text as the decoded packet addresses
+            addressInfo["Address"] = AddressFormat::toString6((const quint8 *) &((struct sockaddr_in6 *)a->addr)->sin6_addr);
+
+            captureDevice.addressesWithInfo.append(addressInfo);
+            captureDevice.addresses.append(addressInfo["Address"].toString());
+        }
+    }
+
+    return captureDevice;
+}
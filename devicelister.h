@@ -0,0 +1,62 @@
+#include <QObject>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QVariant>
+#include <QVector>
+#include <QMetaType>
+
+#include <pcap.h>
+#ifdef Q_OS_WIN
+#include <Winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include "addressformat.h"
+#include "tracing.h"
+#include "metrics.h"
+
+#ifndef DEVICELISTER_H
+#define DEVICELISTER_H
+
+/* One capture device as it was when the device list was last read */
+struct CaptureDevice
+{
+    QString name;
+    QString description;
+    bool loopback = false;
+    u_int netmask = 0xffffff;
+    QList<QMap<QString, QVariant>> addressesWithInfo;
+    QStringList addresses;
+
+    bool operator==(const CaptureDevice &other) const
+    {
+        return name == other.name && description == other.description && loopback == other.loopback && addressesWithInfo == other.addressesWithInfo;
+    }
+};
+
+Q_DECLARE_METATYPE(CaptureDevice)
+
+/*
+ * Reads the device list, which can take Npcap a good part of a second. The
+ * Sniffer reads it directly the first time and through a DeviceLister on its
+ * own thread when the host's interfaces change.
+ */
+class DeviceLister : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DeviceLister(QObject *parent = nullptr);
+    void refreshDevices(quint64 generation);
+
+    static bool listDevices(QVector<CaptureDevice> *devices);
+
+private:
+    static CaptureDevice getCaptureDevice(pcap_if_t *device);
+
+signals:
+    void devicesListed(quint64 generation, bool success, QVector<CaptureDevice> devices);
+};
+
+#endif // DEVICELISTER_H
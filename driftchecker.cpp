@@ -0,0 +1,65 @@
+#include "driftchecker.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+DriftChecker::DriftChecker(QString backend, QString group, QObject *parent) : QObject(parent)
+{
+    this->backend = backend;
+    this->group = group;
+}
+
+void DriftChecker::readFingerprint(quint64 generation, bool isBaseline)
+{
+    TraceSpan span("drift.check");
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 cpuStartNs = getThreadCpuNs();
+
+    // Created on first use so it belongs to this thread (COM is initialised per thread)
+    if (firewallTool == nullptr) {
+        firewallTool = FirewallTool::create(backend, this);
+    }
+
+    QList<FirewallRule> rules = firewallTool->getRules(group, QString(), FirewallTool::FieldName | FirewallTool::FieldRemoteAddresses | FirewallTool::FieldEnabled);
+    bool ok = firewallTool->isInitialised() && !firewallTool->hasError();
+
+    QStringList entries;
+    for (int i = 0; i < rules.count(); i += 1) {
+        FirewallRule rule = rules[i];
+        entries.append(QString("%1|%2|%3").arg(rule.name, rule.remoteAddresses).arg(rule.enabled));
+    }
+    entries.sort();
+
+    QByteArray fingerprint = QCryptographicHash::hash(entries.join("\n").toUtf8(), QCryptographicHash::Md5);
+
+    emit fingerprintRead(generation, isBaseline, ok, fingerprint, timer.nsecsElapsed(), getThreadCpuNs() - cpuStartNs);
+}
+
+qint64 DriftChecker::getThreadCpuNs()
+{
+    // User and kernel time of the calling thread only. Work done for us by the firewall
+    // service or the nft process is not included.
+#ifdef Q_OS_WIN
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+
+    quint64 kernel = ((quint64) kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+    quint64 user = ((quint64) userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+
+    return (qint64) (kernel + user) * 100;
+#else
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return 0;
+    }
+
+    return (qint64) time.tv_sec * 1000000000 + time.tv_nsec;
+#endif
+}
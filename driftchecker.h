@@ -0,0 +1,33 @@
+#include <QObject>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+
+#include "firewalltool.h"
+
+#ifndef DRIFTCHECKER_H
+#define DRIFTCHECKER_H
+
+/*
+ * Does the firewall reads for DriftDetector, lives on its own thread. It opens
+ * its own FirewallTool there, the one of the main window belongs to the GUI thread.
+ */
+class DriftChecker : public QObject
+{
+    Q_OBJECT
+
+public:
+    DriftChecker(QString backend, QString group, QObject *parent = nullptr);
+    void readFingerprint(quint64 generation, bool isBaseline);
+
+    static qint64 getThreadCpuNs();
+
+private:
+    QString backend;
+    QString group;
+    FirewallTool *firewallTool = nullptr;
+
+signals:
+    void fingerprintRead(quint64 generation, bool isBaseline, bool ok, QByteArray fingerprint, qint64 wallNs, qint64 cpuNs);
+};
+
+#endif // DRIFTCHECKER_H
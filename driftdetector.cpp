@@ -0,0 +1,150 @@
+#include "driftdetector.h"
+
+DriftDetector::DriftDetector(QString backend, QString group, QObject *parent) : QObject(parent)
+{
+    checker = new DriftChecker(backend, group);
+    checkerThread = new QThread(this);
+    checkerThread->setObjectName("Drift checker");
+    checker->moveToThread(checkerThread);
+    connect(checker, &DriftChecker::fingerprintRead, this, &DriftDetector::onFingerprintRead);
+
+    // The checker and its FirewallTool are torn down on their own thread
+    connect(checkerThread, &QThread::finished, checker, &QObject::deleteLater);
+    checkerThread->start();
+
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, &QTimer::timeout, this, &DriftDetector::onTimeout);
+}
+
+DriftDetector::~DriftDetector()
+{
+    checkerThread->quit();
+    checkerThread->wait();
+}
+
+void DriftDetector::setInterval(int msecs)
+{
+    interval = qMax(1000, msecs);
+}
+
+void DriftDetector::setBudget(int msecs)
+{
+    budget = qMax(1, msecs);
+}
+
+void DriftDetector::start()
+{
+    backoff = 1;
+    resetBaseline();
+
+    if (!activeTimer.isValid()) {
+        activeTimer.start();
+    }
+
+    if (!checkPending) {
+        timer->start(interval);
+    }
+}
+
+void DriftDetector::stop()
+{
+    timer->stop();
+
+    // A read still running on the checker thread is ignored when it comes back
+    generation += 1;
+
+    activeTimer.invalidate();
+}
+
+bool DriftDetector::isActive()
+{
+    return activeTimer.isValid();
+}
+
+void DriftDetector::resetBaseline()
+{
+    // Reads are answered in order, so the new baseline arrives before the result of any later check
+    generation += 1;
+    baselineValid = false;
+
+    requestFingerprint(true);
+}
+
+void DriftDetector::requestFingerprint(bool isBaseline)
+{
+    quint64 requestGeneration = generation;
+    DriftChecker *checker = this->checker;
+
+    QMetaObject::invokeMethod(checker, [checker, requestGeneration, isBaseline]() {
+        checker->readFingerprint(requestGeneration, isBaseline);
+    }, Qt::QueuedConnection);
+}
+
+void DriftDetector::onTimeout()
+{
+    checkPending = true;
+    requestFingerprint(false);
+}
+
+void DriftDetector::onFingerprintRead(quint64 readGeneration, bool isBaseline, bool ok, QByteArray fingerprint, qint64 wallNs, qint64 cpuNs)
+{
+    static MetricCounter *checkCounter = Metrics::counter("drift_checks_total", "Rule drift checks");
+    static MetricCounter *driftCounter = Metrics::counter("drift_detections_total", "Checks that found the rules changed behind our back");
+    static MetricCounter *errorCounter = Metrics::counter("drift_check_errors_total", "Rule reads for drift checks that failed");
+    static MetricHistogram *checkHistogram = Metrics::histogram("drift_check_seconds", "Time to read back and fingerprint the rules");
+    static MetricHistogram *cpuHistogram = Metrics::histogram("drift_check_cpu_seconds", "Checker thread CPU time of one rule read");
+    static MetricGauge *intervalGauge = Metrics::gauge("drift_check_interval_ms", "Interval between drift checks, backoff included");
+
+    checkHistogram->record(wallNs);
+    cpuHistogram->record(cpuNs);
+
+    if (!isBaseline) {
+        checkPending = false;
+        checkCounter->add();
+
+        // Back off while checks are over budget, recover once they are comfortably under it
+        qint64 lastCheckMs = wallNs / 1000000;
+        if (lastCheckMs > budget) {
+            backoff = qMin(backoff * 2, DRIFT_MAX_BACKOFF);
+        } else if (lastCheckMs < budget / 2 && backoff > 1) {
+            backoff /= 2;
+        }
+        intervalGauge->set(interval * backoff);
+    }
+
+    // Read before the last apply or stop, it says nothing about the rules as they are now
+    if (readGeneration != generation || !isActive()) {
+        scheduleCheck();
+        return;
+    }
+
+    if (!ok) {
+        errorCounter->add();
+        scheduleCheck();
+        return;
+    }
+
+    // Without a baseline (its read failed) the first good read becomes one
+    if (isBaseline || !baselineValid) {
+        baseline = fingerprint;
+        baselineValid = true;
+        scheduleCheck();
+        return;
+    }
+
+    if (fingerprint != baseline) {
+        driftCounter->add();
+        emit driftDetected();
+    }
+
+    // The handler of driftDetected may have stopped or restarted the detector
+    scheduleCheck();
+}
+
+void DriftDetector::scheduleCheck()
+{
+    if (isActive() && !checkPending && !timer->isActive()) {
+        timer->start(interval * backoff);
+    }
+}
@@ -0,0 +1,58 @@
+#include <QObject>
+#include <QTimer>
+#include <QThread>
+#include <QElapsedTimer>
+
+#include "driftchecker.h"
+#include "metrics.h"
+
+#ifndef DRIFTDETECTOR_H
+#define DRIFTDETECTOR_H
+
+#define DRIFT_CHECK_INTERVAL 10000
+#define DRIFT_CHECK_BUDGET 50
+#define DRIFT_MAX_BACKOFF 16
+
+/*
+ * Periodically reads back the rules of one group and compares them with the
+ * snapshot taken right after our last apply. The reads run on a worker thread,
+ * so a slow firewall never blocks the UI. Checks that run over budget back off
+ * the interval, and nothing runs while the detector is stopped.
+ */
+class DriftDetector : public QObject
+{
+    Q_OBJECT
+
+public:
+    DriftDetector(QString backend, QString group, QObject *parent = nullptr);
+    ~DriftDetector();
+    void setInterval(int msecs);
+    void setBudget(int msecs);
+    void start();
+    void stop();
+    bool isActive();
+    void resetBaseline();
+
+private:
+    QThread *checkerThread;
+    DriftChecker *checker;
+    QTimer *timer;
+    int interval = DRIFT_CHECK_INTERVAL;
+    int budget = DRIFT_CHECK_BUDGET;
+    int backoff = 1;
+    QByteArray baseline;
+    bool baselineValid = false;
+    quint64 generation = 0;
+    bool checkPending = false;
+    QElapsedTimer activeTimer;
+
+    void requestFingerprint(bool isBaseline);
+    void onTimeout();
+    void onFingerprintRead(quint64 readGeneration, bool isBaseline, bool ok, QByteArray fingerprint, qint64 wallNs, qint64 cpuNs);
+    void scheduleCheck();
+
+signals:
+    void driftDetected();
+};
+
+#endif // DRIFTDETECTOR_H
@@ -1,51 +1,105 @@
 #include <QObject>
 #include <QDebug>
 #include <QVariant>
-#include <QtWin>
-#include <QByteArray>
+#include <QMap>
 
-#include <windows.h>
-#include <netfw.h>
-#include <comutil.h>
-#include <atlcomcli.h>
+#include "tracing.h"
 
 #ifndef FIREWALLTOOL_H
 #define FIREWALLTOOL_H
 
-#define HEX_MIN_LENGTH 8
+#define FIREWALL_BACKEND_ENV "GTA5ONLINE_WHITELIST_FIREWALL"
+#define FIREWALL_LATENCY_ENV "GTA5ONLINE_WHITELIST_FIREWALL_LATENCY"
 
+/* Rule as returned by FirewallTool::getRules, only the requested fields are filled in */
+struct FirewallRule {
+    QString name;
+    QString description;
+    QString grouping;
+    QString applicationName;
+    int protocol = 0;
+    QString localAddresses;
+    QString localPorts;
+    QString remoteAddresses;
+    QString remotePorts;
+    int direction = 0;
+    int action = 0;
+    long profiles = 0;
+    bool enabled = false;
+};
+
+/*
+ * Backend independent interface to the host firewall. The enum values match the
+ * Windows Firewall (netfw.h) constants so they can be passed straight through there.
+ */
 class FirewallTool : public QObject
 {
     Q_OBJECT
 
 public:
+    enum Protocol {
+        ProtocolTcp = 6,
+        ProtocolUdp = 17,
+        ProtocolAny = 256
+    };
+
+    enum Direction {
+        DirectionIn = 1,
+        DirectionOut = 2
+    };
+
+    enum Action {
+        ActionBlock = 0,
+        ActionAllow = 1
+    };
+
+    enum Profile {
+        ProfileDomain = 0x1,
+        ProfilePrivate = 0x2,
+        ProfilePublic = 0x4
+    };
+
+    enum RuleField {
+        FieldName = 0x1,
+        FieldDescription = 0x2,
+        FieldGrouping = 0x4,
+        FieldApplicationName = 0x8,
+        FieldProtocol = 0x10,
+        FieldLocalAddresses = 0x20,
+        FieldLocalPorts = 0x40,
+        FieldRemoteAddresses = 0x80,
+        FieldRemotePorts = 0x100,
+        FieldDirection = 0x200,
+        FieldAction = 0x400,
+        FieldProfiles = 0x800,
+        FieldEnabled = 0x1000,
+        FieldAll = 0x1FFF
+    };
+    Q_DECLARE_FLAGS(RuleFields, RuleField)
+
     explicit FirewallTool(QObject *parent = nullptr);
-    long getCurrentProfiles();
-    bool isProfileEnabled(NET_FW_PROFILE_TYPE2 profileType);
+    static FirewallTool *create(QString backend = QString(), QObject *parent = nullptr);
     bool hasError();
     QString getError();
     bool isInitialised();
-    bool removeRule(QString name);
-    bool addRule(QString name, QString description, QString group, QString application, NET_FW_IP_PROTOCOL_ protocol, QString laddresses, QString lports, QString raddresses, QString rports, NET_FW_RULE_DIRECTION direction, NET_FW_ACTION_ action, bool enabled);
-    QList<QMap<QString, QVariant>> getRules();
-    bool hasRule(QString name);
+    virtual long getCurrentProfiles() = 0;
+    virtual bool isProfileEnabled(Profile profile) = 0;
+    virtual bool removeRule(QString name) = 0;
+    virtual bool addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled) = 0;
+    virtual bool hasRule(QString name) = 0;
+    QList<FirewallRule> getRules(QString grouping = QString(), QString namePrefix = QString(), RuleFields fields = FieldAll);
 
-private:
-    bool initSuccess;
+protected:
+    bool initSuccess = false;
     QString error;
-    HRESULT hrComInit = S_OK;
-    INetFwPolicy2 *pNetFwPolicy2 = NULL;
 
-    HRESULT WFCOMInitialize(INetFwPolicy2** ppNetFwPolicy2);
-    void onDestroyed();
-    bool init();
-    void cleanup();
-    QString formatHResult(HRESULT hr);
-    QMap<QString, QVariant> getRuleInfo(INetFwRule* FwRule);
-    QString bStrToQString(BSTR bstr);
+    virtual QList<FirewallRule> enumerateRules(QString grouping, QString namePrefix, RuleFields fields) = 0;
+    bool matchesFilter(QString name, QString grouping, QString filterGrouping, QString filterNamePrefix);
 
 signals:
 
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(FirewallTool::RuleFields)
+
 #endif // FIREWALLTOOL_H
@@ -1,35 +1,118 @@
 #include "iptool.h"
 
+#include <cstring>
+
 IPTool::IPTool(QObject *parent) : QObject(parent)
 {
 
 }
 
+int IPTool::parseIpv4Addresses(const char *buffer, qint64 length, QVector<quint32> *addresses, int *invalidCount)
+{
+    int parsed = 0;
+    int invalid = 0;
+
+    qint64 start = 0;
+    while (start < length) {
+        const char *end = (const char *) memchr(buffer + start, '\n', length - start);
+        qint64 lineEnd = (end != NULL) ? (end - buffer) : length;
+
+        // Tolerate CRLF line endings and skip blank lines
+        qint64 lineLength = lineEnd - start;
+        if (lineLength > 0 && buffer[start + lineLength - 1] == '\r') {
+            lineLength -= 1;
+        }
+
+        if (lineLength > 0) {
+            quint32 address = 0;
+            if (lineLength <= IPV4_MAX_LENGTH && parseIpv4Address(buffer + start, (int) lineLength, &address)) {
+                addresses->append(address);
+                parsed += 1;
+            } else {
+                invalid += 1;
+            }
+        }
+
+        start = lineEnd + 1;
+    }
+
+    if (invalidCount != nullptr) {
+        *invalidCount = invalid;
+    }
+
+    return parsed;
+}
+
 bool IPTool::isValidAddress(QString address)
 {
-    QRegularExpression re(IP_PATTERN);
-    QRegularExpressionMatch match = re.match(address);
-    if (match.hasMatch()) {
+    quint32 ipv4Address = 0;
+    if (parseIpv4Address(address.constData(), address.size(), &ipv4Address)) {
         return true;
     }
 
-    return false;
+    return isValidIpv6Address(address);
+}
+
+bool IPTool::isValidIpv6Address(QString address)
+{
+    return !getIpv6QHostAddress(address).isNull();
 }
 
 QHostAddress IPTool::getQHostAddress(QString address)
 {
+    quint32 ipv4Address = 0;
+    if (!parseIpv4Address(address.constData(), address.size(), &ipv4Address)) {
+        return QHostAddress();
+    }
+
+    return QHostAddress(ipv4Address);
+}
+
+QHostAddress IPTool::getIpv6QHostAddress(QString address)
+{
+    // Scoped (link-local) addresses are not accepted, they cannot be whitelisted anyway
+    if (!address.contains(':') || address.contains('%')) {
+        return QHostAddress();
+    }
+
     QHostAddress hostAddress;
     if (!hostAddress.setAddress(address)) {
         return QHostAddress();
     }
 
-    if (hostAddress.protocol() != QAbstractSocket::IPv4Protocol) {
+    if (hostAddress.protocol() != QAbstractSocket::IPv6Protocol) {
         return QHostAddress();
     }
 
     return hostAddress;
 }
 
+QHostAddress IPTool::getAnyQHostAddress(QString address)
+{
+    QHostAddress hostAddress = getQHostAddress(address);
+    if (!hostAddress.isNull()) {
+        return hostAddress;
+    }
+
+    return getIpv6QHostAddress(address);
+}
+
+bool IPTool::lessThan(QHostAddress hostAddress1, QHostAddress hostAddress2)
+{
+    // IPv4 addresses sort before IPv6 addresses
+    bool isIpv4Address1 = (hostAddress1.protocol() == QAbstractSocket::IPv4Protocol);
+    bool isIpv4Address2 = (hostAddress2.protocol() == QAbstractSocket::IPv4Protocol);
+    if (isIpv4Address1 != isIpv4Address2) {
+        return isIpv4Address1;
+    }
+
+    if (isIpv4Address1) {
+        return hostAddress1.toIPv4Address() < hostAddress2.toIPv4Address();
+    }
+
+    return Ipv6Address::fromQHostAddress(hostAddress1) < Ipv6Address::fromQHostAddress(hostAddress2);
+}
+
 QHostAddress IPTool::getQHostAddress(quint32 ipv4Address)
 {
     QHostAddress hostAddress(ipv4Address);
@@ -1,11 +1,14 @@
 #include <QObject>
-#include <QRegularExpression>
+#include <QVector>
 #include <QHostAddress>
 
+#include "ipv6address.h"
+
 #ifndef IPTOOL_H
 #define IPTOOL_H
 
-#define IP_PATTERN "^((25[0-5]|(2[0-4]|1[0-9]|[1-9]|)[0-9])(\\.(?!$)|$)){4}$"
+#define IPV4_MAX_LENGTH 15
+#define ADDRESS_INPUT_PATTERN "^[0-9A-Fa-f:.]*$"
 
 class IPTool : public QObject
 {
@@ -13,14 +16,77 @@ class IPTool : public QObject
 
 public:
     explicit IPTool(QObject *parent = nullptr);
+    template <typename Char> static constexpr bool parseIpv4Address(const Char *text, int length, quint32 *address);
+    static int parseIpv4Addresses(const char *buffer, qint64 length, QVector<quint32> *addresses, int *invalidCount = nullptr);
     static bool isValidAddress(QString address);
+    static bool isValidIpv6Address(QString address);
     static QHostAddress getQHostAddress(QString address);
+    static QHostAddress getIpv6QHostAddress(QString address);
+    static QHostAddress getAnyQHostAddress(QString address);
+    static bool lessThan(QHostAddress hostAddress1, QHostAddress hostAddress2);
     static QHostAddress getQHostAddress(quint32 ipv4Address);
     static QString incrementAddress(QString address);
     static QString decrementAddress(QString address);
 
+private:
+    static constexpr uint charCode(char c) { return (uchar) c; }
+    static constexpr uint charCode(QChar c) { return c.unicode(); }
+
 signals:
 
 };
 
+/*
+ * Strict dotted-quad parser: four decimal octets of 0-255 without leading zeros or
+ * surrounding text, the same grammar the old IP_PATTERN regex accepted. It does not
+ * allocate and works on both char and QChar buffers.
+ */
+template <typename Char>
+constexpr bool IPTool::parseIpv4Address(const Char *text, int length, quint32 *address)
+{
+    quint32 value = 0;
+    int i = 0;
+
+    for (int octets = 0; octets < 4; octets += 1) {
+        if (octets > 0) {
+            if (i >= length || charCode(text[i]) != '.') {
+                return false;
+            }
+
+            i += 1;
+        }
+
+        uint digit = (i < length) ? charCode(text[i]) - '0' : 10;
+        if (digit > 9) {
+            return false;
+        }
+
+        uint octet = digit;
+        i += 1;
+
+        // At most two more digits, and only when the octet does not start with a zero
+        for (int digits = 1; i < length && (digit = charCode(text[i]) - '0') <= 9; digits += 1) {
+            if (octet == 0 || digits == 3) {
+                return false;
+            }
+
+            octet = octet * 10 + digit;
+            i += 1;
+        }
+
+        if (octet > 255) {
+            return false;
+        }
+
+        value = (value << 8) | octet;
+    }
+
+    if (i != length) {
+        return false;
+    }
+
+    *address = value;
+    return true;
+}
+
 #endif // IPTOOL_H
@@ -0,0 +1,6 @@
+#include "ipv4address.h"
+
+QString Ipv4Address::toString() const
+{
+    return AddressFormat::toString(value);
+}
@@ -0,0 +1,62 @@
+#include <QtGlobal>
+#include <QString>
+#include <QHostAddress>
+#include <QHash>
+#include <QMetaType>
+
+#include "iptool.h"
+#include "addressformat.h"
+
+#ifndef IPV4ADDRESS_H
+#define IPV4ADDRESS_H
+
+/* IPv4 address in host byte order, cheap to copy, compare and hash */
+struct Ipv4Address
+{
+    quint32 value;
+
+    constexpr Ipv4Address() : value(0) {}
+    constexpr explicit Ipv4Address(quint32 value) : value(value) {}
+    constexpr Ipv4Address(quint8 byte1, quint8 byte2, quint8 byte3, quint8 byte4)
+        : value(((quint32) byte1 << 24) | ((quint32) byte2 << 16) | ((quint32) byte3 << 8) | byte4) {}
+
+    static constexpr Ipv4Address min() { return Ipv4Address(0u); }
+    static constexpr Ipv4Address max() { return Ipv4Address(0xFFFFFFFFu); }
+
+    static Ipv4Address fromString(QString address, bool *ok = nullptr)
+    {
+        quint32 value = 0;
+        bool parsed = IPTool::parseIpv4Address(address.constData(), address.size(), &value);
+        if (ok != nullptr) {
+            *ok = parsed;
+        }
+
+        return Ipv4Address(value);
+    }
+
+    constexpr quint32 toUInt32() const { return value; }
+    QHostAddress toQHostAddress() const { return QHostAddress(value); }
+    QString toString() const;
+
+    constexpr Ipv4Address next() const { return Ipv4Address(value + 1); }
+    constexpr Ipv4Address previous() const { return Ipv4Address(value - 1); }
+    Ipv4Address &operator++() { value += 1; return *this; }
+    Ipv4Address &operator--() { value -= 1; return *this; }
+
+    constexpr bool operator==(const Ipv4Address &other) const { return value == other.value; }
+    constexpr bool operator!=(const Ipv4Address &other) const { return value != other.value; }
+    constexpr bool operator<(const Ipv4Address &other) const { return value < other.value; }
+    constexpr bool operator>(const Ipv4Address &other) const { return value > other.value; }
+    constexpr bool operator<=(const Ipv4Address &other) const { return value <= other.value; }
+    constexpr bool operator>=(const Ipv4Address &other) const { return value >= other.value; }
+};
+
+Q_DECLARE_TYPEINFO(Ipv4Address, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(Ipv4Address)
+
+inline uint qHash(const Ipv4Address &address, uint seed = 0)
+{
+    return qHash(address.value, seed);
+}
+
+#endif // IPV4ADDRESS_H
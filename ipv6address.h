@@ -0,0 +1,102 @@
+#include <QtGlobal>
+#include <QHostAddress>
+#include <QHash>
+#include <QMetaType>
+
+#include "addressformat.h"
+
+#ifndef IPV6ADDRESS_H
+#define IPV6ADDRESS_H
+
+/* 128-bit IPv6 address as two host order halves, ordered like the address itself */
+struct Ipv6Address
+{
+    quint64 hi;
+    quint64 lo;
+
+    constexpr Ipv6Address() : hi(0), lo(0) {}
+    constexpr Ipv6Address(quint64 hi, quint64 lo) : hi(hi), lo(lo) {}
+
+    static constexpr Ipv6Address min() { return Ipv6Address(0, 0); }
+    static constexpr Ipv6Address max() { return Ipv6Address(~0ull, ~0ull); }
+
+    static Ipv6Address fromBytes(const quint8 *bytes)
+    {
+        quint64 hi = 0;
+        quint64 lo = 0;
+        for (int i = 0; i < 8; i += 1) {
+            hi = (hi << 8) | bytes[i];
+            lo = (lo << 8) | bytes[i + 8];
+        }
+
+        return Ipv6Address(hi, lo);
+    }
+
+    static Ipv6Address fromQHostAddress(QHostAddress hostAddress)
+    {
+        Q_IPV6ADDR bytes = hostAddress.toIPv6Address();
+        return fromBytes(bytes.c);
+    }
+
+    void toBytes(quint8 *bytes) const
+    {
+        for (int i = 0; i < 8; i += 1) {
+            bytes[7 - i] = (quint8) (hi >> (8 * i));
+            bytes[15 - i] = (quint8) (lo >> (8 * i));
+        }
+    }
+
+    QHostAddress toQHostAddress() const
+    {
+        quint8 bytes[16];
+        toBytes(bytes);
+
+        return QHostAddress(bytes);
+    }
+
+    QString toString() const
+    {
+        quint8 bytes[16];
+        toBytes(bytes);
+
+        return AddressFormat::toString6(bytes);
+    }
+
+    /* Mask with the top prefixLength bits set */
+    static Ipv6Address mask(int prefixLength)
+    {
+        if (prefixLength <= 0) {
+            return Ipv6Address(0, 0);
+        }
+
+        if (prefixLength <= 64) {
+            return Ipv6Address(prefixLength == 64 ? ~0ull : ~(~0ull >> prefixLength), 0);
+        }
+
+        return Ipv6Address(~0ull, prefixLength >= 128 ? ~0ull : ~(~0ull >> (prefixLength - 64)));
+    }
+
+    constexpr Ipv6Address operator&(const Ipv6Address &other) const { return Ipv6Address(hi & other.hi, lo & other.lo); }
+    constexpr Ipv6Address operator|(const Ipv6Address &other) const { return Ipv6Address(hi | other.hi, lo | other.lo); }
+    constexpr Ipv6Address operator~() const { return Ipv6Address(~hi, ~lo); }
+
+    constexpr Ipv6Address next() const { return (lo == ~0ull) ? Ipv6Address(hi + 1, 0) : Ipv6Address(hi, lo + 1); }
+    constexpr Ipv6Address previous() const { return (lo == 0) ? Ipv6Address(hi - 1, ~0ull) : Ipv6Address(hi, lo - 1); }
+
+    constexpr bool operator==(const Ipv6Address &other) const { return hi == other.hi && lo == other.lo; }
+    constexpr bool operator!=(const Ipv6Address &other) const { return !(*this == other); }
+    constexpr bool operator<(const Ipv6Address &other) const { return hi < other.hi || (hi == other.hi && lo < other.lo); }
+    constexpr bool operator>(const Ipv6Address &other) const { return other < *this; }
+    constexpr bool operator<=(const Ipv6Address &other) const { return !(other < *this); }
+    constexpr bool operator>=(const Ipv6Address &other) const { return !(*this < other); }
+};
+
+Q_DECLARE_TYPEINFO(Ipv6Address, Q_PRIMITIVE_TYPE);
+Q_DECLARE_METATYPE(Ipv6Address)
+
+inline uint qHash(const Ipv6Address &address, uint seed = 0)
+{
+    return qHash(address.hi, seed) ^ qHash(address.lo, seed);
+}
+
+#endif // IPV6ADDRESS_H
@@ -1,4 +1,7 @@
 #include "mainwindow.h"
+#include "benchmark.h"
+#include "replayharness.h"
+#include "tracing.h"
 
 #include <QApplication>
 
@@ -6,6 +9,25 @@
 
 int main(int argc, char *argv[])
 {
+    // Set to record spans from the start, including startup
+    Tracing::setEnabled(qEnvironmentVariableIntValue(TRACE_ENV) > 0);
+
+    // Benchmarks run without a window and next to a running instance, so they skip SingleApplication
+    if (Benchmark::isRequested(argc, argv)) {
+        QApplication a(argc, argv);
+        return Benchmark::main(a.arguments());
+    }
+
+    if (ReplayHarness::isRequested(argc, argv)) {
+        // Headless unless a platform plugin was asked for
+        if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        }
+
+        QApplication a(argc, argv);
+        return ReplayHarness::main(a.arguments());
+    }
+
     SingleApplication a(argc, argv);
     MainWindow w;
 
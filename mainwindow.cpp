@@ -12,16 +12,44 @@ MainWindow::MainWindow(QWidget *parent)
     whitelistOnPushButton = ui->whitelistOnPushButton;
     whitelistOffPushButton = ui->whitelistOffPushButton;
     addPushButton = ui->addPushButton;
-    addressListWidget = ui->addressListWidget;
+    addressListView = ui->addressListView;
     selectCountLabel = ui->selectCountLabel;
+    searchLineEdit = ui->searchLineEdit;
 
-    customAddressListWidget = new CustomAddressListWidget(addressListWidget, selectCountLabel, true, this);
+    customAddressListWidget = new CustomAddressListWidget(addressListView, selectCountLabel, true, this);
 
-    firewallTool = new FirewallTool(this);
+    settingsStore = new SettingsStore(SETTINGS_FILENAME, this);
+    connect(settingsStore, &SettingsStore::writeFailed, this, &MainWindow::onSettingsWriteFailed);
+    connect(settingsStore, &SettingsStore::whitelistWritten, this, &MainWindow::onWhitelistWritten);
+
+    whitelistFile = new WhitelistFile(this);
+
+    // Outlives the add dialogs so the capture adapter and its device list stay warm between sessions
+    captureService = new CaptureService(this);
+
+    profileScopeTimer = new QTimer(this);
+    profileScopeTimer->setSingleShot(true);
+    profileScopeTimer->setInterval(PROFILE_SCOPE_DELAY_MS);
+    connect(profileScopeTimer, &QTimer::timeout, this, &MainWindow::cacheActiveProfileScope);
+
+    // Scopes of the profiles not being applied are built in the background
+    scopeBuilder = new ScopeBuilder();
+    scopeThread = new QThread(this);
+    scopeThread->setObjectName("Scope builder");
+    scopeBuilder->moveToThread(scopeThread);
+    connect(scopeBuilder, &ScopeBuilder::scopeBuilt, this, &MainWindow::onProfileScopeBuilt);
+    connect(scopeThread, &QThread::finished, scopeBuilder, &QObject::deleteLater);
+    scopeThread->start();
+
+    firewallTool = FirewallTool::create(QString(), this);
     if (firewallTool->hasError()) {
         displayFirewallError();
     }
 
+    // Reads the rules through a FirewallTool of its own, on its own thread
+    driftDetector = new DriftDetector(QString(), APP_NAME, this);
+    initDriftDetector();
+
     statusLabel->setText("-");
     profileLabel->setText("-");
     setFirewallStatus();
@@ -30,14 +58,23 @@ MainWindow::MainWindow(QWidget *parent)
     connect(whitelistOnPushButton, &QPushButton::clicked, this, &MainWindow::onWhitelistOnButtonClicked);
     connect(whitelistOffPushButton, &QPushButton::clicked, this, &MainWindow::onWhitelistOffButtonClicked);
     connect(customAddressListWidget, &CustomAddressListWidget::selectionRemoved, this, &MainWindow::onSelectionRemoved);
+    connect(searchLineEdit, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
 
+    initMenu();
     initWhitelist();
     initHotkey();
     initTrayIcon();
+    initMetricsServer();
+
+    // Scopes of the other profiles are (re)computed once the window is up
+    QTimer::singleShot(0, this, &MainWindow::refreshProfileScopes);
 }
 
 MainWindow::~MainWindow()
 {
+    scopeThread->quit();
+    scopeThread->wait();
+
     delete ui;
 }
 
@@ -75,6 +112,8 @@ void MainWindow::onIconActivated(QSystemTrayIcon::ActivationReason reason)
 
 void MainWindow::onWhitelistHotkeyActivated()
 {
+    TraceSpan span("hotkey.whitelist");
+
     if (isWhitelistOn()) {
         if (turnWhitelistOff(false)) {
             QSound::play(":/sounds/WhitelistTurnedOff.wav");
@@ -99,6 +138,26 @@ void MainWindow::initHotkey()
 {
     hotkey = new QHotkey(QKeySequence(Qt::CTRL + Qt::Key_F10), true, this);
     connect(hotkey, &QHotkey::activated, this, &MainWindow::onWhitelistHotkeyActivated);
+
+    profileHotkey = new QHotkey(QKeySequence(Qt::CTRL + Qt::Key_F11), true, this);
+    connect(profileHotkey, &QHotkey::activated, this, &MainWindow::onProfileHotkeyActivated);
+}
+
+void MainWindow::onProfileHotkeyActivated()
+{
+    TraceSpan span("hotkey.profile");
+
+    QStringList profileNames = getProfileNames();
+    if (profileNames.count() < 2) {
+        return;
+    }
+
+    QString name = profileNames[(profileNames.indexOf(getActiveProfile()) + 1) % profileNames.count()];
+    if (switchProfile(name, false)) {
+        trayIcon->showMessage(APP_NAME, QString("Switched to profile %1").arg(name));
+    } else {
+        QSound::play(":/sounds/SomethingWentWrong.wav");
+    }
 }
 
 void MainWindow::initTrayIcon()
@@ -115,8 +174,52 @@ void MainWindow::initTrayIcon()
     connect(quitAction, &QAction::triggered, qApp, &QCoreApplication::quit);
 
     QMenu *trayMenu = new QMenu(this);
+    trayProfileMenu = trayMenu->addMenu("Profiles");
+    trayMenu->addSeparator();
     trayMenu->addAction(quitAction);
     trayIcon->setContextMenu(trayMenu);
+
+    updateProfileMenus();
+}
+
+void MainWindow::initDriftDetector()
+{
+    QJsonObject driftObject = loadSettings()["DriftCheck"].toObject();
+    driftDetector->setInterval(driftObject["IntervalMs"].toInt(DRIFT_CHECK_INTERVAL));
+    driftDetector->setBudget(driftObject["BudgetMs"].toInt(DRIFT_CHECK_BUDGET));
+
+    connect(driftDetector, &DriftDetector::driftDetected, this, &MainWindow::onDriftDetected);
+}
+
+void MainWindow::onDriftDetected()
+{
+    bool autoRepair = loadSettings()["DriftCheck"].toObject()["AutoRepair"].toBool(true);
+    if (autoRepair) {
+        // Whatever we applied last can no longer be trusted, so rewrite every shard
+        appliedShardScopes.clear();
+        if (addFirewallRules()) {
+            trayIcon->showMessage(APP_NAME, "The whitelist rules were changed outside of the program and have been restored.");
+            return;
+        }
+    } else if (firewallTool->hasRule(getInboundRuleName()) && firewallTool->hasRule(getOutboundRuleName())) {
+        trayIcon->showMessage(APP_NAME, "The whitelist rules were changed outside of the program.", QSystemTrayIcon::Warning);
+        driftDetector->resetBaseline();
+        return;
+    }
+
+    // No half applied set of shards may stay behind: remove them all, or stay on and say so
+    QString error = firewallTool->getError();
+    if (!turnWhitelistOff(false)) {
+        trayIcon->showMessage(APP_NAME, QString("The whitelist rules were changed outside of the program and could not be restored or removed.\n\n%1").arg(firewallTool->getError()), QSystemTrayIcon::Critical);
+        driftDetector->resetBaseline();
+        return;
+    }
+
+    if (autoRepair) {
+        trayIcon->showMessage(APP_NAME, QString("The whitelist rules were changed outside of the program and could not be restored. The whitelist has been turned off.\n\n%1").arg(error), QSystemTrayIcon::Critical);
+    } else {
+        trayIcon->showMessage(APP_NAME, "The whitelist rules were removed outside of the program. The whitelist has been turned off.", QSystemTrayIcon::Warning);
+    }
 }
 
 void MainWindow::setTrayIcon()
@@ -133,11 +236,22 @@ void MainWindow::setTrayIcon()
 
 void MainWindow::initWhitelist()
 {
-    QStringList addresses = getSavedAddresses(true);
-    for (int i = 0; i < addresses.count(); i += 1) {
-        QString address = addresses[i];
-        if (IPTool::isValidAddress(address)) {
-            customAddressListWidget->addAddressToList(address);
+    static MetricHistogram *startupHistogram = Metrics::histogram("startup_seconds", "Time from loading the whitelist to the rules being in place");
+    static MetricCounter *fastStartupCounter = Metrics::counter("startup_fast_path_total", "Startups that found the applied rules up to date");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!isBinaryWhitelist() || !loadBinaryWhitelist()) {
+        QStringList addresses = getSavedAddresses(true);
+        customAddressListWidget->addAddressesToList(addresses);
+
+        if (isBinaryWhitelist()) {
+            // First start with the binary format (or a damaged file), build it from settings.json
+            saveBinaryWhitelist();
+        } else if (customAddressListWidget->getAddresses() != addresses) {
+            // Later edits are journalled per address, so the saved list has to use the same spelling as the list
+            saveAddresses();
         }
     }
 
@@ -145,116 +259,659 @@ void MainWindow::initWhitelist()
         return;
     }
 
-    if (firewallTool->hasRule(getInboundRuleName()) && firewallTool->hasRule(getOutboundRuleName())) {
-        if (!addFirewallRules()) {
+    QMap<QString, QString> ruleScopes = getAppliedRuleScopes();
+    shardHighWater = ruleScopes.count();
+    if (ruleScopes.contains(getInboundRuleName()) && ruleScopes.contains(getOutboundRuleName())) {
+        bool fastPath = loadSettings()["FastStartup"].toBool(true) && isRulesInSync(ruleScopes);
+        if (fastPath) {
+            appliedShardScopes = getShardScopes(getAddressScope());
+        } else if (!addFirewallRules()) {
             onFailAddRules(true);
         }
 
+        startupHistogram->record(timer.nsecsElapsed());
+        if (fastPath) {
+            fastStartupCounter->add();
+        }
+
+        ui->statusbar->showMessage(QString("Startup took %1 ms (%2)").arg(timer.elapsed()).arg(fastPath ? "rules up to date" : "rules rewritten"));
+
         whitelistOnPushButton->setEnabled(false);
         whitelistOffPushButton->setEnabled(true);
+
+        driftDetector->start();
     } else {
         whitelistOnPushButton->setEnabled(true);
         whitelistOffPushButton->setEnabled(false);
     }
 }
 
-bool MainWindow::isAddressInList(QString address)
+QMap<QString, QString> MainWindow::getAppliedRuleScopes()
+{
+    // One group-filtered read of just the names and remote addresses of our rules
+    QList<FirewallRule> rules = firewallTool->getRules(APP_NAME, APP_NAME, FirewallTool::FieldName | FirewallTool::FieldRemoteAddresses);
+
+    QMap<QString, QString> ruleScopes;
+    for (int i = 0; i < rules.count(); i += 1) {
+        ruleScopes[rules[i].name] = rules[i].remoteAddresses;
+    }
+
+    return ruleScopes;
+}
+
+bool MainWindow::isRulesInSync(QMap<QString, QString> ruleScopes)
 {
-    QStringList addresses = customAddressListWidget->getAddresses();
-    for (int i = 0; i < addresses.count(); i += 1) {
-        if (QString::compare(addresses[i], address, Qt::CaseSensitive) == 0) {
-            return true;
+    QStringList appliedScopes;
+    for (int shard = 0; ruleScopes.contains(getInboundRuleName(shard)); shard += 1) {
+        QString scope = ruleScopes[getInboundRuleName(shard)];
+        if (ruleScopes.value(getOutboundRuleName(shard)) != scope) {
+            return false;
         }
+
+        appliedScopes.append(scope);
     }
 
-    return false;
+    QString fingerprint = getRulesFingerprint(getShardScopes(getAddressScope()));
+
+    return fingerprint == loadSettings()["AppliedFingerprint"].toString() && fingerprint == getRulesFingerprint(appliedScopes);
+}
+
+QString MainWindow::getRulesFingerprint(QStringList shardScopes)
+{
+    // The firewall may hand the addresses back in another notation, so compare normalised ranges
+    QStringList parts;
+    for (int i = 0; i < shardScopes.count(); i += 1) {
+        parts.append(ScopeTool::normaliseScope(shardScopes[i]));
+    }
+
+    parts.append(QString::number(GTA5ONLINE_PORT));
+    parts.append(QString::number(firewallTool->getCurrentProfiles()));
+
+    return QString::fromLatin1(QCryptographicHash::hash(parts.join(";").toUtf8(), QCryptographicHash::Sha1).toHex());
 }
 
 void MainWindow::onSelectionRemoved(QMap<QString, QVariant> itemsRemoved)
 {
+    saveAddressChanges(QStringList(), itemsRemoved.keys());
+
     if (isWhitelistOn()) {
         if (!addFirewallRules()) {
             onFailAddRules(true);
         }
     }
+}
 
-    saveAddresses(true);
+void MainWindow::onSearchTextChanged(QString text)
+{
+    static MetricHistogram *filterHistogram = Metrics::histogram("list_filter_seconds", "Time to filter the address list");
+
+    TraceSpan span("list.filter");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int count = customAddressListWidget->setFilter(text);
+    filterHistogram->record(timer.nsecsElapsed());
+
+    if (text.trimmed().isEmpty()) {
+        ui->statusbar->clearMessage();
+        return;
+    }
+
+    ui->statusbar->showMessage(QString("%1 of %2 IP Address(es) shown (%3 ms)").arg(count).arg(customAddressListWidget->getAddressCount()).arg(timer.nsecsElapsed() / 1000000.0, 0, 'f', 3));
 }
 
 void MainWindow::onAddButtonClicked(bool checked)
 {
-    AddAddressDialog addAddressDialog(this);
+    AddAddressDialog addAddressDialog(captureService, this);
     if (addAddressDialog.exec() == QDialog::Accepted) {
-        QStringList addresses = addAddressDialog.getAddresses();
-        for (int i = 0; i < addresses.count(); i += 1) {
-            QString address = addresses[i];
+        addAddresses(addAddressDialog.getAddresses(), false);
+    }
+}
 
-            if (isAddressInList(address)) {
-                QString text = QString("IP Address already exists - %1").arg(address);
-                QMessageBox::information(this, "Information", text);
-            } else {
-                if (customAddressListWidget->addAddressToList(address) == -1) {
-                    QString text = QString("Fail to add IP Address - %1").arg(address);
-                    QMessageBox::critical(this, "Error", text);
-                }
-            }
-        }
+int MainWindow::addAddresses(QStringList addresses, bool alwaysReport)
+{
+    static MetricHistogram *addHistogram = Metrics::histogram("list_add_seconds", "Time to add a batch of addresses, save them and apply the rules");
+
+    TraceSpan span("list.add");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // One pass over the batch, then one save and one firewall apply however many addresses there are
+    QStringList duplicates;
+    QStringList invalid;
+    QStringList added = customAddressListWidget->addAddressesToList(addresses, &duplicates, &invalid);
+
+    if (!added.isEmpty()) {
+        saveAddressChanges(added, QStringList());
 
         if (isWhitelistOn() && !addFirewallRules()) {
             onFailAddRules(true);
         }
+    }
 
-        saveAddresses(true);
+    addHistogram->record(timer.nsecsElapsed());
+    ui->statusbar->showMessage(QString("Added %1 IP Address(es) in %2 ms").arg(added.count()).arg(timer.elapsed()));
+
+    QString report = CustomAddressListWidget::getAddReport(added.count(), duplicates, invalid);
+    if (!report.isEmpty()) {
+        QMessageBox::information(this, "Information", report);
+    } else if (alwaysReport) {
+        QMessageBox::information(this, "Information", QString("%1 IP Address(es) added").arg(added.count()));
     }
+
+    return added.count();
 }
 
-bool MainWindow::saveAddresses(bool prompt)
+QJsonObject MainWindow::loadSettings(bool prompt)
 {
-    QString filename = SETTINGS_FILENAME;
-    QFile saveFile(filename);
-    if (!saveFile.open(QIODevice::WriteOnly)) {
-        if (prompt) {
-            QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
+    // Served from memory, the file is only read once at startup
+    if (prompt && settingsStore->hasError()) {
+        QMessageBox::warning(this, "Warning", settingsStore->getError());
+    }
+
+    return settingsStore->getSettings();
+}
+
+void MainWindow::saveAddresses()
+{
+    TraceSpan span("settings.saveAddresses");
+
+    settingsStore->setValue("Addresses", QJsonArray::fromStringList(customAddressListWidget->getAddresses()));
+}
+
+void MainWindow::saveAddressChanges(QStringList added, QStringList removed)
+{
+    TraceSpan span("settings.saveAddressChanges");
+
+    // Keep the cached scope of the active profile fresh so switching back to it stays instant
+    profileScopeTimer->start();
+
+    if (isBinaryWhitelist()) {
+        saveBinaryWhitelist();
+        return;
+    }
+
+    // One journal line per batch, however many addresses it holds
+    settingsStore->addToArray("Addresses", QJsonArray::fromStringList(added));
+    settingsStore->removeFromArray("Addresses", QJsonArray::fromStringList(removed));
+}
+
+bool MainWindow::isBinaryWhitelist()
+{
+    return loadSettings()["BinaryWhitelist"].toBool(false);
+}
+
+bool MainWindow::loadBinaryWhitelist()
+{
+    if (!QFile::exists(WHITELIST_FILENAME)) {
+        return false;
+    }
+
+    // A file the list cannot show in full is not used, or the rules would not match what is listed
+    QVector<Ipv4Address> ipv4Addresses;
+    QVector<Ipv6Address> ipv6Addresses;
+    if (!whitelistFile->open(WHITELIST_FILENAME) || !whitelistFile->getAddresses(&ipv4Addresses, &ipv6Addresses)) {
+        QMessageBox::warning(this, "Warning", QString("%1\n\nThe addresses in %2 are used instead.").arg(whitelistFile->getError()).arg(SETTINGS_FILENAME));
+        whitelistFile->close();
+        return false;
+    }
+
+    customAddressListWidget->addAddressesToList(ipv4Addresses, ipv6Addresses);
+    whitelistFileCurrent = true;
+
+    return true;
+}
+
+void MainWindow::saveBinaryWhitelist()
+{
+    // Unmapped until the writer thread has replaced the file, the scope is built from the list meanwhile
+    whitelistFile->close();
+    whitelistFileCurrent = false;
+
+    settingsStore->writeWhitelist(WHITELIST_FILENAME, customAddressListWidget->getIpv4Addresses(), customAddressListWidget->getIpv6Addresses());
+}
+
+void MainWindow::onWhitelistWritten(bool success)
+{
+    // Only map the file once no newer write is queued, so it is current and free to be replaced
+    if (success && !settingsStore->isWhitelistWritePending() && isBinaryWhitelist()) {
+        whitelistFileCurrent = whitelistFile->open(WHITELIST_FILENAME);
+    }
+}
+
+void MainWindow::getListRanges(QList<AddressRange> *ranges, QList<Address6Range> *ranges6)
+{
+    WhitelistFile::getAddressRanges(customAddressListWidget->getIpv4Addresses(), customAddressListWidget->getIpv6Addresses(), ranges, ranges6);
+}
+
+void MainWindow::initMenu()
+{
+    QMenu *fileMenu = ui->menubar->addMenu("File");
+
+    QAction *importAction = new QAction("Import Addresses...", this);
+    connect(importAction, &QAction::triggered, this, &MainWindow::onImportAddresses);
+    fileMenu->addAction(importAction);
+
+    QAction *exportAction = new QAction("Export Addresses...", this);
+    connect(exportAction, &QAction::triggered, this, &MainWindow::onExportAddresses);
+    fileMenu->addAction(exportAction);
+
+    fileMenu->addSeparator();
+
+    QAction *exportMetricsAction = new QAction("Export Metrics...", this);
+    connect(exportMetricsAction, &QAction::triggered, this, &MainWindow::onExportMetrics);
+    fileMenu->addAction(exportMetricsAction);
+
+    QAction *recordTraceAction = new QAction("Record Trace", this);
+    recordTraceAction->setCheckable(true);
+    recordTraceAction->setChecked(Tracing::isEnabled());
+    connect(recordTraceAction, &QAction::toggled, this, &MainWindow::onRecordTraceToggled);
+    fileMenu->addAction(recordTraceAction);
+
+    QAction *exportTraceAction = new QAction("Export Trace...", this);
+    connect(exportTraceAction, &QAction::triggered, this, &MainWindow::onExportTrace);
+    fileMenu->addAction(exportTraceAction);
+
+    profileMenu = ui->menubar->addMenu("Profiles");
+    updateProfileMenus();
+}
+
+QString MainWindow::getActiveProfile()
+{
+    return loadSettings()["ActiveProfile"].toString(DEFAULT_PROFILE_NAME);
+}
+
+QStringList MainWindow::getProfileNames()
+{
+    QStringList profileNames = loadSettings()["Profiles"].toObject().keys();
+
+    QString activeProfile = getActiveProfile();
+    if (!profileNames.contains(activeProfile)) {
+        profileNames.append(activeProfile);
+    }
+
+    profileNames.sort(Qt::CaseInsensitive);
+
+    return profileNames;
+}
+
+QString MainWindow::getScopeKey(QStringList addresses)
+{
+    // Everything the scope is computed from, except the sharding which is done when applying
+    QByteArray universe = QJsonDocument(loadSettings()["Universe"].toObject()).toJson(QJsonDocument::Compact);
+
+    return QString::fromLatin1(QCryptographicHash::hash(addresses.join(",").toUtf8() + ";" + universe, QCryptographicHash::Sha1).toHex());
+}
+
+QString MainWindow::getCachedProfileScope(QString name, QStringList addresses)
+{
+    QJsonObject cache = loadSettings()["ProfileScopes"].toObject()[name].toObject();
+    if (cache["Key"].toString() != getScopeKey(addresses)) {
+        return QString();
+    }
+
+    return cache["Scope"].toString();
+}
+
+void MainWindow::setCachedProfileScope(QString name, QString key, QString scope)
+{
+    QJsonObject cache;
+    cache["Key"] = key;
+    cache["Scope"] = scope;
+
+    QJsonObject profileScopes = loadSettings()["ProfileScopes"].toObject();
+    profileScopes[name] = cache;
+    settingsStore->setValue("ProfileScopes", profileScopes);
+}
+
+void MainWindow::cacheActiveProfileScope()
+{
+    requestProfileScope(getActiveProfile(), customAddressListWidget->getAddresses());
+}
+
+void MainWindow::refreshProfileScopes()
+{
+    cacheActiveProfileScope();
+
+    QString activeProfile = getActiveProfile();
+    QJsonObject profiles = loadSettings()["Profiles"].toObject();
+    QStringList profileNames = profiles.keys();
+    for (int i = 0; i < profileNames.count(); i += 1) {
+        if (profileNames[i] == activeProfile) {
+            continue;
         }
 
+        requestProfileScope(profileNames[i], getProfileAddresses(profiles[profileNames[i]].toObject()));
+    }
+}
+
+void MainWindow::requestProfileScope(QString name, QStringList addresses)
+{
+    QString key = getScopeKey(addresses);
+    if (pendingScopeKeys.value(name) == key || loadSettings()["ProfileScopes"].toObject()[name].toObject()["Key"].toString() == key) {
+        return;
+    }
+
+    // Only the latest request of a profile is stored when its result comes back
+    pendingScopeKeys[name] = key;
+
+    ScopeBuilder *scopeBuilder = this->scopeBuilder;
+    QList<AddressRange> universe = getUniverse();
+    QList<Address6Range> universe6 = getUniverse6();
+    QMetaObject::invokeMethod(scopeBuilder, [scopeBuilder, name, key, addresses, universe, universe6]() {
+        scopeBuilder->buildScope(name, key, addresses, universe, universe6);
+    }, Qt::QueuedConnection);
+}
+
+void MainWindow::onProfileScopeBuilt(QString name, QString key, QString scope)
+{
+    if (pendingScopeKeys.value(name) != key) {
+        return;
+    }
+
+    pendingScopeKeys.remove(name);
+
+    // The profile may have been deleted while its scope was being built
+    if (!loadSettings()["Profiles"].toObject().contains(name) && name != getActiveProfile()) {
+        return;
+    }
+
+    setCachedProfileScope(name, key, scope);
+}
+
+QStringList MainWindow::getProfileAddresses(QJsonObject profile)
+{
+    QStringList addresses;
+    QJsonArray jsonArray = profile["Addresses"].toArray();
+    for (int i = 0; i < jsonArray.count(); i += 1) {
+        addresses.append(jsonArray[i].toString());
+    }
+
+    return addresses;
+}
+
+bool MainWindow::switchProfile(QString name, bool prompt)
+{
+    static MetricHistogram *switchHistogram = Metrics::histogram("profile_switch_seconds", "Time to switch profiles, rules and list included");
+    static MetricCounter *cachedScopeCounter = Metrics::counter("profile_switch_cached_scopes_total", "Profile switches that used a cached scope");
+
+    TraceSpan span("profile.switch");
+
+    QString activeProfile = getActiveProfile();
+    QJsonObject profiles = loadSettings()["Profiles"].toObject();
+    if (name == activeProfile || !profiles.contains(name)) {
         return false;
     }
 
+    QElapsedTimer timer;
+    timer.start();
+
+    // Park the current list in its profile. The active profile's addresses live in the list itself.
+    profileScopeTimer->stop();
+    cacheActiveProfileScope();
+
+    QJsonObject currentProfile = profiles[activeProfile].toObject();
+    currentProfile["Addresses"] = QJsonArray::fromStringList(customAddressListWidget->getAddresses());
+    profiles[activeProfile] = currentProfile;
+
+    QJsonObject targetProfile = profiles[name].toObject();
+    QStringList addresses = getProfileAddresses(targetProfile);
+    targetProfile.remove("Addresses");
+    profiles[name] = targetProfile;
+
+    settingsStore->setValue("Profiles", profiles);
+    settingsStore->setValue("ActiveProfile", name);
+
+    QString scope = getCachedProfileScope(name, addresses);
+    bool cached = !scope.isEmpty();
+    if (!cached) {
+        scope = getScopeForAddresses(addresses);
+        setCachedProfileScope(name, getScopeKey(addresses), scope);
+        pendingScopeKeys.remove(name);
+    }
+
+    // The firewall goes first, the list is only for display
+    bool success = true;
+    if (isWhitelistOn() && !addFirewallRules(scope)) {
+        onFailAddRules(prompt);
+        success = false;
+    }
+
+    qint64 applyMs = timer.elapsed();
+
+    customAddressListWidget->clearAddresses();
+    customAddressListWidget->addAddressesToList(addresses);
+
+    if (isBinaryWhitelist()) {
+        saveBinaryWhitelist();
+    } else {
+        saveAddresses();
+    }
+
+    switchHistogram->record(timer.nsecsElapsed());
+    if (cached) {
+        cachedScopeCounter->add();
+    }
+
+    QString text = QString("Switched to profile %1 in %2 ms (rules applied in %3 ms, %4 scope)").arg(name).arg(timer.elapsed()).arg(applyMs).arg(cached ? "cached" : "computed");
+    ui->statusbar->showMessage(text);
+
+    updateProfileMenus();
+
+    return success;
+}
+
+void MainWindow::onNewProfile()
+{
+    QString name = QInputDialog::getText(this, "New Profile", "Profile name:").trimmed();
+    if (name.isEmpty()) {
+        return;
+    }
+
+    if (getProfileNames().contains(name)) {
+        QMessageBox::information(this, "Information", QString("Profile already exists - %1").arg(name));
+        return;
+    }
+
+    QJsonObject profiles = loadSettings()["Profiles"].toObject();
+    if (!profiles.contains(getActiveProfile())) {
+        profiles[getActiveProfile()] = QJsonObject();
+    }
+
+    QJsonObject profile;
+    profile["Addresses"] = QJsonArray();
+    profiles[name] = profile;
+    settingsStore->setValue("Profiles", profiles);
+
+    switchProfile(name, true);
+}
+
+void MainWindow::onDeleteProfile()
+{
+    QStringList profileNames = getProfileNames();
+    if (profileNames.count() < 2) {
+        QMessageBox::information(this, "Information", "The last profile cannot be deleted.");
+        return;
+    }
+
+    QString name = getActiveProfile();
+    if (QMessageBox::question(this, "Delete Profile", QString("Delete profile %1 and its addresses?").arg(name)) != QMessageBox::Yes) {
+        return;
+    }
+
+    profileNames.removeOne(name);
+    if (!switchProfile(profileNames.first(), true) && getActiveProfile() == name) {
+        return;
+    }
+
+    QJsonObject profiles = loadSettings()["Profiles"].toObject();
+    profiles.remove(name);
+    settingsStore->setValue("Profiles", profiles);
+
+    QJsonObject profileScopes = loadSettings()["ProfileScopes"].toObject();
+    profileScopes.remove(name);
+    settingsStore->setValue("ProfileScopes", profileScopes);
+
+    updateProfileMenus();
+}
+
+void MainWindow::updateProfileMenus()
+{
+    QString activeProfile = getActiveProfile();
+    QStringList profileNames = getProfileNames();
+
+    QList<QMenu *> menus;
+    menus.append(profileMenu);
+    if (trayProfileMenu != nullptr) {
+        menus.append(trayProfileMenu);
+    }
+
+    for (int i = 0; i < menus.count(); i += 1) {
+        QMenu *menu = menus[i];
+        menu->clear();
+
+        QActionGroup *actionGroup = new QActionGroup(menu);
+        for (int j = 0; j < profileNames.count(); j += 1) {
+            QString name = profileNames[j];
+            QAction *action = menu->addAction(name);
+            action->setCheckable(true);
+            action->setChecked(name == activeProfile);
+            actionGroup->addAction(action);
+            connect(action, &QAction::triggered, this, [this, name]() { switchProfile(name, true); });
+        }
+
+        if (menu == profileMenu) {
+            menu->addSeparator();
+            menu->addAction("New Profile...", this, &MainWindow::onNewProfile);
+            menu->addAction("Delete Profile", this, &MainWindow::onDeleteProfile);
+        }
+    }
+
+    if (trayIcon != nullptr) {
+        trayIcon->setToolTip(QString("%1 - %2").arg(windowTitle()).arg(activeProfile));
+    }
+}
+
+void MainWindow::onImportAddresses()
+{
+    QString filename = QFileDialog::getOpenFileName(this, "Import Addresses", QString(), "JSON (*.json)");
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    QFile loadFile(filename);
+    if (!loadFile.open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(this, "Warning", QString("Unable to read file\n%1").arg(filename));
+        return;
+    }
+
+    // Either a settings.json style object or a plain array of addresses
+    QJsonDocument jsonDocument = QJsonDocument::fromJson(loadFile.readAll());
+    QJsonArray jsonArray = jsonDocument.isArray() ? jsonDocument.array() : jsonDocument.object()["Addresses"].toArray();
+
     QStringList addresses;
-    for (int i = 0; i < addressListWidget->count(); i += 1) {
-        QListWidgetItem *item = addressListWidget->item(i);
-        addresses.append(item->text());
+    addresses.reserve(jsonArray.count());
+    for (int i = 0; i < jsonArray.count(); i += 1) {
+        addresses.append(jsonArray[i].toString().trimmed());
+    }
+
+    addAddresses(addresses, true);
+}
+
+void MainWindow::onExportAddresses()
+{
+    QString filename = QFileDialog::getSaveFileName(this, "Export Addresses", "addresses.json", "JSON (*.json)");
+    if (filename.isEmpty()) {
+        return;
     }
 
     QJsonObject jsonObject;
-    jsonObject["Addresses"] = QJsonArray::fromStringList(addresses);
+    jsonObject["Addresses"] = QJsonArray::fromStringList(customAddressListWidget->getAddresses());
 
-    QJsonDocument saveDoc(jsonObject);
-    saveFile.write(saveDoc.toJson());
+    QSaveFile saveFile(filename);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
+        return;
+    }
 
-    return true;
+    saveFile.write(QJsonDocument(jsonObject).toJson());
+    if (!saveFile.commit()) {
+        QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
+    }
 }
 
-QStringList MainWindow::getSavedAddresses(bool prompt)
+void MainWindow::onExportMetrics()
 {
-    QString filename = SETTINGS_FILENAME;
-    QFile loadFile(filename);
-    if (!loadFile.exists()) {
-        return QStringList();
+    QString filename = QFileDialog::getSaveFileName(this, "Export Metrics", "metrics.json", "JSON (*.json)");
+    if (filename.isEmpty()) {
+        return;
     }
 
-    if (!loadFile.open(QIODevice::ReadOnly)) {
-        if (prompt) {
-            QMessageBox::warning(this, "Warning", QString("Unable to read file\n%1").arg(filename));
-        }
+    QSaveFile saveFile(filename);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
+        return;
+    }
 
-        return QStringList();
+    saveFile.write(QJsonDocument(Metrics::toJson()).toJson());
+    if (!saveFile.commit()) {
+        QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
     }
+}
 
-    QByteArray saveData = loadFile.readAll();
-    QJsonDocument loadDoc(QJsonDocument::fromJson(saveData));
-    QJsonObject jsonObject = loadDoc.object();
+void MainWindow::onRecordTraceToggled(bool checked)
+{
+    // A new recording starts from an empty trace
+    if (checked) {
+        Tracing::clear();
+    }
+
+    Tracing::setEnabled(checked);
+}
 
+void MainWindow::onExportTrace()
+{
+    QString filename = QFileDialog::getSaveFileName(this, "Export Trace", "trace.json", "JSON (*.json)");
+    if (filename.isEmpty()) {
+        return;
+    }
+
+    QSaveFile saveFile(filename);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
+        return;
+    }
+
+    saveFile.write(QJsonDocument(Tracing::toChromeTrace()).toJson(QJsonDocument::Compact));
+    if (!saveFile.commit()) {
+        QMessageBox::warning(this, "Warning", QString("Unable to write to file\n%1").arg(filename));
+    }
+}
+
+void MainWindow::initMetricsServer()
+{
+    // Off unless a port is configured; the server only ever listens on loopback
+    int port = loadSettings()["MetricsPort"].toInt(0);
+    if (port <= 0) {
+        return;
+    }
+
+    metricsServer = new MetricsServer(this);
+    if (!metricsServer->start(port)) {
+        QMessageBox::warning(this, "Warning", metricsServer->getError());
+    }
+}
+
+void MainWindow::onSettingsWriteFailed(QString error)
+{
+    QMessageBox::warning(this, "Warning", error);
+}
+
+QStringList MainWindow::getSavedAddresses(bool prompt)
+{
+    QJsonObject jsonObject = loadSettings(prompt);
     if (!jsonObject.contains("Addresses")) {
         return QStringList();
     }
@@ -291,14 +948,14 @@ void MainWindow::setFirewallStatus()
     }
 
     QMap<QString, bool> profiles;
-    if (currentProfiles & NET_FW_PROFILE2_DOMAIN) {
-        profiles["Domain"] = firewallTool->isProfileEnabled(NET_FW_PROFILE2_DOMAIN);
+    if (currentProfiles & FirewallTool::ProfileDomain) {
+        profiles["Domain"] = firewallTool->isProfileEnabled(FirewallTool::ProfileDomain);
     }
-    if (currentProfiles & NET_FW_PROFILE2_PRIVATE) {
-        profiles["Private"] = firewallTool->isProfileEnabled(NET_FW_PROFILE2_PRIVATE);
+    if (currentProfiles & FirewallTool::ProfilePrivate) {
+        profiles["Private"] = firewallTool->isProfileEnabled(FirewallTool::ProfilePrivate);
     }
-    if (currentProfiles & NET_FW_PROFILE2_PUBLIC) {
-        profiles["Public"] = firewallTool->isProfileEnabled(NET_FW_PROFILE2_PUBLIC);
+    if (currentProfiles & FirewallTool::ProfilePublic) {
+        profiles["Public"] = firewallTool->isProfileEnabled(FirewallTool::ProfilePublic);
     }
 
     if (!profiles.isEmpty()) {
@@ -331,112 +988,280 @@ void MainWindow::setFirewallStatus()
     }
 }
 
-QString MainWindow::getAddressScope()
+QList<AddressRange> MainWindow::getUniverse()
 {
-    QString minAddress = MIN_ADDRESS;
-    QString maxAddress = MAX_ADDRESS;
+    QJsonObject universeObject = loadSettings()["Universe"].toObject();
 
-    QStringList addresses;
-    for (int i = 0; i < addressListWidget->count(); i += 1) {
-        QString address = addressListWidget->item(i)->text();
-        addresses.append(address);
+    AddressRange bounds;
+    QString minAddress = universeObject["Min"].toString(MIN_ADDRESS);
+    QString maxAddress = universeObject["Max"].toString(MAX_ADDRESS);
+    if (!ScopeTool::parseRange(QString("%1-%2").arg(minAddress, maxAddress), &bounds)) {
+        ScopeTool::parseRange(QString("%1-%2").arg(MIN_ADDRESS, MAX_ADDRESS), &bounds);
     }
 
-    for (int i = 0; i < addresses.count(); i += 1) {
-        QString address = addresses[i];
-        if (QString::compare(address, minAddress, Qt::CaseSensitive) != 0) {
-            break;
+    QList<AddressRange> excluded;
+    if (universeObject["ExcludeReserved"].toBool(true)) {
+        excluded.append(ScopeTool::getReservedRanges());
+    }
+
+    QJsonArray excludedArray = universeObject["Excluded"].toArray();
+    for (int i = 0; i < excludedArray.count(); i += 1) {
+        AddressRange range;
+        if (ScopeTool::parseRange(excludedArray[i].toString(), &range)) {
+            excluded.append(range);
         }
+    }
+
+    return ScopeTool::subtractRanges(bounds, excluded);
+}
 
-        minAddress = IPTool::incrementAddress(address);
+QList<Address6Range> MainWindow::getUniverse6()
+{
+    QJsonObject universeObject = loadSettings()["Universe"].toObject();
+
+    // Only global unicast space is blocked by default
+    Address6Range bounds;
+    QString minAddress = universeObject["Min6"].toString(MIN_ADDRESS6);
+    QString maxAddress = universeObject["Max6"].toString(MAX_ADDRESS6);
+    if (!ScopeTool::parseRange6(QString("%1-%2").arg(minAddress, maxAddress), &bounds)) {
+        ScopeTool::parseRange6(QString("%1-%2").arg(MIN_ADDRESS6, MAX_ADDRESS6), &bounds);
     }
 
-    for (int i = addresses.count() - 1; i >= 0; i -= 1) {
-        QString address = addresses[i];
-        if (QString::compare(address, maxAddress, Qt::CaseSensitive) != 0) {
-            break;
+    QList<Address6Range> excluded;
+    if (universeObject["ExcludeReserved"].toBool(true)) {
+        excluded.append(ScopeTool::getReservedRanges6());
+    }
+
+    QJsonArray excludedArray = universeObject["Excluded"].toArray();
+    for (int i = 0; i < excludedArray.count(); i += 1) {
+        Address6Range range;
+        if (ScopeTool::parseRange6(excludedArray[i].toString(), &range)) {
+            excluded.append(range);
         }
+    }
+
+    return ScopeTool::subtractRanges6(bounds, excluded);
+}
+
+QString MainWindow::getAddressScope()
+{
+    TraceSpan span("scope.build");
+
+    // The mapped whitelist already holds the merged ranges while it matches the list
+    QList<AddressRange> allowedRanges;
+    QList<Address6Range> allowedRanges6;
+    if (whitelistFileCurrent) {
+        allowedRanges = whitelistFile->getRanges();
+        allowedRanges6 = whitelistFile->getRanges6();
+    } else {
+        getListRanges(&allowedRanges, &allowedRanges6);
+    }
 
-        maxAddress = IPTool::decrementAddress(address);
+    return getScopeForRanges(allowedRanges, allowedRanges6);
+}
+
+QString MainWindow::getScopeForRanges(QList<AddressRange> allowedRanges, QList<Address6Range> allowedRanges6)
+{
+    return ScopeBuilder::getScopeForRanges(allowedRanges, allowedRanges6, getUniverse(), getUniverse6());
+}
+
+QString MainWindow::getScopeForAddresses(QStringList addresses)
+{
+    return ScopeBuilder::getScopeForAddresses(addresses, getUniverse(), getUniverse6());
+}
+
+int MainWindow::getScopeRangeCount(QString scope)
+{
+    // The placeholder scope of an empty universe blocks nothing
+    if (scope == EMPTY_SCOPE) {
+        return 0;
     }
 
-    QHostAddress minHostAddress = IPTool::getQHostAddress(minAddress);
-    quint32 minIpv4Address = minHostAddress.toIPv4Address();
+    return scope.count(",") + 1;
+}
+
+QStringList MainWindow::getShardScopes(QString scope)
+{
+    TraceSpan span("scope.shard");
 
-    QHostAddress maxHostAddress = IPTool::getQHostAddress(maxAddress);
-    quint32 maxIpv4Address = maxHostAddress.toIPv4Address();
+    QStringList ranges = scope.split(",", Qt::SkipEmptyParts);
+    int maxRanges = getMaxRangesPerRule();
 
-    if (minIpv4Address > maxIpv4Address) {
-        return QString("0.0.0.0");
+    QStringList shardScopes;
+    for (int i = 0; i < ranges.count(); i += maxRanges) {
+        shardScopes.append(ranges.mid(i, maxRanges).join(","));
     }
 
-    QString scope = QString("%1-").arg(minAddress);
-    for (int i = 0; i < addressListWidget->count(); i += 1) {
-        QString address = addressListWidget->item(i)->text();
-        QHostAddress hostAddress = IPTool::getQHostAddress(address);
-        quint32 ipv4Address = hostAddress.toIPv4Address();
-        if (!hostAddress.isNull() && ipv4Address > minIpv4Address && ipv4Address < maxIpv4Address) {
-            QString nextStartAddress = IPTool::incrementAddress(address);
-            for (int j = i + 1; j < addressListWidget->count(); j += 1) {
-                QString address = addressListWidget->item(j)->text();
-                if (nextStartAddress != address) {
-                    break;
-                }
+    return shardScopes;
+}
 
-                nextStartAddress = IPTool::incrementAddress(address);
-                i += 1;
-            }
+int MainWindow::getMaxRangesPerRule()
+{
+    QJsonObject jsonObject = loadSettings();
+    int maxRanges = jsonObject["MaxRangesPerRule"].toInt(MAX_RANGES_PER_RULE);
+    if (maxRanges <= 0) {
+        return MAX_RANGES_PER_RULE;
+    }
 
-            scope = QString("%1%2,%3-").arg(scope, IPTool::decrementAddress(address), nextStartAddress);
-        }
+    return maxRanges;
+}
+
+QString MainWindow::getInboundRuleName(int shard)
+{
+    // The first shard keeps the original name so existing rules are still recognised
+    if (shard == 0) {
+        return QString("%1 - Inbound").arg(APP_NAME);
     }
-    scope = QString("%1%2").arg(scope, maxAddress);
 
-    return scope;
+    return QString("%1 - Inbound (%2)").arg(APP_NAME).arg(shard + 1);
 }
 
-QString MainWindow::getInboundRuleName()
+QString MainWindow::getOutboundRuleName(int shard)
 {
-    return QString("%1 - Inbound").arg(APP_NAME);
+    if (shard == 0) {
+        return QString("%1 - Outbound").arg(APP_NAME);
+    }
+
+    return QString("%1 - Outbound (%2)").arg(APP_NAME).arg(shard + 1);
 }
 
-QString MainWindow::getOutboundRuleName()
+bool MainWindow::removeFirewallRules(int fromShard)
 {
-    return QString("%1 - Outbound").arg(APP_NAME);
+    TraceSpan span("firewall.removeShards");
+
+    bool success = true;
+
+    for (int shard = fromShard; ; shard += 1) {
+        QString inboundRuleName = getInboundRuleName(shard);
+        QString outboundRuleName = getOutboundRuleName(shard);
+
+        // A shard in the middle may have been removed outside of the program, so look
+        // at least as far as shards were ever applied before stopping at a gap
+        bool hasInbound = firewallTool->hasRule(inboundRuleName);
+        bool hasOutbound = firewallTool->hasRule(outboundRuleName);
+        if (!hasInbound && !hasOutbound) {
+            if (shard >= shardHighWater) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (hasInbound && !firewallTool->removeRule(inboundRuleName)) {
+            success = false;
+        }
+
+        if (hasOutbound && !firewallTool->removeRule(outboundRuleName)) {
+            success = false;
+        }
+
+        if (!success) {
+            break;
+        }
+    }
+
+    while (appliedShardScopes.count() > fromShard) {
+        appliedShardScopes.removeLast();
+    }
+
+    if (success) {
+        shardHighWater = qMin(shardHighWater, fromShard);
+    }
+
+    return success;
 }
 
-bool MainWindow::removeFirewallRules()
+bool MainWindow::addFirewallRulesShard(int shard, QString remoteAddresses)
 {
-    QString inboundRuleName = getInboundRuleName();
-    QString outboundRuleName = getOutboundRuleName();
+    TraceSpan span("firewall.applyShard");
+
+    QString inboundRuleName = getInboundRuleName(shard);
+    QString outboundRuleName = getOutboundRuleName(shard);
 
-    bool inboundSuccess = true;
     if (firewallTool->hasRule(inboundRuleName)) {
-        inboundSuccess = firewallTool->removeRule(inboundRuleName);
+        firewallTool->removeRule(inboundRuleName);
     }
 
-    bool outboundSuccess = true;
     if (firewallTool->hasRule(outboundRuleName)) {
-        inboundSuccess = firewallTool->removeRule(outboundRuleName);
+        firewallTool->removeRule(outboundRuleName);
     }
 
+    QString localPorts = QString("%1").arg(GTA5ONLINE_PORT);
+
+    bool inboundSuccess = firewallTool->addRule(inboundRuleName, "", APP_NAME, "", FirewallTool::ProtocolUdp, "", localPorts, remoteAddresses, "", FirewallTool::DirectionIn, FirewallTool::ActionBlock, true);
+    bool outboundSuccess = firewallTool->addRule(outboundRuleName, "", APP_NAME, "", FirewallTool::ProtocolUdp, "", localPorts, remoteAddresses, "", FirewallTool::DirectionOut, FirewallTool::ActionBlock, true);
+
     return inboundSuccess && outboundSuccess;
 }
 
 bool MainWindow::addFirewallRules()
 {
-    removeFirewallRules();
+    return addFirewallRules(getAddressScope());
+}
 
-    QString inboundRuleName = getInboundRuleName();
-    QString outboundRuleName = getOutboundRuleName();
+bool MainWindow::addFirewallRules(QString scope)
+{
+    static MetricCounter *applyCounter = Metrics::counter("firewall_applies_total", "Firewall rule applies");
+    static MetricCounter *applyFailureCounter = Metrics::counter("firewall_apply_failures_total", "Firewall rule applies that failed");
+    static MetricCounter *shardCounter = Metrics::counter("firewall_shards_written_total", "Rule shards rewritten by applies");
+    static MetricHistogram *applyHistogram = Metrics::histogram("firewall_apply_seconds", "Time to apply the rules for a scope");
+    static MetricGauge *rangeGauge = Metrics::gauge("firewall_block_ranges", "Ranges blocked by the applied rules");
+    static MetricGauge *scopeLengthGauge = Metrics::gauge("firewall_scope_length", "Characters in the scope of the applied rules");
+    static MetricGauge *shardGauge = Metrics::gauge("firewall_rule_shards", "Rule shards the applied scope is split into");
 
-    QString localPorts = QString("%1").arg(GTA5ONLINE_PORT);
-    QString remoteAddresses = getAddressScope();
+    TraceSpan span("firewall.apply");
 
-    bool inboundSuccess = firewallTool->addRule(inboundRuleName, "", APP_NAME, "", NET_FW_IP_PROTOCOL_UDP, "", localPorts, remoteAddresses, "", NET_FW_RULE_DIR_IN, NET_FW_ACTION_BLOCK, true);
-    bool outboundSuccess = firewallTool->addRule(outboundRuleName, "", APP_NAME, "", NET_FW_IP_PROTOCOL_UDP, "", localPorts, remoteAddresses, "", NET_FW_RULE_DIR_OUT, NET_FW_ACTION_BLOCK, true);
+    QElapsedTimer timer;
+    timer.start();
 
-    return inboundSuccess && outboundSuccess;
+    applyCounter->add();
+
+    QStringList shardScopes = getShardScopes(scope);
+
+    // Only shards whose remote addresses changed since the last apply are rewritten
+    int shardsApplied = 0;
+    for (int i = 0; i < shardScopes.count(); i += 1) {
+        if (i < appliedShardScopes.count() && appliedShardScopes[i] == shardScopes[i]) {
+            continue;
+        }
+
+        shardHighWater = qMax(shardHighWater, i + 1);
+        if (!addFirewallRulesShard(i, shardScopes[i])) {
+            appliedShardScopes.clear();
+            applyFailureCounter->add();
+            return false;
+        }
+
+        if (i < appliedShardScopes.count()) {
+            appliedShardScopes[i] = shardScopes[i];
+        } else {
+            appliedShardScopes.append(shardScopes[i]);
+        }
+
+        shardsApplied += 1;
+        shardCounter->add();
+    }
+
+    // Remove shards left over from a previously larger scope
+    if (!removeFirewallRules(shardScopes.count())) {
+        applyFailureCounter->add();
+        return false;
+    }
+
+    settingsStore->setValue("AppliedFingerprint", getRulesFingerprint(shardScopes));
+
+    if (driftDetector->isActive()) {
+        driftDetector->resetBaseline();
+    }
+
+    applyHistogram->record(timer.nsecsElapsed());
+    rangeGauge->set(getScopeRangeCount(scope));
+    scopeLengthGauge->set(scope.length());
+    shardGauge->set(shardScopes.count());
+
+    ui->statusbar->showMessage(QString("Applied %1 of %2 rule shard(s) in %3 ms").arg(shardsApplied).arg(shardScopes.count()).arg(timer.elapsed()));
+
+    return true;
 }
 
 void MainWindow::onWhitelistOnButtonClicked(bool checked)
@@ -478,6 +1303,7 @@ bool MainWindow::turnWhitelistOn(bool prompt)
     whitelistOnPushButton->setEnabled(false);
     whitelistOffPushButton->setEnabled(true);
 
+    driftDetector->start();
     setTrayIcon();
 
     return true;
@@ -500,6 +1326,7 @@ bool MainWindow::turnWhitelistOff(bool prompt)
     whitelistOnPushButton->setEnabled(true);
     whitelistOffPushButton->setEnabled(false);
 
+    driftDetector->stop();
     setTrayIcon();
 
     return true;
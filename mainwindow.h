@@ -1,5 +1,6 @@
 #include <QMainWindow>
-#include <QListWidget>
+#include <QListView>
+#include <QLineEdit>
 #include <QPushButton>
 #include <QDir>
 #include <QStandardPaths>
@@ -11,10 +12,26 @@
 #include <QHotkey>
 #include <QSystemTrayIcon>
 #include <QMenu>
+#include <QElapsedTimer>
+#include <QCryptographicHash>
+#include <QFileDialog>
+#include <QSaveFile>
+#include <QInputDialog>
+#include <QActionGroup>
+#include <QTimer>
 
 #include "addaddressdialog.h"
 #include "firewalltool.h"
 #include "customaddresslistwidget.h"
+#include "scopetool.h"
+#include "scopebuilder.h"
+#include "driftdetector.h"
+#include "settingsstore.h"
+#include "whitelistfile.h"
+#include "captureservice.h"
+#include "metrics.h"
+#include "metricsserver.h"
+#include "tracing.h"
 
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
@@ -23,7 +40,13 @@
 #define GTA5ONLINE_PORT 6672
 #define MIN_ADDRESS "1.1.1.1"
 #define MAX_ADDRESS "255.255.255.254"
+#define MIN_ADDRESS6 "2000::"
+#define MAX_ADDRESS6 "3fff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"
 #define SETTINGS_FILENAME "settings.json"
+#define WHITELIST_FILENAME "whitelist.bin"
+#define MAX_RANGES_PER_RULE 1000
+#define DEFAULT_PROFILE_NAME "Default"
+#define PROFILE_SCOPE_DELAY_MS 1000
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -33,6 +56,9 @@ class MainWindow : public QMainWindow
 {
     Q_OBJECT
 
+    // Drives the add and apply path without the UI, see replayharness.h
+    friend class ReplayHarness;
+
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
@@ -47,12 +73,28 @@ private:
     QPushButton *whitelistOnPushButton;
     QPushButton *whitelistOffPushButton;
     QPushButton *addPushButton;
-    QListWidget *addressListWidget;
+    QListView *addressListView;
     QLabel *selectCountLabel;
+    QLineEdit *searchLineEdit;
     FirewallTool *firewallTool;
+    DriftDetector *driftDetector;
+    SettingsStore *settingsStore;
+    WhitelistFile *whitelistFile;
+    CaptureService *captureService;
+    bool whitelistFileCurrent = false;
     CustomAddressListWidget *customAddressListWidget;
     QHotkey *hotkey;
-    QSystemTrayIcon *trayIcon;
+    QHotkey *profileHotkey;
+    QSystemTrayIcon *trayIcon = nullptr;
+    QMenu *profileMenu = nullptr;
+    QMenu *trayProfileMenu = nullptr;
+    QTimer *profileScopeTimer;
+    QThread *scopeThread;
+    ScopeBuilder *scopeBuilder;
+    QMap<QString, QString> pendingScopeKeys;
+    QStringList appliedShardScopes;
+    int shardHighWater = 0;
+    MetricsServer *metricsServer = nullptr;
 
     void onAddButtonClicked(bool checked);
     void setFirewallStatus();
@@ -60,15 +102,57 @@ private:
     void onWhitelistOnButtonClicked(bool checked);
     void onWhitelistOffButtonClicked(bool checked);
     void initWhitelist();
-    bool saveAddresses(bool prompt = false);
+    QMap<QString, QString> getAppliedRuleScopes();
+    bool isRulesInSync(QMap<QString, QString> ruleScopes);
+    QString getRulesFingerprint(QStringList shardScopes);
+    QJsonObject loadSettings(bool prompt = false);
+    void saveAddresses();
+    void saveAddressChanges(QStringList added, QStringList removed);
+    bool isBinaryWhitelist();
+    bool loadBinaryWhitelist();
+    void saveBinaryWhitelist();
+    void getListRanges(QList<AddressRange> *ranges, QList<Address6Range> *ranges6);
+    void initMenu();
+    void onImportAddresses();
+    void onExportAddresses();
+    void onExportMetrics();
+    void onRecordTraceToggled(bool checked);
+    void onExportTrace();
+    QString getActiveProfile();
+    QStringList getProfileNames();
+    QStringList getProfileAddresses(QJsonObject profile);
+    QString getScopeKey(QStringList addresses);
+    QString getCachedProfileScope(QString name, QStringList addresses);
+    void setCachedProfileScope(QString name, QString key, QString scope);
+    void cacheActiveProfileScope();
+    void refreshProfileScopes();
+    void requestProfileScope(QString name, QStringList addresses);
+    void onProfileScopeBuilt(QString name, QString key, QString scope);
+    bool switchProfile(QString name, bool prompt = false);
+    void onNewProfile();
+    void onDeleteProfile();
+    void updateProfileMenus();
+    void onProfileHotkeyActivated();
+    void onSettingsWriteFailed(QString error);
+    void onWhitelistWritten(bool success);
     void onSelectionRemoved(QMap<QString, QVariant> itemsRemoved);
+    void onSearchTextChanged(QString text);
     QStringList getSavedAddresses(bool prompt = false);
-    bool isAddressInList(QString address);
-    bool removeFirewallRules();
+    int addAddresses(QStringList addresses, bool alwaysReport = false);
+    bool removeFirewallRules(int fromShard = 0);
     bool addFirewallRules();
+    bool addFirewallRules(QString scope);
+    bool addFirewallRulesShard(int shard, QString remoteAddresses);
+    QList<AddressRange> getUniverse();
+    QList<Address6Range> getUniverse6();
     QString getAddressScope();
-    QString getInboundRuleName();
-    QString getOutboundRuleName();
+    QString getScopeForRanges(QList<AddressRange> allowedRanges, QList<Address6Range> allowedRanges6);
+    QString getScopeForAddresses(QStringList addresses);
+    static int getScopeRangeCount(QString scope);
+    QStringList getShardScopes(QString scope);
+    int getMaxRangesPerRule();
+    QString getInboundRuleName(int shard = 0);
+    QString getOutboundRuleName(int shard = 0);
     QString getSettingsFilepath();
     void onFailAddRules(bool prompt = false);
     void onWhitelistToggleShortcutActivated();
@@ -79,6 +163,9 @@ private:
     void onIconActivated(QSystemTrayIcon::ActivationReason reason);
     void initHotkey();
     void initTrayIcon();
+    void initDriftDetector();
+    void initMetricsServer();
+    void onDriftDetected();
     void setTrayIcon();
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,103 @@
+#include "memoryfirewalltool.h"
+
+QMutex MemoryFirewallTool::rulesMutex;
+QMap<QString, FirewallRule> MemoryFirewallTool::rules;
+
+MemoryFirewallTool::MemoryFirewallTool(QObject *parent) : FirewallTool(parent)
+{
+    initSuccess = true;
+}
+
+void MemoryFirewallTool::setLatency(int msecs)
+{
+    latency = qMax(0, msecs);
+}
+
+void MemoryFirewallTool::delay()
+{
+    if (latency > 0) {
+        QThread::msleep(latency);
+    }
+}
+
+long MemoryFirewallTool::getCurrentProfiles()
+{
+    error.clear();
+    delay();
+
+    return ProfilePrivate;
+}
+
+bool MemoryFirewallTool::isProfileEnabled(Profile profile)
+{
+    error.clear();
+    delay();
+
+    return true;
+}
+
+bool MemoryFirewallTool::removeRule(QString name)
+{
+    error.clear();
+    delay();
+
+    // Removing a rule that does not exist succeeds, as it does with INetFwRules::Remove
+    QMutexLocker locker(&rulesMutex);
+    rules.remove(name);
+
+    return true;
+}
+
+bool MemoryFirewallTool::addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled)
+{
+    error.clear();
+    delay();
+
+    FirewallRule rule;
+    rule.name = name;
+    rule.description = description;
+    rule.grouping = group;
+    rule.applicationName = application;
+    rule.protocol = protocol;
+    rule.localAddresses = laddresses;
+    rule.localPorts = lports;
+    rule.remoteAddresses = raddresses;
+    rule.remotePorts = rports;
+    rule.direction = direction;
+    rule.action = action;
+    rule.profiles = ProfilePrivate;
+    rule.enabled = enabled;
+
+    QMutexLocker locker(&rulesMutex);
+    rules[name] = rule;
+
+    return true;
+}
+
+QList<FirewallRule> MemoryFirewallTool::enumerateRules(QString grouping, QString namePrefix, RuleFields fields)
+{
+    // Every field is kept in memory, so all of them are returned
+    Q_UNUSED(fields);
+
+    delay();
+
+    QMutexLocker locker(&rulesMutex);
+
+    QList<FirewallRule> matches;
+    for (auto it = rules.cbegin(); it != rules.cend(); ++it) {
+        if (matchesFilter(it->name, it->grouping, grouping, namePrefix)) {
+            matches.append(it.value());
+        }
+    }
+
+    return matches;
+}
+
+bool MemoryFirewallTool::hasRule(QString name)
+{
+    error.clear();
+    delay();
+
+    QMutexLocker locker(&rulesMutex);
+    return rules.contains(name);
+}
@@ -0,0 +1,44 @@
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QStringList>
+
+#include "firewalltool.h"
+
+#ifndef MEMORYFIREWALLTOOL_H
+#define MEMORYFIREWALLTOOL_H
+
+/*
+ * Firewall backend that only records the rules it is given. Every call can be
+ * delayed by a fixed latency to mimic the cost of a real firewall. Like the
+ * host firewall, the rules are shared by every instance in the process, so a
+ * second instance on another thread (the drift checker) reads the same rules.
+ */
+class MemoryFirewallTool : public FirewallTool
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryFirewallTool(QObject *parent = nullptr);
+    void setLatency(int msecs);
+    long getCurrentProfiles() override;
+    bool isProfileEnabled(Profile profile) override;
+    bool removeRule(QString name) override;
+    bool addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled) override;
+    bool hasRule(QString name) override;
+
+protected:
+    QList<FirewallRule> enumerateRules(QString grouping, QString namePrefix, RuleFields fields) override;
+
+private:
+    int latency = 0;
+    static QMutex rulesMutex;
+    static QMap<QString, FirewallRule> rules;
+
+    void delay();
+
+signals:
+
+};
+
+#endif // MEMORYFIREWALLTOOL_H
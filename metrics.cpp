@@ -0,0 +1,227 @@
+#include "metrics.h"
+
+#include <QJsonArray>
+#include <QMap>
+#include <QMutex>
+#include <QtAlgorithms>
+
+namespace {
+
+struct MetricEntry
+{
+    QString help;
+    MetricCounter *counter = nullptr;
+    MetricGauge *gauge = nullptr;
+    MetricHistogram *histogram = nullptr;
+};
+
+struct MetricRegistry
+{
+    QMutex mutex;
+    QMap<QString, MetricEntry> entries;
+};
+
+/* Created on first use, so metrics can be registered from anywhere, including other statics */
+MetricRegistry &getRegistry()
+{
+    static MetricRegistry registry;
+    return registry;
+}
+
+}
+
+int MetricHistogram::getBucket(quint64 value)
+{
+    if (value < METRICS_SUB_BUCKETS) {
+        return (int) value;
+    }
+
+    int exponent = 63 - qCountLeadingZeroBits(value);
+    int subBucket = (int) ((value >> (exponent - METRICS_SUB_BUCKET_BITS)) & (METRICS_SUB_BUCKETS - 1));
+
+    return (exponent - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS + subBucket;
+}
+
+quint64 MetricHistogram::getBucketLowerBound(int bucket)
+{
+    if (bucket < METRICS_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    int exponent = bucket / METRICS_SUB_BUCKETS + METRICS_SUB_BUCKET_BITS - 1;
+    quint64 subBucket = bucket % METRICS_SUB_BUCKETS;
+
+    return (METRICS_SUB_BUCKETS + subBucket) << (exponent - METRICS_SUB_BUCKET_BITS);
+}
+
+void MetricHistogram::record(qint64 nanoseconds)
+{
+    if (nanoseconds < 0) {
+        nanoseconds = 0;
+    }
+
+    buckets[getBucket(nanoseconds)].fetchAndAddRelaxed(1);
+    count.fetchAndAddRelaxed(1);
+    sum.fetchAndAddRelaxed(nanoseconds);
+
+    qint64 currentMax = max.loadRelaxed();
+    while (nanoseconds > currentMax && !max.testAndSetRelaxed(currentMax, nanoseconds, currentMax)) {
+    }
+}
+
+qint64 MetricHistogram::getCount() const
+{
+    return count.loadRelaxed();
+}
+
+qint64 MetricHistogram::getSum() const
+{
+    return sum.loadRelaxed();
+}
+
+qint64 MetricHistogram::getMax() const
+{
+    return max.loadRelaxed();
+}
+
+qint64 MetricHistogram::getQuantile(double quantile) const
+{
+    // Buckets are read one by one while others record, which is fine for a snapshot
+    quint64 total = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i += 1) {
+        total += buckets[i].loadRelaxed();
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    quint64 rank = qMax<quint64>(1, (quint64) (quantile * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i += 1) {
+        seen += buckets[i].loadRelaxed();
+        if (seen >= rank) {
+            quint64 lower = getBucketLowerBound(i);
+            quint64 upper = (i + 1 < METRICS_BUCKETS) ? getBucketLowerBound(i + 1) : lower;
+            return qMin<qint64>((qint64) ((lower + upper) / 2), getMax());
+        }
+    }
+
+    return getMax();
+}
+
+MetricCounter *Metrics::counter(QString name, QString help)
+{
+    MetricRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    MetricEntry &entry = registry.entries[name];
+    if (entry.counter == nullptr) {
+        entry.help = help;
+        entry.counter = new MetricCounter();
+    }
+
+    return entry.counter;
+}
+
+MetricGauge *Metrics::gauge(QString name, QString help)
+{
+    MetricRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    MetricEntry &entry = registry.entries[name];
+    if (entry.gauge == nullptr) {
+        entry.help = help;
+        entry.gauge = new MetricGauge();
+    }
+
+    return entry.gauge;
+}
+
+MetricHistogram *Metrics::histogram(QString name, QString help)
+{
+    MetricRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    MetricEntry &entry = registry.entries[name];
+    if (entry.histogram == nullptr) {
+        entry.help = help;
+        entry.histogram = new MetricHistogram();
+    }
+
+    return entry.histogram;
+}
+
+QJsonObject Metrics::toJson()
+{
+    MetricRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    QJsonObject counters;
+    QJsonObject gauges;
+    QJsonObject histograms;
+    for (QMap<QString, MetricEntry>::const_iterator it = registry.entries.constBegin(); it != registry.entries.constEnd(); ++it) {
+        const MetricEntry &entry = it.value();
+        if (entry.counter != nullptr) {
+            counters[it.key()] = entry.counter->get();
+        }
+        if (entry.gauge != nullptr) {
+            gauges[it.key()] = entry.gauge->get();
+        }
+        if (entry.histogram != nullptr) {
+            QJsonObject histogram;
+            histogram["Count"] = entry.histogram->getCount();
+            histogram["SumMs"] = entry.histogram->getSum() / 1000000.0;
+            histogram["MaxMs"] = entry.histogram->getMax() / 1000000.0;
+            histogram["P50Ms"] = entry.histogram->getQuantile(0.5) / 1000000.0;
+            histogram["P90Ms"] = entry.histogram->getQuantile(0.9) / 1000000.0;
+            histogram["P99Ms"] = entry.histogram->getQuantile(0.99) / 1000000.0;
+            histogram["P999Ms"] = entry.histogram->getQuantile(0.999) / 1000000.0;
+            histograms[it.key()] = histogram;
+        }
+    }
+
+    QJsonObject snapshot;
+    snapshot["Counters"] = counters;
+    snapshot["Gauges"] = gauges;
+    snapshot["Histograms"] = histograms;
+
+    return snapshot;
+}
+
+QByteArray Metrics::toPrometheus()
+{
+    MetricRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    // Text exposition format 0.0.4. Histograms go out as summaries, in seconds
+    QByteArray text;
+    for (QMap<QString, MetricEntry>::const_iterator it = registry.entries.constBegin(); it != registry.entries.constEnd(); ++it) {
+        const MetricEntry &entry = it.value();
+        QByteArray name = QByteArray(METRICS_PREFIX) + it.key().toUtf8();
+        QByteArray help = "# HELP " + name + " " + entry.help.toUtf8() + "\n";
+
+        if (entry.counter != nullptr) {
+            text += help;
+            text += "# TYPE " + name + " counter\n";
+            text += name + " " + QByteArray::number(entry.counter->get()) + "\n";
+        }
+        if (entry.gauge != nullptr) {
+            text += help;
+            text += "# TYPE " + name + " gauge\n";
+            text += name + " " + QByteArray::number(entry.gauge->get()) + "\n";
+        }
+        if (entry.histogram != nullptr) {
+            text += help;
+            text += "# TYPE " + name + " summary\n";
+            double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+            for (double quantile : quantiles) {
+                text += name + "{quantile=\"" + QByteArray::number(quantile) + "\"} " + QByteArray::number(entry.histogram->getQuantile(quantile) / 1e9, 'g', 9) + "\n";
+            }
+            text += name + "_sum " + QByteArray::number(entry.histogram->getSum() / 1e9, 'g', 12) + "\n";
+            text += name + "_count " + QByteArray::number(entry.histogram->getCount()) + "\n";
+        }
+    }
+
+    return text;
+}
@@ -0,0 +1,75 @@
+#include <QObject>
+#include <QAtomicInteger>
+#include <QJsonObject>
+#include <QByteArray>
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#define METRICS_PREFIX "gta5online_whitelist_"
+#define METRICS_SUB_BUCKET_BITS 3
+#define METRICS_SUB_BUCKETS (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+class MetricCounter
+{
+public:
+    void add(qint64 value = 1) { count.fetchAndAddRelaxed(value); }
+    qint64 get() const { return count.loadRelaxed(); }
+
+private:
+    QAtomicInteger<qint64> count;
+};
+
+class MetricGauge
+{
+public:
+    void set(qint64 value) { current.storeRelaxed(value); }
+    void add(qint64 value) { current.fetchAndAddRelaxed(value); }
+    qint64 get() const { return current.loadRelaxed(); }
+
+private:
+    QAtomicInteger<qint64> current;
+};
+
+/*
+ * Durations in nanoseconds, bucketed log-linearly like an HDR histogram: every
+ * power of two is split into METRICS_SUB_BUCKETS buckets, so any recorded value
+ * is known to within 12.5%. Recording is a few atomic adds and never allocates.
+ */
+class MetricHistogram
+{
+public:
+    void record(qint64 nanoseconds);
+    qint64 getCount() const;
+    qint64 getSum() const;
+    qint64 getMax() const;
+    qint64 getQuantile(double quantile) const;
+
+private:
+    QAtomicInteger<quint64> buckets[METRICS_BUCKETS];
+    QAtomicInteger<qint64> count;
+    QAtomicInteger<qint64> sum;
+    QAtomicInteger<qint64> max;
+
+    static int getBucket(quint64 value);
+    static quint64 getBucketLowerBound(int bucket);
+};
+
+/*
+ * Process wide registry. Metrics are created on first use and live until exit,
+ * so hot paths look them up once and keep the pointer, typically in a static.
+ * Updates are lock free; only creating a metric and exporting take the lock.
+ */
+class Metrics
+{
+public:
+    static MetricCounter *counter(QString name, QString help);
+    static MetricGauge *gauge(QString name, QString help);
+    static MetricHistogram *histogram(QString name, QString help);
+
+    static QJsonObject toJson();
+    static QByteArray toPrometheus();
+};
+
+#endif // METRICS_H
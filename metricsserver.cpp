@@ -0,0 +1,85 @@
+#include "metricsserver.h"
+
+#include <QJsonDocument>
+
+MetricsServer::MetricsServer(QObject *parent) : QObject(parent)
+{
+    server = new QTcpServer(this);
+    connect(server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+bool MetricsServer::start(quint16 port)
+{
+    if (!server->listen(QHostAddress::LocalHost, port)) {
+        error = QString("Unable to serve metrics on port %1\n%2").arg(port).arg(server->errorString());
+        return false;
+    }
+
+    return true;
+}
+
+QString MetricsServer::getError()
+{
+    return error;
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (server->hasPendingConnections()) {
+        QTcpSocket *socket = server->nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+        // Listening on loopback should already guarantee this
+        if (!socket->peerAddress().isLoopback()) {
+            socket->abort();
+            continue;
+        }
+
+        connect(socket, &QTcpSocket::readyRead, this, [=]() {
+            onReadyRead(socket);
+        });
+    }
+}
+
+void MetricsServer::onReadyRead(QTcpSocket *socket)
+{
+    if (socket->bytesAvailable() > METRICS_MAX_REQUEST_SIZE) {
+        socket->abort();
+        return;
+    }
+
+    // Wait for the whole request head, only its first line is used
+    QByteArray request = socket->peek(METRICS_MAX_REQUEST_SIZE);
+    if (!request.contains("\r\n\r\n")) {
+        return;
+    }
+
+    socket->readAll();
+
+    QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    QByteArray method = requestLine.value(0);
+    QByteArray path = requestLine.value(1);
+
+    if (method != "GET") {
+        respond(socket, "405 Method Not Allowed", "text/plain", "Method Not Allowed\n");
+    } else if (path == "/" || path == "/metrics") {
+        respond(socket, "200 OK", "text/plain; version=0.0.4", Metrics::toPrometheus());
+    } else if (path == "/metrics.json") {
+        respond(socket, "200 OK", "application/json", QJsonDocument(Metrics::toJson()).toJson());
+    } else {
+        respond(socket, "404 Not Found", "text/plain", "Not Found\n");
+    }
+}
+
+void MetricsServer::respond(QTcpSocket *socket, QByteArray status, QByteArray contentType, QByteArray body)
+{
+    QByteArray response;
+    response += "HTTP/1.0 " + status + "\r\n";
+    response += "Content-Type: " + contentType + "\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+
+    socket->write(response);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,36 @@
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QDebug>
+
+#include "metrics.h"
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#define METRICS_MAX_REQUEST_SIZE 8192
+
+/*
+ * Serves the metrics registry over HTTP on the loopback interface only:
+ * "/metrics" as Prometheus text, "/metrics.json" as a JSON snapshot.
+ * One request per connection, nothing is ever read from the body.
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsServer(QObject *parent = nullptr);
+    bool start(quint16 port);
+    QString getError();
+
+private:
+    QTcpServer *server;
+    QString error;
+
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    static void respond(QTcpSocket *socket, QByteArray status, QByteArray contentType, QByteArray body);
+};
+
+#endif // METRICSSERVER_H
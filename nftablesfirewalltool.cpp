@@ -0,0 +1,385 @@
+#include "nftablesfirewalltool.h"
+
+NftablesFirewallTool::NftablesFirewallTool(QObject *parent) : FirewallTool(parent)
+{
+    initSuccess = init();
+}
+
+bool NftablesFirewallTool::init()
+{
+    QString script;
+    script += QString("add table inet %1\n").arg(NFT_TABLE);
+    script += QString("add chain inet %1 input { type filter hook input priority 0 ; policy accept ; }\n").arg(NFT_TABLE);
+    script += QString("add chain inet %1 output { type filter hook output priority 0 ; policy accept ; }\n").arg(NFT_TABLE);
+
+    return runNft(QStringList() << "-f" << "-", script.toUtf8());
+}
+
+bool NftablesFirewallTool::runNft(QStringList arguments, QByteArray input, QByteArray *output)
+{
+    TraceSpan span("firewall.nft");
+
+    QProcess process;
+    process.start(NFT_COMMAND, arguments);
+    if (!process.waitForStarted(NFT_TIMEOUT)) {
+        error = QString("Unable to start %1: %2").arg(NFT_COMMAND, process.errorString());
+        return false;
+    }
+
+    if (!input.isEmpty()) {
+        process.write(input);
+    }
+    process.closeWriteChannel();
+
+    if (!process.waitForFinished(NFT_TIMEOUT)) {
+        process.kill();
+        error = QString("%1 timed out").arg(NFT_COMMAND);
+        return false;
+    }
+
+    if (process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        error = QString("%1 failed: %2").arg(NFT_COMMAND, QString::fromUtf8(process.readAllStandardError()).trimmed());
+        return false;
+    }
+
+    if (output != nullptr) {
+        *output = process.readAllStandardOutput();
+    }
+
+    return true;
+}
+
+QJsonArray NftablesFirewallTool::listTable()
+{
+    QByteArray json;
+    if (!runNft(QStringList() << "-j" << "-a" << "list" << "table" << "inet" << NFT_TABLE, QByteArray(), &json)) {
+        return QJsonArray();
+    }
+
+    return QJsonDocument::fromJson(json).object()["nftables"].toArray();
+}
+
+QList<QJsonObject> NftablesFirewallTool::findRules(QJsonArray objects, QString name)
+{
+    // A rule with both IPv4 and IPv6 remote addresses is made of one nftables rule per family
+    QList<QJsonObject> rules;
+    for (int i = 0; i < objects.count(); i += 1) {
+        QJsonObject rule = objects[i].toObject()["rule"].toObject();
+        if (rule.isEmpty()) {
+            continue;
+        }
+
+        QString comment = rule["comment"].toString();
+        if (QString::compare(comment.section('|', 1), name, Qt::CaseSensitive) == 0) {
+            rules.append(rule);
+        }
+    }
+
+    return rules;
+}
+
+QString NftablesFirewallTool::getSetName(QString name, int family)
+{
+    // Set names are limited in length, so derive a short stable one from the rule name
+    QByteArray hash = QCryptographicHash::hash(name.toUtf8(), QCryptographicHash::Md5).toHex();
+    return QString("r%1%2").arg(QString::fromLatin1(hash.left(14))).arg(family);
+}
+
+QString NftablesFirewallTool::formatJsonValue(QJsonValue value)
+{
+    if (value.isDouble()) {
+        return QString::number(value.toInt());
+    }
+
+    if (value.isString()) {
+        return value.toString();
+    }
+
+    if (value.isArray()) {
+        QStringList texts;
+        QJsonArray array = value.toArray();
+        for (int i = 0; i < array.count(); i += 1) {
+            texts.append(formatJsonValue(array[i]));
+        }
+
+        return texts.join(",");
+    }
+
+    QJsonObject object = value.toObject();
+    if (object.contains("range")) {
+        QJsonArray range = object["range"].toArray();
+        return QString("%1-%2").arg(formatJsonValue(range.at(0)), formatJsonValue(range.at(1)));
+    }
+
+    if (object.contains("prefix")) {
+        QJsonObject prefix = object["prefix"].toObject();
+        return QString("%1/%2").arg(formatJsonValue(prefix["addr"])).arg(prefix["len"].toInt());
+    }
+
+    if (object.contains("set")) {
+        return formatJsonValue(object["set"]);
+    }
+
+    if (object.contains("elem")) {
+        return formatJsonValue(object["elem"].toObject()["val"]);
+    }
+
+    return QString();
+}
+
+long NftablesFirewallTool::getCurrentProfiles()
+{
+    error.clear();
+
+    // nftables has no notion of network profiles
+    return ProfilePrivate;
+}
+
+bool NftablesFirewallTool::isProfileEnabled(Profile profile)
+{
+    Q_UNUSED(profile);
+
+    error.clear();
+
+    return initSuccess;
+}
+
+bool NftablesFirewallTool::hasRule(QString name)
+{
+    error.clear();
+
+    return !findRules(listTable(), name).isEmpty();
+}
+
+bool NftablesFirewallTool::removeRule(QString name)
+{
+    error.clear();
+
+    QJsonArray objects = listTable();
+    if (hasError()) {
+        return false;
+    }
+
+    QList<QJsonObject> rules = findRules(objects, name);
+    if (rules.isEmpty()) {
+        return true;
+    }
+
+    QString script;
+    QStringList setNames;
+    for (int i = 0; i < rules.count(); i += 1) {
+        QJsonObject rule = rules[i];
+        script += QString("delete rule inet %1 %2 handle %3\n").arg(NFT_TABLE, rule["chain"].toString()).arg(rule["handle"].toInt());
+
+        // Delete the sets the rule refers to, whatever they are called
+        QJsonArray expressions = rule["expr"].toArray();
+        for (int j = 0; j < expressions.count(); j += 1) {
+            QString right = formatJsonValue(expressions[j].toObject()["match"].toObject()["right"]);
+            if (right.startsWith('@') && !setNames.contains(right.mid(1))) {
+                setNames.append(right.mid(1));
+            }
+        }
+    }
+
+    for (int i = 0; i < setNames.count(); i += 1) {
+        script += QString("delete set inet %1 %2\n").arg(NFT_TABLE, setNames[i]);
+    }
+
+    return runNft(QStringList() << "-f" << "-", script.toUtf8());
+}
+
+bool NftablesFirewallTool::addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled)
+{
+    // nftables rules have no description or application, the comment carries the group and name
+    Q_UNUSED(description);
+    Q_UNUSED(application);
+
+    // Rule names are unique here, unlike the Windows Firewall
+    if (!removeRule(name)) {
+        return false;
+    }
+
+    error.clear();
+
+    bool inbound = (direction == DirectionIn);
+    QString chain = inbound ? "input" : "output";
+    QString localAddressField = inbound ? "daddr" : "saddr";
+    QString remoteAddressField = inbound ? "saddr" : "daddr";
+    QString localPortField = inbound ? "dport" : "sport";
+    QString remotePortField = inbound ? "sport" : "dport";
+
+    QString statement;
+    if (protocol == ProtocolUdp || protocol == ProtocolTcp) {
+        QString protocolName = (protocol == ProtocolUdp) ? "udp" : "tcp";
+        statement += QString("meta l4proto %1 ").arg(protocolName);
+
+        if (!lports.isEmpty() && lports != "*") {
+            statement += QString("%1 %2 { %3 } ").arg(protocolName, localPortField, lports);
+        }
+
+        if (!rports.isEmpty() && rports != "*") {
+            statement += QString("%1 %2 { %3 } ").arg(protocolName, remotePortField, rports);
+        }
+    }
+
+    if (!laddresses.isEmpty() && laddresses != "*") {
+        statement += QString("ip %1 { %2 } ").arg(localAddressField, laddresses);
+    }
+
+    // A disabled rule is kept as a rule without a verdict, which matches but does nothing
+    QString verdict;
+    if (enabled) {
+        verdict = (action == ActionBlock) ? "drop " : "accept ";
+    }
+
+    QString comment = QString("%1|%2").arg(group, name).replace('"', '\'');
+
+    QString script;
+    if (raddresses.isEmpty() || raddresses == "*") {
+        script += QString("add rule inet %1 %2 %3%4comment \"%5\"\n").arg(NFT_TABLE, chain, statement, verdict, comment);
+        return runNft(QStringList() << "-f" << "-", script.toUtf8());
+    }
+
+    // nftables sets hold a single address family, so split the scope per family
+    QStringList remoteAddresses = raddresses.split(",", Qt::SkipEmptyParts);
+    QStringList remoteAddresses4;
+    QStringList remoteAddresses6;
+    for (int i = 0; i < remoteAddresses.count(); i += 1) {
+        if (remoteAddresses[i].contains(':')) {
+            remoteAddresses6.append(remoteAddresses[i].trimmed());
+        } else {
+            remoteAddresses4.append(remoteAddresses[i].trimmed());
+        }
+    }
+
+    if (!remoteAddresses4.isEmpty()) {
+        QString setName = getSetName(name, 4);
+        script += QString("add set inet %1 %2 { type ipv4_addr ; flags interval ; auto-merge ; }\n").arg(NFT_TABLE, setName);
+        script += QString("add element inet %1 %2 { %3 }\n").arg(NFT_TABLE, setName, remoteAddresses4.join(","));
+        script += QString("add rule inet %1 %2 %3ip %4 @%5 %6comment \"%7\"\n").arg(NFT_TABLE, chain, statement, remoteAddressField, setName, verdict, comment);
+    }
+
+    if (!remoteAddresses6.isEmpty()) {
+        QString setName = getSetName(name, 6);
+        script += QString("add set inet %1 %2 { type ipv6_addr ; flags interval ; auto-merge ; }\n").arg(NFT_TABLE, setName);
+        script += QString("add element inet %1 %2 { %3 }\n").arg(NFT_TABLE, setName, remoteAddresses6.join(","));
+        script += QString("add rule inet %1 %2 %3ip6 %4 @%5 %6comment \"%7\"\n").arg(NFT_TABLE, chain, statement, remoteAddressField, setName, verdict, comment);
+    }
+
+    return runNft(QStringList() << "-f" << "-", script.toUtf8());
+}
+
+FirewallRule NftablesFirewallTool::getRuleInfo(QJsonObject rule, QJsonArray objects)
+{
+    FirewallRule ruleInfo;
+
+    QString comment = rule["comment"].toString();
+    bool inbound = (rule["chain"].toString() == "input");
+
+    ruleInfo.name = comment.section('|', 1);
+    ruleInfo.grouping = comment.section('|', 0, 0);
+    ruleInfo.direction = inbound ? DirectionIn : DirectionOut;
+    ruleInfo.profiles = ProfilePrivate;
+    ruleInfo.enabled = false;
+
+    QJsonArray expressions = rule["expr"].toArray();
+    for (int i = 0; i < expressions.count(); i += 1) {
+        QJsonObject expression = expressions[i].toObject();
+
+        if (expression.contains("drop") || expression.contains("accept")) {
+            ruleInfo.action = expression.contains("drop") ? ActionBlock : ActionAllow;
+            ruleInfo.enabled = true;
+            continue;
+        }
+
+        QJsonObject match = expression["match"].toObject();
+        if (match.isEmpty()) {
+            continue;
+        }
+
+        QJsonObject left = match["left"].toObject();
+        QJsonValue right = match["right"];
+
+        if (left.contains("meta") && left["meta"].toObject()["key"].toString() == "l4proto") {
+            ruleInfo.protocol = (right.toString() == "udp") ? ProtocolUdp : ProtocolTcp;
+            continue;
+        }
+
+        QJsonObject payload = left["payload"].toObject();
+        QString field = payload["field"].toString();
+
+        if (field == "sport" || field == "dport") {
+            bool local = (field == "dport") == inbound;
+            if (local) {
+                ruleInfo.localPorts = formatJsonValue(right);
+            } else {
+                ruleInfo.remotePorts = formatJsonValue(right);
+            }
+        } else if (field == "saddr" || field == "daddr") {
+            bool local = (field == "daddr") == inbound;
+            QString text = formatJsonValue(right);
+
+            // Resolve a named set into its elements
+            if (text.startsWith('@')) {
+                QString setName = text.mid(1);
+                text.clear();
+                for (int j = 0; j < objects.count(); j += 1) {
+                    QJsonObject set = objects[j].toObject()["set"].toObject();
+                    if (set["name"].toString() == setName) {
+                        text = formatJsonValue(set["elem"]);
+                        break;
+                    }
+                }
+            }
+
+            if (local) {
+                ruleInfo.localAddresses = text;
+            } else {
+                ruleInfo.remoteAddresses = text;
+            }
+        }
+    }
+
+    return ruleInfo;
+}
+
+QList<FirewallRule> NftablesFirewallTool::enumerateRules(QString grouping, QString namePrefix, RuleFields fields)
+{
+    // The whole table is returned by a single nft call, so every field comes for free
+    Q_UNUSED(fields);
+
+    QList<FirewallRule> rules;
+
+    QJsonArray objects = listTable();
+    for (int i = 0; i < objects.count(); i += 1) {
+        QJsonObject rule = objects[i].toObject()["rule"].toObject();
+        QString comment = rule["comment"].toString();
+        if (rule.isEmpty() || !comment.contains('|')) {
+            continue;
+        }
+
+        if (!matchesFilter(comment.section('|', 1), comment.section('|', 0, 0), grouping, namePrefix)) {
+            continue;
+        }
+
+        // Fold the per family nftables rules back into one rule
+        FirewallRule ruleInfo = getRuleInfo(rule, objects);
+        bool merged = false;
+        for (int j = 0; j < rules.count(); j += 1) {
+            if (rules[j].name == ruleInfo.name) {
+                QStringList remoteAddresses;
+                remoteAddresses << rules[j].remoteAddresses << ruleInfo.remoteAddresses;
+                remoteAddresses.removeAll(QString());
+                rules[j].remoteAddresses = remoteAddresses.join(",");
+                merged = true;
+                break;
+            }
+        }
+
+        if (!merged) {
+            rules.append(ruleInfo);
+        }
+    }
+
+    return rules;
+}
@@ -0,0 +1,51 @@
+#include <QObject>
+#include <QProcess>
+#include <QCryptographicHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "firewalltool.h"
+
+#ifndef NFTABLESFIREWALLTOOL_H
+#define NFTABLESFIREWALLTOOL_H
+
+#define NFT_COMMAND "nft"
+#define NFT_TABLE "gta5online_whitelist"
+#define NFT_TIMEOUT 5000
+
+/*
+ * Linux backend. Every rule is an nftables rule in its own table whose remote
+ * addresses live in an interval set, so the kernel matches them in O(log n).
+ * IPv4 and IPv6 addresses go to separate sets and rules, which all carry the
+ * comment "<group>|<name>" to find them again.
+ */
+class NftablesFirewallTool : public FirewallTool
+{
+    Q_OBJECT
+
+public:
+    explicit NftablesFirewallTool(QObject *parent = nullptr);
+    long getCurrentProfiles() override;
+    bool isProfileEnabled(Profile profile) override;
+    bool removeRule(QString name) override;
+    bool addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled) override;
+    bool hasRule(QString name) override;
+
+protected:
+    QList<FirewallRule> enumerateRules(QString grouping, QString namePrefix, RuleFields fields) override;
+
+private:
+    bool init();
+    bool runNft(QStringList arguments, QByteArray input, QByteArray *output = nullptr);
+    QJsonArray listTable();
+    QList<QJsonObject> findRules(QJsonArray objects, QString name);
+    QString getSetName(QString name, int family);
+    QString formatJsonValue(QJsonValue value);
+    FirewallRule getRuleInfo(QJsonObject rule, QJsonArray objects);
+
+signals:
+
+};
+
+#endif // NFTABLESFIREWALLTOOL_H
@@ -0,0 +1,113 @@
+#include "pcapresource.h"
+
+#include <cstring>
+
+QAtomicInt PcapHandle::openCount;
+QAtomicInt BpfProgram::compiledCount;
+
+PcapHandle::PcapHandle(pcap_t *handle)
+{
+    this->handle = handle;
+
+    if (handle != NULL) {
+        openCount.ref();
+    }
+}
+
+PcapHandle::PcapHandle(PcapHandle &&other)
+{
+    handle = other.handle;
+    other.handle = NULL;
+}
+
+PcapHandle &PcapHandle::operator=(PcapHandle &&other)
+{
+    if (this != &other) {
+        reset();
+        handle = other.handle;
+        other.handle = NULL;
+    }
+
+    return *this;
+}
+
+PcapHandle::~PcapHandle()
+{
+    reset();
+}
+
+pcap_t *PcapHandle::get() const
+{
+    return handle;
+}
+
+bool PcapHandle::isNull() const
+{
+    return handle == NULL;
+}
+
+void PcapHandle::reset(pcap_t *handle)
+{
+    if (this->handle != NULL) {
+        pcap_close(this->handle);
+        openCount.deref();
+    }
+
+    this->handle = handle;
+
+    if (handle != NULL) {
+        openCount.ref();
+    }
+}
+
+int PcapHandle::getOpenCount()
+{
+    return openCount.loadRelaxed();
+}
+
+BpfProgram::BpfProgram()
+{
+    memset(&program, 0, sizeof(program));
+}
+
+BpfProgram::~BpfProgram()
+{
+    reset();
+}
+
+bool BpfProgram::compile(pcap_t *handle, QString filter, bpf_u_int32 netmask)
+{
+    reset();
+
+    QByteArray text = filter.toLocal8Bit();
+    if (pcap_compile(handle, &program, text.data(), 1, netmask) < 0) {
+        return false;
+    }
+
+    compiled = true;
+    compiledCount.ref();
+
+    return true;
+}
+
+struct bpf_program *BpfProgram::get()
+{
+    return &program;
+}
+
+void BpfProgram::reset()
+{
+    if (!compiled) {
+        return;
+    }
+
+    pcap_freecode(&program);
+    memset(&program, 0, sizeof(program));
+    compiled = false;
+    compiledCount.deref();
+}
+
+int BpfProgram::getCompiledCount()
+{
+    return compiledCount.loadRelaxed();
+}
@@ -0,0 +1,53 @@
+#include <QObject>
+#include <QAtomicInteger>
+
+#include <pcap.h>
+
+#ifndef PCAPRESOURCE_H
+#define PCAPRESOURCE_H
+
+/*
+ * Owns an open capture handle and closes it when it goes out of scope or is
+ * reset. Movable so the handle can be passed on to the capture thread.
+ */
+class PcapHandle
+{
+public:
+    explicit PcapHandle(pcap_t *handle = NULL);
+    PcapHandle(PcapHandle &&other);
+    PcapHandle &operator=(PcapHandle &&other);
+    ~PcapHandle();
+
+    pcap_t *get() const;
+    bool isNull() const;
+    void reset(pcap_t *handle = NULL);
+    static int getOpenCount();
+
+private:
+    Q_DISABLE_COPY(PcapHandle)
+
+    pcap_t *handle;
+    static QAtomicInt openCount;
+};
+
+/* Owns a compiled filter. pcap_setfilter keeps its own copy, so it can be freed right after */
+class BpfProgram
+{
+public:
+    BpfProgram();
+    ~BpfProgram();
+
+    bool compile(pcap_t *handle, QString filter, bpf_u_int32 netmask);
+    struct bpf_program *get();
+    void reset();
+    static int getCompiledCount();
+
+private:
+    Q_DISABLE_COPY(BpfProgram)
+
+    struct bpf_program program;
+    bool compiled = false;
+    static QAtomicInt compiledCount;
+};
+
+#endif // PCAPRESOURCE_H
@@ -0,0 +1,515 @@
+#include "replayharness.h"
+
+#include <QApplication>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <cstring>
+
+#include "mainwindow.h"
+#include "scopetool.h"
+#include "sessiondialog.h"
+#include "sniffer.h"
+#include "pcapresource.h"
+
+ReplayHarness::ReplayHarness(QObject *parent) : QObject(parent)
+{
+    localAddresses.append(REPLAY_DEFAULT_LOCAL_ADDRESS);
+}
+
+void ReplayHarness::setLocalAddresses(QStringList localAddresses)
+{
+    this->localAddresses = localAddresses;
+}
+
+void ReplayHarness::setSpeed(double speed)
+{
+    this->speed = speed;
+}
+
+void ReplayHarness::setExpectedScope(QString scope)
+{
+    expectedScope = scope;
+}
+
+void ReplayHarness::setShowBudget(double msecs)
+{
+    showBudget = msecs;
+}
+
+void ReplayHarness::setApplyBudget(double msecs)
+{
+    applyBudget = msecs;
+}
+
+void ReplayHarness::setStopBudget(double msecs)
+{
+    stopBudget = msecs;
+}
+
+bool ReplayHarness::isPassed()
+{
+    return passed;
+}
+
+bool ReplayHarness::isRequested(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i += 1) {
+        if (strcmp(argv[i], REPLAY_ARGUMENT) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int ReplayHarness::main(QStringList arguments)
+{
+    ReplayHarness replayHarness;
+
+    int index = arguments.indexOf(REPLAY_LOCAL_ARGUMENT);
+    if (index != -1) {
+        replayHarness.setLocalAddresses(arguments.value(index + 1).split(",", Qt::SkipEmptyParts));
+    }
+
+    index = arguments.indexOf(REPLAY_SPEED_ARGUMENT);
+    if (index != -1) {
+        replayHarness.setSpeed(arguments.value(index + 1).toDouble());
+    }
+
+    index = arguments.indexOf(REPLAY_SHOW_BUDGET_ARGUMENT);
+    if (index != -1) {
+        replayHarness.setShowBudget(arguments.value(index + 1).toDouble());
+    }
+
+    index = arguments.indexOf(REPLAY_APPLY_BUDGET_ARGUMENT);
+    if (index != -1) {
+        replayHarness.setApplyBudget(arguments.value(index + 1).toDouble());
+    }
+
+    index = arguments.indexOf(REPLAY_STOP_BUDGET_ARGUMENT);
+    if (index != -1) {
+        replayHarness.setStopBudget(arguments.value(index + 1).toDouble());
+    }
+
+    index = arguments.indexOf(REPLAY_EXPECT_ARGUMENT);
+    if (index != -1) {
+        QFile expectFile(arguments.value(index + 1));
+        if (!expectFile.open(QIODevice::ReadOnly)) {
+            qDebug() << "Unable to read" << expectFile.fileName() << expectFile.errorString();
+            return 1;
+        }
+
+        replayHarness.setExpectedScope(QString::fromUtf8(expectFile.readAll()).trimmed());
+    }
+
+    QString filename = arguments.value(arguments.indexOf(REPLAY_ARGUMENT) + 1);
+
+    QJsonObject report;
+    index = arguments.indexOf(REPLAY_SOAK_ARGUMENT);
+    if (index != -1) {
+        report = replayHarness.soak(filename, arguments.value(index + 1).toInt());
+    } else {
+        report = replayHarness.run(filename);
+    }
+
+    QByteArray json = QJsonDocument(report).toJson();
+
+    index = arguments.indexOf(REPLAY_OUTPUT_ARGUMENT);
+    if (index == -1) {
+        QFile output;
+        output.open(stdout, QIODevice::WriteOnly);
+        output.write(json);
+    } else {
+        QSaveFile file(arguments.value(index + 1));
+        if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+            qDebug() << "Unable to write" << file.fileName() << file.errorString();
+            return 1;
+        }
+    }
+
+    return replayHarness.isPassed() ? 0 : 1;
+}
+
+void ReplayHarness::wait(int msecs)
+{
+    QEventLoop loop;
+    QTimer::singleShot(msecs, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+QString ReplayHarness::getIdleDevice(Sniffer *sniffer)
+{
+    // Loopback never carries game traffic; any other adapter only does while the game runs
+    QStringList deviceNames;
+    QStringList otherDeviceNames;
+    QStringList allDeviceNames = sniffer->getDeviceNames();
+    for (int i = 0; i < allDeviceNames.count(); i += 1) {
+        if (sniffer->getDeviceInfo(allDeviceNames[i])["Loopback"].toBool()) {
+            deviceNames.append(allDeviceNames[i]);
+        } else {
+            otherDeviceNames.append(allDeviceNames[i]);
+        }
+    }
+    deviceNames.append(otherDeviceNames);
+
+    for (int i = 0; i < deviceNames.count(); i += 1) {
+        if (sniffer->startSniffing(deviceNames[i])) {
+            sniffer->stopSniffing();
+            return deviceNames[i];
+        }
+    }
+
+    return QString();
+}
+
+void ReplayHarness::addCheck(QString name, bool checkPassed, QJsonValue value, QJsonValue expected)
+{
+    QJsonObject check;
+    check["Name"] = name;
+    check["Passed"] = checkPassed;
+    check["Value"] = value;
+    check["Expected"] = expected;
+    checks.append(check);
+
+    if (!checkPassed) {
+        passed = false;
+    }
+}
+
+QJsonObject ReplayHarness::run(QString filename)
+{
+    checks = QJsonArray();
+    passed = true;
+
+    QJsonObject report;
+    report["Version"] = REPLAY_FORMAT_VERSION;
+    report["Capture"] = filename;
+    report["Speed"] = speed;
+
+    // Settings, the binary whitelist and the rules all stay in a scratch directory and in memory
+    QTemporaryDir directory;
+    if (!directory.isValid()) {
+        addCheck("ScratchDirectory", false, directory.errorString(), QJsonValue());
+        report["Checks"] = checks;
+        report["Passed"] = passed;
+        return report;
+    }
+
+    QString previousDirectory = QDir::currentPath();
+    QDir::setCurrent(directory.path());
+    qputenv(FIREWALL_BACKEND_ENV, "memory");
+
+    {
+        MainWindow window;
+        window.turnWhitelistOn(false);
+
+        Sniffer sniffer;
+        SessionDialog sessionDialog(&sniffer, localAddresses, &window);
+        sessionDialog.setLookupEnabled(false);
+
+        QEventLoop loop;
+        connect(&sniffer, &Sniffer::sniffFinished, &loop, &QEventLoop::quit);
+
+        QElapsedTimer replayTimer;
+        replayTimer.start();
+
+        bool started = sniffer.startReplay(filename, speed);
+        addCheck("Replay", started, filename, QJsonValue());
+        if (started) {
+            loop.exec();
+            report["ReplayMs"] = replayTimer.elapsed();
+
+            // The last sightings are still queued, give them a few frames to be rendered
+            wait(REPLAY_SETTLE_FRAMES * sessionDialog.getStats()["FrameIntervalMs"].toInt());
+
+            QMap<QString, QVariant> sessionStats = sessionDialog.getStats();
+            report["Session"] = QJsonObject::fromVariantMap(sessionStats);
+
+            // Select everything the session shows and add it, as the Add dialog does
+            QStringList addresses = sessionDialog.getAddresses();
+            report["SessionAddresses"] = addresses.count();
+
+            QElapsedTimer applyTimer;
+            applyTimer.start();
+            window.addAddresses(addresses);
+            double applyMs = applyTimer.nsecsElapsed() / 1000000.0;
+            report["ApplyMs"] = applyMs;
+
+            // Read back what the backend holds rather than what MainWindow meant to apply
+            QMap<QString, QString> ruleScopes = window.getAppliedRuleScopes();
+            QStringList shardScopes;
+            for (int shard = 0; ruleScopes.contains(window.getInboundRuleName(shard)); shard += 1) {
+                shardScopes.append(ruleScopes[window.getInboundRuleName(shard)]);
+            }
+
+            QString scope = ScopeTool::normaliseScope(shardScopes.join(","));
+            report["ScopeShards"] = shardScopes.count();
+            report["ScopeSha1"] = QString(QCryptographicHash::hash(scope.toUtf8(), QCryptographicHash::Sha1).toHex());
+
+            QStringList parts = scope.split(",", Qt::SkipEmptyParts);
+            QList<AddressRange> blockRanges;
+            QList<Address6Range> blockRanges6;
+            for (int i = 0; i < parts.count(); i += 1) {
+                AddressRange range;
+                Address6Range range6;
+                if (ScopeTool::parseRange(parts[i], &range)) {
+                    blockRanges.append(range);
+                } else if (ScopeTool::parseRange6(parts[i], &range6)) {
+                    blockRanges6.append(range6);
+                }
+            }
+
+            QStringList blocked;
+            for (int i = 0; i < addresses.count(); i += 1) {
+                QHostAddress hostAddress = IPTool::getAnyQHostAddress(addresses[i]);
+                bool isBlocked = false;
+                if (hostAddress.protocol() == QAbstractSocket::IPv4Protocol) {
+                    quint32 address = hostAddress.toIPv4Address();
+                    for (int j = 0; j < blockRanges.count() && !isBlocked; j += 1) {
+                        isBlocked = address >= blockRanges[j].first && address <= blockRanges[j].second;
+                    }
+                } else {
+                    Ipv6Address address = Ipv6Address::fromQHostAddress(hostAddress);
+                    for (int j = 0; j < blockRanges6.count() && !isBlocked; j += 1) {
+                        isBlocked = address >= blockRanges6[j].first && address <= blockRanges6[j].second;
+                    }
+                }
+
+                if (isBlocked) {
+                    blocked.append(addresses[i]);
+                }
+            }
+            addCheck("SessionAddressesAllowed", blocked.isEmpty(), QJsonArray::fromStringList(blocked), QJsonArray());
+
+            if (!expectedScope.isEmpty()) {
+                QString expected = ScopeTool::normaliseScope(expectedScope);
+                addCheck("Scope", scope == expected, scope, expected);
+            }
+
+            if (showBudget >= 0) {
+                double showMs = sessionStats["MaxShowLatencyMs"].toDouble();
+                addCheck("ShowLatencyMs", showMs <= showBudget, showMs, showBudget);
+            }
+
+            if (applyBudget >= 0) {
+                addCheck("ApplyLatencyMs", applyMs <= applyBudget, applyMs, applyBudget);
+            }
+        }
+
+        sniffer.stopSniffing();
+    }
+
+    QDir::setCurrent(previousDirectory);
+
+    report["Metrics"] = Metrics::toJson();
+    report["Checks"] = checks;
+    report["Passed"] = passed;
+
+    return report;
+}
+
+QJsonObject ReplayHarness::soak(QString filename, int sessions)
+{
+    checks = QJsonArray();
+    passed = true;
+
+    QJsonObject report;
+    report["Version"] = REPLAY_FORMAT_VERSION;
+    report["Capture"] = filename;
+    report["Sessions"] = sessions;
+
+    QElapsedTimer soakTimer;
+    soakTimer.start();
+
+    ReplayResources baseline;
+    int failedReplays = 0;
+    int leakedSessions = 0;
+    int interruptedSessions = 0;
+    MetricHistogram stopHistogram;
+    QString blockingDevice;
+    int failedBlockingSessions = 0;
+    MetricHistogram blockingStopHistogram;
+
+    {
+        Sniffer sniffer;
+
+        for (int i = 0; i < REPLAY_SOAK_WARMUP_SESSIONS + sessions; i += 1) {
+            // Caches, thread pools and allocator arenas settle during the warm-up, the rest must not grow
+            if (i == REPLAY_SOAK_WARMUP_SESSIONS) {
+                baseline = getResources();
+            }
+
+            SessionDialog *sessionDialog = new SessionDialog(&sniffer, localAddresses);
+            sessionDialog->setLookupEnabled(false);
+
+            QEventLoop loop;
+            bool finished = false;
+            connect(&sniffer, &Sniffer::sniffFinished, &loop, [&]() {
+                finished = true;
+                loop.quit();
+            });
+            QTimer::singleShot(REPLAY_SOAK_SESSION_MS, &loop, &QEventLoop::quit);
+
+            if (sniffer.startReplay(filename, speed)) {
+                loop.exec();
+            } else {
+                failedReplays += 1;
+            }
+
+            sniffer.stopSniffing();
+            if (i >= REPLAY_SOAK_WARMUP_SESSIONS) {
+                stopHistogram.record(sniffer.getLastStopNs());
+                if (!finished) {
+                    interruptedSessions += 1;
+                }
+            }
+
+            delete sessionDialog;
+            QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+            // Teardown is deterministic, so nothing of the session may outlive it
+            ReplayResources resources = getResources();
+            if (resources.pcapHandles != 0 || resources.bpfPrograms != 0 || resources.snifferThreads != 0) {
+                leakedSessions += 1;
+            }
+        }
+
+        // Here the capture thread sits in pcap_next_ex, so the stop has to break a read that is waiting
+        blockingDevice = getIdleDevice(&sniffer);
+        for (int i = 0; !blockingDevice.isEmpty() && i < qMin(sessions, REPLAY_SOAK_BLOCKING_SESSIONS); i += 1) {
+            if (!sniffer.startSniffing(blockingDevice)) {
+                failedBlockingSessions += 1;
+                continue;
+            }
+
+            wait(REPLAY_SOAK_SESSION_MS);
+
+            sniffer.stopSniffing();
+            blockingStopHistogram.record(sniffer.getLastStopNs());
+
+            ReplayResources resources = getResources();
+            if (resources.pcapHandles != 0 || resources.bpfPrograms != 0 || resources.snifferThreads != 0) {
+                leakedSessions += 1;
+            }
+        }
+    }
+
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    ReplayResources remaining = getResources();
+
+    report["SoakMs"] = soakTimer.elapsed();
+    report["Baseline"] = toJson(baseline);
+    report["Final"] = toJson(remaining);
+    report["InterruptedSessions"] = interruptedSessions;
+
+    QJsonObject stopLatency;
+    stopLatency["P50Ms"] = stopHistogram.getQuantile(0.5) / 1000000.0;
+    stopLatency["P90Ms"] = stopHistogram.getQuantile(0.9) / 1000000.0;
+    stopLatency["P99Ms"] = stopHistogram.getQuantile(0.99) / 1000000.0;
+    stopLatency["MaxMs"] = stopHistogram.getMax() / 1000000.0;
+    report["StopLatency"] = stopLatency;
+
+    QJsonObject blockingStopLatency;
+    blockingStopLatency["Device"] = blockingDevice;
+    blockingStopLatency["Sessions"] = blockingStopHistogram.getCount();
+    if (blockingDevice.isEmpty()) {
+        // Opening a live adapter usually needs administrator rights or CAP_NET_RAW
+        blockingStopLatency["Skipped"] = "No capture device could be opened";
+    } else {
+        blockingStopLatency["P50Ms"] = blockingStopHistogram.getQuantile(0.5) / 1000000.0;
+        blockingStopLatency["P90Ms"] = blockingStopHistogram.getQuantile(0.9) / 1000000.0;
+        blockingStopLatency["P99Ms"] = blockingStopHistogram.getQuantile(0.99) / 1000000.0;
+        blockingStopLatency["MaxMs"] = blockingStopHistogram.getMax() / 1000000.0;
+    }
+    report["BlockingStopLatency"] = blockingStopLatency;
+
+    if (stopBudget >= 0) {
+        double stopMs = stopLatency["P99Ms"].toDouble();
+        addCheck("StopLatencyP99Ms", stopMs <= stopBudget, stopMs, stopBudget);
+
+        if (!blockingDevice.isEmpty()) {
+            double blockingStopMs = blockingStopLatency["P99Ms"].toDouble();
+            addCheck("BlockingStopLatencyP99Ms", blockingStopMs <= stopBudget, blockingStopMs, stopBudget);
+        }
+    }
+
+    if (!blockingDevice.isEmpty()) {
+        addCheck("SoakBlockingSessions", failedBlockingSessions == 0, failedBlockingSessions, 0);
+    }
+
+    addCheck("SoakReplays", failedReplays == 0, failedReplays, 0);
+    addCheck("SoakLeakedSessions", leakedSessions == 0, leakedSessions, 0);
+    addCheck("SoakPcapHandles", remaining.pcapHandles == 0, remaining.pcapHandles, 0);
+    addCheck("SoakBpfPrograms", remaining.bpfPrograms == 0, remaining.bpfPrograms, 0);
+    addCheck("SoakSnifferThreads", remaining.snifferThreads == 0, remaining.snifferThreads, 0);
+
+    if (baseline.threads >= 0) {
+        addCheck("SoakThreads", remaining.threads <= baseline.threads, remaining.threads, baseline.threads);
+    }
+
+    if (baseline.fileDescriptors >= 0) {
+        addCheck("SoakFileDescriptors", remaining.fileDescriptors <= baseline.fileDescriptors, remaining.fileDescriptors, baseline.fileDescriptors);
+    }
+
+    if (baseline.rssKb >= 0) {
+        qint64 growthKb = remaining.rssKb - baseline.rssKb;
+        addCheck("SoakRssGrowthKb", growthKb <= REPLAY_SOAK_RSS_SLACK_KB, growthKb, REPLAY_SOAK_RSS_SLACK_KB);
+    }
+
+    report["Checks"] = checks;
+    report["Passed"] = passed;
+
+    return report;
+}
+
+ReplayResources ReplayHarness::getResources()
+{
+    ReplayResources resources;
+    resources.pcapHandles = PcapHandle::getOpenCount();
+    resources.bpfPrograms = BpfProgram::getCompiledCount();
+    resources.snifferThreads = SnifferThread::getLiveCount();
+
+#ifdef Q_OS_LINUX
+    QFile status("/proc/self/status");
+    if (status.open(QIODevice::ReadOnly)) {
+        QList<QByteArray> lines = status.readAll().split('\n');
+        for (int i = 0; i < lines.count(); i += 1) {
+            QList<QByteArray> fields = lines[i].simplified().split(' ');
+            if (fields.count() < 2) {
+                continue;
+            }
+
+            if (fields[0] == "VmRSS:") {
+                resources.rssKb = fields[1].toLongLong();
+            } else if (fields[0] == "Threads:") {
+                resources.threads = fields[1].toInt();
+            }
+        }
+    }
+
+    resources.fileDescriptors = QDir("/proc/self/fd").entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot).count();
+#endif
+
+    return resources;
+}
+
+QJsonObject ReplayHarness::toJson(ReplayResources resources)
+{
+    QJsonObject object;
+    object["RssKb"] = resources.rssKb;
+    object["Threads"] = resources.threads;
+    object["FileDescriptors"] = resources.fileDescriptors;
+    object["PcapHandles"] = resources.pcapHandles;
+    object["BpfPrograms"] = resources.bpfPrograms;
+    object["SnifferThreads"] = resources.snifferThreads;
+
+    return object;
+}
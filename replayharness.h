@@ -0,0 +1,91 @@
+#include <QObject>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QStringList>
+
+#include "sniffer.h"
+
+#ifndef REPLAYHARNESS_H
+#define REPLAYHARNESS_H
+
+#define REPLAY_ARGUMENT "--replay"
+#define REPLAY_LOCAL_ARGUMENT "--replay-local"
+#define REPLAY_SPEED_ARGUMENT "--replay-speed"
+#define REPLAY_EXPECT_ARGUMENT "--replay-expect"
+#define REPLAY_SHOW_BUDGET_ARGUMENT "--replay-budget-show-ms"
+#define REPLAY_APPLY_BUDGET_ARGUMENT "--replay-budget-apply-ms"
+#define REPLAY_OUTPUT_ARGUMENT "--replay-output"
+#define REPLAY_SOAK_ARGUMENT "--replay-soak"
+#define REPLAY_STOP_BUDGET_ARGUMENT "--replay-budget-stop-ms"
+#define REPLAY_DEFAULT_LOCAL_ADDRESS "192.168.1.10"
+#define REPLAY_SETTLE_FRAMES 3
+#define REPLAY_FORMAT_VERSION 1
+#define REPLAY_SOAK_WARMUP_SESSIONS 50
+#define REPLAY_SOAK_RSS_SLACK_KB 4096
+#define REPLAY_SOAK_SESSION_MS 50
+#define REPLAY_SOAK_BLOCKING_SESSIONS 100
+
+/* Process resources sampled by the soak run, -1 where the platform does not say */
+struct ReplayResources
+{
+    qint64 rssKb = -1;
+    int threads = -1;
+    int fileDescriptors = -1;
+    int pcapHandles = 0;
+    int bpfPrograms = 0;
+    int snifferThreads = 0;
+};
+
+/*
+ * Feeds a capture through the whole pipeline, headless: Sniffer replay, the
+ * decoder, SessionDialog's tracker and view, then MainWindow's add and apply
+ * path against the in-memory firewall, in a scratch working directory. Checks
+ * the applied scope and the show and apply latencies against their budgets,
+ * and reports everything as JSON. The exit code is 1 if any check fails.
+ *
+ * The soak run instead replays the capture through one Sniffer and a fresh
+ * session view thousands of times, and checks that capture handles, filters,
+ * threads, file descriptors and memory stay flat once warmed up. Sessions
+ * still capturing after REPLAY_SOAK_SESSION_MS are stopped there, so with a
+ * paced replay every stop interrupts a running capture; the stop latency
+ * percentiles are reported and can be given a budget. A replay never waits in
+ * the read, so stopping is also timed on a live adapter that sees no game
+ * traffic (loopback first), where the capture thread is blocked in pcap.
+ */
+class ReplayHarness : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReplayHarness(QObject *parent = nullptr);
+    void setLocalAddresses(QStringList localAddresses);
+    void setSpeed(double speed);
+    void setExpectedScope(QString scope);
+    void setShowBudget(double msecs);
+    void setApplyBudget(double msecs);
+    void setStopBudget(double msecs);
+    QJsonObject run(QString filename);
+    QJsonObject soak(QString filename, int sessions);
+    bool isPassed();
+
+    static bool isRequested(int argc, char *argv[]);
+    static int main(QStringList arguments);
+
+private:
+    QStringList localAddresses;
+    double speed = 0;
+    QString expectedScope;
+    double showBudget = -1;
+    double applyBudget = -1;
+    double stopBudget = -1;
+    QJsonArray checks;
+    bool passed = true;
+
+    void addCheck(QString name, bool checkPassed, QJsonValue value, QJsonValue expected);
+    static void wait(int msecs);
+    static QString getIdleDevice(Sniffer *sniffer);
+    static ReplayResources getResources();
+    static QJsonObject toJson(ReplayResources resources);
+};
+
+#endif // REPLAYHARNESS_H
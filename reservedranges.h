@@ -0,0 +1,28 @@
+#ifndef RESERVEDRANGES_H
+#define RESERVEDRANGES_H
+
+/*
+ * IANA special-purpose and non-routable IPv4 blocks (RFC 6890 and friends).
+ * Kept free of Qt so tools/lobbygen can share the list with ScopeTool.
+ */
+static const char *const RESERVED_RANGES[] = {
+    "0.0.0.0/8",
+    "10.0.0.0/8",
+    "100.64.0.0/10",
+    "127.0.0.0/8",
+    "169.254.0.0/16",
+    "172.16.0.0/12",
+    "192.0.0.0/24",
+    "192.0.2.0/24",
+    "192.88.99.0/24",
+    "192.168.0.0/16",
+    "198.18.0.0/15",
+    "198.51.100.0/24",
+    "203.0.113.0/24",
+    "224.0.0.0/4",
+    "240.0.0.0/4"
+};
+
+#define RESERVED_RANGE_COUNT (sizeof(RESERVED_RANGES) / sizeof(RESERVED_RANGES[0]))
+
+#endif // RESERVEDRANGES_H
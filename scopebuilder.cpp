@@ -0,0 +1,57 @@
+#include "scopebuilder.h"
+
+ScopeBuilder::ScopeBuilder(QObject *parent) : QObject(parent)
+{
+
+}
+
+void ScopeBuilder::buildScope(QString name, QString key, QStringList addresses, QList<AddressRange> universe, QList<Address6Range> universe6)
+{
+    static MetricHistogram *buildHistogram = Metrics::histogram("profile_scope_build_seconds", "Time to build the scope of a profile in the background");
+
+    TraceSpan span("scope.buildProfile");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString scope = getScopeForAddresses(addresses, universe, universe6);
+    buildHistogram->record(timer.nsecsElapsed());
+
+    emit scopeBuilt(name, key, scope);
+}
+
+QString ScopeBuilder::getScopeForRanges(QList<AddressRange> allowedRanges, QList<Address6Range> allowedRanges6, QList<AddressRange> universe, QList<Address6Range> universe6)
+{
+    QList<AddressRange> blockRanges = ScopeTool::getBlockRangesForRanges(allowedRanges, universe);
+    QList<Address6Range> blockRanges6 = ScopeTool::getBlockRangesForRanges6(allowedRanges6, universe6);
+    if (blockRanges.isEmpty() && blockRanges6.isEmpty()) {
+        return QString(EMPTY_SCOPE);
+    }
+
+    QStringList parts;
+    if (!blockRanges.isEmpty()) {
+        parts.append(ScopeTool::formatRanges(blockRanges));
+    }
+    if (!blockRanges6.isEmpty()) {
+        parts.append(ScopeTool::formatRanges6(blockRanges6));
+    }
+
+    return parts.join(",");
+}
+
+QString ScopeBuilder::getScopeForAddresses(QStringList addresses, QList<AddressRange> universe, QList<Address6Range> universe6)
+{
+    QList<AddressRange> singleRanges;
+    QList<Address6Range> singleRanges6;
+    for (int i = 0; i < addresses.count(); i += 1) {
+        QHostAddress hostAddress = IPTool::getAnyQHostAddress(addresses[i]);
+        if (hostAddress.protocol() == QAbstractSocket::IPv4Protocol) {
+            singleRanges.append(AddressRange(hostAddress.toIPv4Address(), hostAddress.toIPv4Address()));
+        } else if (hostAddress.protocol() == QAbstractSocket::IPv6Protocol) {
+            Ipv6Address address = Ipv6Address::fromQHostAddress(hostAddress);
+            singleRanges6.append(Address6Range(address, address));
+        }
+    }
+
+    return getScopeForRanges(ScopeTool::mergeRanges(singleRanges), ScopeTool::mergeRanges6(singleRanges6), universe, universe6);
+}
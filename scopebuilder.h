@@ -0,0 +1,34 @@
+#include <QObject>
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include "scopetool.h"
+#include "metrics.h"
+#include "tracing.h"
+
+#ifndef SCOPEBUILDER_H
+#define SCOPEBUILDER_H
+
+#define EMPTY_SCOPE "0.0.0.0"
+
+/*
+ * Builds the scopes of profiles that are not being applied right now (for
+ * the profile scope cache), lives on its own thread. The universe is read from
+ * the settings by the caller and handed over with each request.
+ */
+class ScopeBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScopeBuilder(QObject *parent = nullptr);
+    void buildScope(QString name, QString key, QStringList addresses, QList<AddressRange> universe, QList<Address6Range> universe6);
+
+    static QString getScopeForRanges(QList<AddressRange> allowedRanges, QList<Address6Range> allowedRanges6, QList<AddressRange> universe, QList<Address6Range> universe6);
+    static QString getScopeForAddresses(QStringList addresses, QList<AddressRange> universe, QList<Address6Range> universe6);
+
+signals:
+    void scopeBuilt(QString name, QString key, QString scope);
+};
+
+#endif // SCOPEBUILDER_H
@@ -0,0 +1,404 @@
+#include "scopetool.h"
+
+#include <algorithm>
+
+/* Per address family helpers so the interval algorithms below can be shared */
+static inline quint32 minAddress(quint32) { return 0; }
+static inline quint32 maxAddress(quint32) { return 0xFFFFFFFFu; }
+static inline quint32 nextAddress(quint32 address) { return address + 1; }
+static inline quint32 previousAddress(quint32 address) { return address - 1; }
+static inline QString addressToString(quint32 address) { return IPTool::getQHostAddress(address).toString(); }
+
+static inline Ipv6Address minAddress(Ipv6Address) { return Ipv6Address::min(); }
+static inline Ipv6Address maxAddress(Ipv6Address) { return Ipv6Address::max(); }
+static inline Ipv6Address nextAddress(Ipv6Address address) { return address.next(); }
+static inline Ipv6Address previousAddress(Ipv6Address address) { return address.previous(); }
+static inline QString addressToString(Ipv6Address address) { return address.toString(); }
+
+ScopeTool::ScopeTool(QObject *parent) : QObject(parent)
+{
+
+}
+
+QList<AddressRange> ScopeTool::getReservedRanges()
+{
+    QStringList reserved;
+    for (size_t i = 0; i < RESERVED_RANGE_COUNT; i += 1) {
+        reserved.append(RESERVED_RANGES[i]);
+    }
+
+    return mergeRanges(parseRanges(reserved));
+}
+
+QList<Address6Range> ScopeTool::getReservedRanges6()
+{
+    // IANA special-purpose IPv6 blocks (RFC 6890), plus everything that is not global unicast
+    QStringList reserved;
+    reserved.append("::/128");
+    reserved.append("::1/128");
+    reserved.append("::ffff:0:0/96");
+    reserved.append("64:ff9b:1::/48");
+    reserved.append("100::/64");
+    reserved.append("2001:2::/48");
+    reserved.append("2001:10::/28");
+    reserved.append("2001:20::/28");
+    reserved.append("2001:db8::/32");
+    reserved.append("fc00::/7");
+    reserved.append("fe80::/10");
+    reserved.append("ff00::/8");
+
+    return mergeRanges6(parseRanges6(reserved));
+}
+
+bool ScopeTool::parseRange(QString text, AddressRange *range)
+{
+    text = text.trimmed();
+
+    if (text.contains('/')) {
+        QStringList parts = text.split('/');
+        QHostAddress hostAddress = IPTool::getQHostAddress(parts.value(0));
+        if (parts.count() != 2 || hostAddress.isNull()) {
+            return false;
+        }
+
+        // Accept both a prefix length and a dotted netmask, the Windows Firewall reports the latter
+        QString suffix = parts[1];
+        bool isPrefixLength = !suffix.isEmpty();
+        for (int i = 0; i < suffix.count() && isPrefixLength; i += 1) {
+            isPrefixLength = (suffix[i] >= '0' && suffix[i] <= '9');
+        }
+
+        quint32 mask;
+        if (isPrefixLength) {
+            bool ok = false;
+            int prefixLength = suffix.toInt(&ok);
+            if (!ok || prefixLength > 32) {
+                return false;
+            }
+
+            mask = (prefixLength == 0) ? 0 : (0xFFFFFFFFu << (32 - prefixLength));
+        } else {
+            QHostAddress maskHostAddress = IPTool::getQHostAddress(suffix);
+            if (maskHostAddress.isNull()) {
+                return false;
+            }
+
+            // The ones of a netmask have to be contiguous, 255.0.255.0 describes no range
+            mask = maskHostAddress.toIPv4Address();
+            if ((~mask & (~mask + 1)) != 0) {
+                return false;
+            }
+        }
+
+        quint32 network = hostAddress.toIPv4Address() & mask;
+        *range = AddressRange(network, network | ~mask);
+        return true;
+    }
+
+    QStringList parts = text.split('-');
+    if (parts.count() > 2) {
+        return false;
+    }
+
+    QHostAddress startHostAddress = IPTool::getQHostAddress(parts.first().trimmed());
+    QHostAddress endHostAddress = IPTool::getQHostAddress(parts.last().trimmed());
+    if (startHostAddress.isNull() || endHostAddress.isNull()) {
+        return false;
+    }
+
+    quint32 start = startHostAddress.toIPv4Address();
+    quint32 end = endHostAddress.toIPv4Address();
+    if (start > end) {
+        return false;
+    }
+
+    *range = AddressRange(start, end);
+    return true;
+}
+
+bool ScopeTool::parseRange6(QString text, Address6Range *range)
+{
+    text = text.trimmed();
+
+    if (text.contains('/')) {
+        QStringList parts = text.split('/');
+        QHostAddress hostAddress = IPTool::getIpv6QHostAddress(parts.value(0));
+        bool ok = false;
+        int prefixLength = parts.value(1).toInt(&ok);
+        if (parts.count() != 2 || hostAddress.isNull() || !ok || prefixLength < 0 || prefixLength > 128) {
+            return false;
+        }
+
+        Ipv6Address mask = Ipv6Address::mask(prefixLength);
+        Ipv6Address network = Ipv6Address::fromQHostAddress(hostAddress) & mask;
+        *range = Address6Range(network, network | ~mask);
+        return true;
+    }
+
+    QStringList parts = text.split('-');
+    if (parts.count() > 2) {
+        return false;
+    }
+
+    QHostAddress startHostAddress = IPTool::getIpv6QHostAddress(parts.first().trimmed());
+    QHostAddress endHostAddress = IPTool::getIpv6QHostAddress(parts.last().trimmed());
+    if (startHostAddress.isNull() || endHostAddress.isNull()) {
+        return false;
+    }
+
+    Ipv6Address start = Ipv6Address::fromQHostAddress(startHostAddress);
+    Ipv6Address end = Ipv6Address::fromQHostAddress(endHostAddress);
+    if (start > end) {
+        return false;
+    }
+
+    *range = Address6Range(start, end);
+    return true;
+}
+
+QList<AddressRange> ScopeTool::parseRanges(QStringList texts)
+{
+    QList<AddressRange> ranges;
+    for (int i = 0; i < texts.count(); i += 1) {
+        AddressRange range;
+        if (parseRange(texts[i], &range)) {
+            ranges.append(range);
+        }
+    }
+
+    return ranges;
+}
+
+QList<Address6Range> ScopeTool::parseRanges6(QStringList texts)
+{
+    QList<Address6Range> ranges;
+    for (int i = 0; i < texts.count(); i += 1) {
+        Address6Range range;
+        if (parseRange6(texts[i], &range)) {
+            ranges.append(range);
+        }
+    }
+
+    return ranges;
+}
+
+template <typename T>
+QList<QPair<T, T>> ScopeTool::mergeRangesT(QList<QPair<T, T>> ranges)
+{
+    std::sort(ranges.begin(), ranges.end());
+
+    QList<QPair<T, T>> merged;
+    for (int i = 0; i < ranges.count(); i += 1) {
+        QPair<T, T> range = ranges[i];
+
+        // Overlapping or adjacent ranges collapse into one
+        if (!merged.isEmpty() && (merged.last().second == maxAddress(T()) || range.first <= nextAddress(merged.last().second))) {
+            merged.last().second = qMax(merged.last().second, range.second);
+        } else {
+            merged.append(range);
+        }
+    }
+
+    return merged;
+}
+
+QList<AddressRange> ScopeTool::mergeRanges(QList<AddressRange> ranges)
+{
+    return mergeRangesT(ranges);
+}
+
+QList<Address6Range> ScopeTool::mergeRanges6(QList<Address6Range> ranges)
+{
+    return mergeRangesT(ranges);
+}
+
+template <typename T>
+QList<QPair<T, T>> ScopeTool::subtractRangesT(QPair<T, T> bounds, QList<QPair<T, T>> excluded)
+{
+    excluded = mergeRangesT(excluded);
+
+    QList<QPair<T, T>> ranges;
+    T next = bounds.first;
+    for (int i = 0; i < excluded.count(); i += 1) {
+        QPair<T, T> range = excluded[i];
+        if (range.second < next) {
+            continue;
+        }
+
+        if (range.first > bounds.second) {
+            break;
+        }
+
+        if (range.first > next) {
+            ranges.append(QPair<T, T>(next, previousAddress(range.first)));
+        }
+
+        if (range.second >= bounds.second) {
+            return ranges;
+        }
+
+        next = nextAddress(range.second);
+    }
+
+    ranges.append(QPair<T, T>(next, bounds.second));
+
+    return ranges;
+}
+
+QList<AddressRange> ScopeTool::subtractRanges(AddressRange bounds, QList<AddressRange> excluded)
+{
+    return subtractRangesT(bounds, excluded);
+}
+
+QList<Address6Range> ScopeTool::subtractRanges6(Address6Range bounds, QList<Address6Range> excluded)
+{
+    return subtractRangesT(bounds, excluded);
+}
+
+template <typename T>
+QList<QPair<T, T>> ScopeTool::getBlockRangesT(QList<QPair<T, T>> allowed, QList<QPair<T, T>> universe)
+{
+    // Every gap between two allowed ranges needs at most one block range. Addresses outside
+    // the universe are "don't care", so a gap that only covers them needs no range at all and
+    // the range that is emitted is trimmed to the first and last address that must be blocked.
+    QList<QPair<T, T>> blockRanges;
+    int u = 0;
+    for (int k = 0; k <= allowed.count() && u < universe.count(); k += 1) {
+        T gapStart = minAddress(T());
+        if (k > 0) {
+            if (allowed[k - 1].second == maxAddress(T())) {
+                break;
+            }
+
+            gapStart = nextAddress(allowed[k - 1].second);
+        }
+
+        T gapEnd = maxAddress(T());
+        if (k < allowed.count()) {
+            if (allowed[k].first == minAddress(T())) {
+                continue;
+            }
+
+            gapEnd = previousAddress(allowed[k].first);
+        }
+
+        if (gapStart > gapEnd) {
+            continue;
+        }
+
+        while (u < universe.count() && universe[u].second < gapStart) {
+            u += 1;
+        }
+
+        if (u == universe.count()) {
+            break;
+        }
+
+        T first = qMax(universe[u].first, gapStart);
+        if (first > gapEnd) {
+            continue;
+        }
+
+        int v = u;
+        while (v + 1 < universe.count() && universe[v + 1].first <= gapEnd) {
+            v += 1;
+        }
+
+        T last = qMin(universe[v].second, gapEnd);
+        blockRanges.append(QPair<T, T>(first, last));
+
+        u = v;
+    }
+
+    return blockRanges;
+}
+
+template <typename T>
+QList<QPair<T, T>> ScopeTool::toSingleRangesT(QList<T> addresses)
+{
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+
+    QList<QPair<T, T>> ranges;
+    ranges.reserve(addresses.count());
+    for (int i = 0; i < addresses.count(); i += 1) {
+        ranges.append(QPair<T, T>(addresses[i], addresses[i]));
+    }
+
+    return ranges;
+}
+
+QList<AddressRange> ScopeTool::getBlockRangesForRanges(QList<AddressRange> allowedRanges, QList<AddressRange> universe)
+{
+    // allowedRanges has to be sorted and free of overlaps, as returned by mergeRanges
+    return getBlockRangesT(allowedRanges, universe);
+}
+
+QList<Address6Range> ScopeTool::getBlockRangesForRanges6(QList<Address6Range> allowedRanges, QList<Address6Range> universe)
+{
+    return getBlockRangesT(allowedRanges, universe);
+}
+
+QList<AddressRange> ScopeTool::getBlockRanges(QList<quint32> allowed, QList<AddressRange> universe)
+{
+    return getBlockRangesT(toSingleRangesT(allowed), universe);
+}
+
+QList<Address6Range> ScopeTool::getBlockRanges6(QList<Ipv6Address> allowed, QList<Address6Range> universe)
+{
+    return getBlockRangesT(toSingleRangesT(allowed), universe);
+}
+
+template <typename T>
+QString ScopeTool::formatRangesT(QList<QPair<T, T>> ranges)
+{
+    QStringList texts;
+    for (int i = 0; i < ranges.count(); i += 1) {
+        QPair<T, T> range = ranges[i];
+        QString start = addressToString(range.first);
+        if (range.first == range.second) {
+            texts.append(start);
+        } else {
+            texts.append(QString("%1-%2").arg(start, addressToString(range.second)));
+        }
+    }
+
+    return texts.join(",");
+}
+
+QString ScopeTool::formatRanges(QList<AddressRange> ranges)
+{
+    return formatRangesT(ranges);
+}
+
+QString ScopeTool::formatRanges6(QList<Address6Range> ranges)
+{
+    return formatRangesT(ranges);
+}
+
+QString ScopeTool::normaliseScope(QString scope)
+{
+    QList<AddressRange> ranges;
+    QList<Address6Range> ranges6;
+
+    QStringList texts = scope.split(",", Qt::SkipEmptyParts);
+    for (int i = 0; i < texts.count(); i += 1) {
+        AddressRange range;
+        Address6Range range6;
+        if (parseRange(texts[i], &range)) {
+            ranges.append(range);
+        } else if (parseRange6(texts[i], &range6)) {
+            ranges6.append(range6);
+        }
+    }
+
+    QStringList parts;
+    if (!ranges.isEmpty()) {
+        parts.append(formatRanges(mergeRanges(ranges)));
+    }
+    if (!ranges6.isEmpty()) {
+        parts.append(formatRanges6(mergeRanges6(ranges6)));
+    }
+
+    return parts.join(",");
+}
@@ -0,0 +1,53 @@
+#include <QObject>
+#include <QList>
+#include <QPair>
+#include <QStringList>
+#include <QHostAddress>
+
+#include "iptool.h"
+#include "ipv6address.h"
+#include "reservedranges.h"
+
+#ifndef SCOPETOOL_H
+#define SCOPETOOL_H
+
+/* Inclusive ranges of addresses in host byte order */
+typedef QPair<quint32, quint32> AddressRange;
+typedef QPair<Ipv6Address, Ipv6Address> Address6Range;
+
+class ScopeTool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ScopeTool(QObject *parent = nullptr);
+    static QList<AddressRange> getReservedRanges();
+    static QList<Address6Range> getReservedRanges6();
+    static bool parseRange(QString text, AddressRange *range);
+    static bool parseRange6(QString text, Address6Range *range);
+    static QList<AddressRange> parseRanges(QStringList texts);
+    static QList<Address6Range> parseRanges6(QStringList texts);
+    static QList<AddressRange> mergeRanges(QList<AddressRange> ranges);
+    static QList<Address6Range> mergeRanges6(QList<Address6Range> ranges);
+    static QList<AddressRange> subtractRanges(AddressRange bounds, QList<AddressRange> excluded);
+    static QList<Address6Range> subtractRanges6(Address6Range bounds, QList<Address6Range> excluded);
+    static QList<AddressRange> getBlockRanges(QList<quint32> allowed, QList<AddressRange> universe);
+    static QList<Address6Range> getBlockRanges6(QList<Ipv6Address> allowed, QList<Address6Range> universe);
+    static QList<AddressRange> getBlockRangesForRanges(QList<AddressRange> allowedRanges, QList<AddressRange> universe);
+    static QList<Address6Range> getBlockRangesForRanges6(QList<Address6Range> allowedRanges, QList<Address6Range> universe);
+    static QString formatRanges(QList<AddressRange> ranges);
+    static QString formatRanges6(QList<Address6Range> ranges);
+    static QString normaliseScope(QString scope);
+
+private:
+    template <typename T> static QList<QPair<T, T>> mergeRangesT(QList<QPair<T, T>> ranges);
+    template <typename T> static QList<QPair<T, T>> subtractRangesT(QPair<T, T> bounds, QList<QPair<T, T>> excluded);
+    template <typename T> static QList<QPair<T, T>> toSingleRangesT(QList<T> addresses);
+    template <typename T> static QList<QPair<T, T>> getBlockRangesT(QList<QPair<T, T>> allowed, QList<QPair<T, T>> universe);
+    template <typename T> static QString formatRangesT(QList<QPair<T, T>> ranges);
+
+signals:
+
+};
+
+#endif // SCOPETOOL_H
@@ -21,6 +21,19 @@ SelectDeviceDialog::SelectDeviceDialog(Sniffer *sniffer, QWidget *parent) :
     deviceTableWidget->verticalHeader()->setVisible(false);
     deviceTableWidget->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
 
+    this->sniffer = sniffer;
+
+    loadDevices();
+
+    // The list follows adapters being plugged in or changing address while the dialog is open
+    connect(sniffer, &Sniffer::devicesChanged, this, &SelectDeviceDialog::loadDevices);
+}
+
+void SelectDeviceDialog::loadDevices()
+{
+    QString selectedDevice = getSelectedDevice();
+    deviceTableWidget->setRowCount(0);
+
     QStringList deviceNames = sniffer->getDeviceNames();
     for (int i = 0; i < deviceNames.count(); i += 1) {
         QString name = deviceNames[i];
@@ -53,6 +66,8 @@ SelectDeviceDialog::SelectDeviceDialog(Sniffer *sniffer, QWidget *parent) :
     }
 
     deviceTableWidget->resizeRowsToContents();
+
+    setSelectedDevice(selectedDevice);
 }
 
 SelectDeviceDialog::~SelectDeviceDialog()
@@ -70,3 +85,13 @@ QString SelectDeviceDialog::getSelectedDevice()
 
     return selectedItems.at(0)->text();
 }
+
+void SelectDeviceDialog::setSelectedDevice(QString name)
+{
+    for (int i = 0; i < deviceTableWidget->rowCount(); i += 1) {
+        if (deviceTableWidget->item(i, 0)->text() == name) {
+            deviceTableWidget->selectRow(i);
+            return;
+        }
+    }
+}
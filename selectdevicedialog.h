@@ -18,10 +18,14 @@ public:
     explicit SelectDeviceDialog(Sniffer *sniffer, QWidget *parent = nullptr);
     ~SelectDeviceDialog();
     QString getSelectedDevice();
+    void setSelectedDevice(QString name);
 
 private:
     Ui::SelectDeviceDialog *ui;
     QTableWidget *deviceTableWidget;
+    Sniffer *sniffer;
+
+    void loadDevices();
 };
 
 #endif // SELECTDEVICEDIALOG_H
@@ -1,7 +1,32 @@
 #include "sessiondialog.h"
 #include "ui_sessiondialog.h"
 
-SessionDialog::SessionDialog(Sniffer *sniffer, QString deviceName, QWidget *parent) :
+SessionDialog::SessionDialog(CaptureService *captureService, QString deviceName, QWidget *parent) :
+    SessionDialog(captureService->getSniffer(), captureService->getSniffer()->getDeviceAddresses(deviceName), parent)
+{
+    bool warm = captureService->isCapturing(deviceName);
+    if (!captureService->start(deviceName)) {
+        QMessageBox::critical(this, "Error", "Something went wrong.");
+        return;
+    }
+
+    // Held until the view closes, the adapter is only closed once it has gone unused for a while
+    this->captureService = captureService;
+
+    if (!warm) {
+        return;
+    }
+
+    // The adapter kept capturing since the last session, so the peers seen meanwhile show on the first frame
+    QVector<SessionEntry> sightings = captureService->getRecentSightings();
+    for (int i = 0; i < sightings.count(); i += 1) {
+        sessionTracker->recordSighting(sightings[i].address, sightings[i].lastSeen);
+    }
+
+    loaded = true;
+}
+
+SessionDialog::SessionDialog(Sniffer *sniffer, QStringList localAddresses, QWidget *parent) :
     QDialog(parent),
     ui(new Ui::SessionDialog)
 {
@@ -10,6 +35,7 @@ SessionDialog::SessionDialog(Sniffer *sniffer, QString deviceName, QWidget *pare
     addressTableWidget = ui->addressTableWidget;
     selectCountLabel = ui->selectCountLabel;
     foundCountLabel = ui->foundCountLabel;
+    searchLineEdit = ui->searchLineEdit;
 
     QStringList headerLabels;
     headerLabels.append("IP Address");
@@ -24,28 +50,37 @@ SessionDialog::SessionDialog(Sniffer *sniffer, QString deviceName, QWidget *pare
     foundCountLabel->setText("Loading...");
 
     this->sniffer = sniffer;
-    addresses = sniffer->getDeviceAddresses(deviceName);
 
-    updateTimer = new QTimer(this);
-    connect(updateTimer, &QTimer::timeout, this, &SessionDialog::updateAddressTable);
-    updateTimer->start(1000);
+    // The capture thread records sightings straight into the tracker; the table is redrawn from a snapshot at most once per frame
+    sessionTracker = new SessionTracker(REMOVE_THRESHOLD, this);
+    sniffer->addSightingSink(sessionTracker, localAddresses);
+
+    frameTimer = new QTimer(this);
+    frameTimer->setTimerType(Qt::PreciseTimer);
+    connect(frameTimer, &QTimer::timeout, this, &SessionDialog::onFrameTimeout);
+
+    int framesPerSecond = qEnvironmentVariableIntValue(SESSION_FRAME_RATE_ENV);
+    setFrameRate(framesPerSecond > 0 ? framesPerSecond : SESSION_FRAME_RATE);
 
     connect(sniffer, &Sniffer::sniffTimeout, this, [=]() {
-        setFoundCount();
+        loaded = true;
     });
-    connect(sniffer, &Sniffer::newSniffResult, this, &SessionDialog::onNewSniffResult);
-    if (!sniffer->startSniffing(deviceName)) {
-        QMessageBox::critical(this, "Error", "Something went wrong.");
-    }
 
     manager = new QNetworkAccessManager(this);
 
     connect(addressTableWidget, &QTableWidget::itemSelectionChanged, this, &SessionDialog::onAddressTableItemSelectionChanged);
+    connect(searchLineEdit, &QLineEdit::textChanged, this, &SessionDialog::onSearchTextChanged);
     connect(this, &QDialog::finished, this, &SessionDialog::onFinished);
 }
 
 SessionDialog::~SessionDialog()
 {
+    if (!sniffer.isNull()) {
+        sniffer->removeSightingSink(sessionTracker);
+    }
+
+    releaseCapture();
+
     delete ui;
 }
 
@@ -61,20 +96,127 @@ void SessionDialog::onAddressTableItemSelectionChanged()
     selectCountLabel->setText(QString("%1 selected").arg(count));
 }
 
+void SessionDialog::onSearchTextChanged(QString text)
+{
+    // A session only has a lobby's worth of rows, so they are matched one by one
+    searchQuery = AddressQuery::parse(text);
+
+    for (int i = 0; i < addressTableWidget->rowCount(); i += 1) {
+        addressTableWidget->setRowHidden(i, !searchQuery.matches(addressTableWidget->item(i, 0)->text()));
+    }
+}
+
 void SessionDialog::onFinished(int result)
 {
-    sniffer->stopSniffing();
+    // Whoever started the capture stops it, a warm adapter stays open for the next session
+    frameTimer->stop();
+
+    if (!sniffer.isNull()) {
+        sniffer->removeSightingSink(sessionTracker);
+    }
+
+    releaseCapture();
 }
 
-bool SessionDialog::isValidSource(QString address)
+void SessionDialog::releaseCapture()
 {
-    for (int i = 0; i < addresses.count(); i += 1) {
-        if (QString::compare(address, addresses[i], Qt::CaseSensitive) == 0) {
-            return true;
+    if (!captureService.isNull()) {
+        captureService->release();
+        captureService.clear();
+    }
+}
+
+void SessionDialog::setFrameRate(int framesPerSecond)
+{
+    frameTimer->start(1000 / qBound(1, framesPerSecond, 1000));
+    frameClock.start();
+}
+
+QMap<QString, QVariant> SessionDialog::getStats()
+{
+    QMap<QString, QVariant> stats;
+    stats["Sightings"] = sessionTracker->getSightingCount();
+    stats["Frames"] = frameCount;
+    stats["Renders"] = renderCount;
+    stats["DroppedFrames"] = droppedFrameCount;
+    stats["FrameIntervalMs"] = frameTimer->interval();
+    stats["LastRenderMs"] = lastRenderNs / 1000000.0;
+    stats["MaxRenderMs"] = maxRenderNs / 1000000.0;
+    stats["AverageRenderMs"] = (renderCount > 0) ? (totalRenderNs / 1000000.0 / renderCount) : 0.0;
+    stats["Shown"] = shownCount;
+    stats["MaxShowLatencyMs"] = maxShowLatencyNs / 1000000.0;
+    stats["AverageShowLatencyMs"] = (shownCount > 0) ? (totalShowLatencyNs / 1000000.0 / shownCount) : 0.0;
+
+    return stats;
+}
+
+void SessionDialog::onFrameTimeout()
+{
+    static MetricCounter *frameCounter = Metrics::counter("session_frames_total", "Session view frame ticks");
+    static MetricCounter *droppedFrameCounter = Metrics::counter("session_dropped_frames_total", "Session view frame ticks the event loop missed");
+    static MetricHistogram *renderHistogram = Metrics::histogram("session_render_seconds", "Time to patch the session table from a snapshot");
+
+    TraceSpan span("session.frame");
+
+    // Ticks the event loop was too busy to deliver are counted as dropped frames
+    qint64 interval = frameTimer->interval();
+    qint64 elapsed = frameClock.restart();
+    if (interval > 0 && elapsed >= 2 * interval) {
+        droppedFrameCount += elapsed / interval - 1;
+        droppedFrameCounter->add(elapsed / interval - 1);
+    }
+
+    frameCount += 1;
+    frameCounter->add();
+
+    SessionSnapshot snapshot = sessionTracker->takeSnapshot(QDateTime::currentSecsSinceEpoch());
+    if (snapshot.version == renderedVersion) {
+        setFoundCount();
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    renderSnapshot(snapshot);
+
+    lastRenderNs = timer.nsecsElapsed();
+    renderHistogram->record(lastRenderNs);
+    maxRenderNs = qMax(maxRenderNs, lastRenderNs);
+    totalRenderNs += lastRenderNs;
+    renderCount += 1;
+}
+
+void SessionDialog::renderSnapshot(const SessionSnapshot &snapshot)
+{
+    TraceSpan span("session.render");
+
+    // Rows and entries are sorted the same way, so the table is patched in one pass and painted once
+    addressTableWidget->setUpdatesEnabled(false);
+
+    QSet<QString> current;
+    for (int i = 0; i < snapshot.entries.count(); i += 1) {
+        current.insert(snapshot.entries[i].address);
+    }
+
+    for (int i = addressTableWidget->rowCount() - 1; i >= 0; i -= 1) {
+        if (!current.contains(addressTableWidget->item(i, 0)->text())) {
+            addressTableWidget->removeRow(i);
+        }
+    }
+
+    for (int i = 0; i < snapshot.entries.count(); i += 1) {
+        QTableWidgetItem *item = addressTableWidget->item(i, 0);
+        if (item == NULL || item->text() != snapshot.entries[i].address) {
+            addAddressToTable(i, snapshot.entries[i]);
         }
     }
 
-    return false;
+    addressTableWidget->setUpdatesEnabled(true);
+
+    renderedVersion = snapshot.version;
+    loaded = true;
+    setFoundCount();
 }
 
 QTableWidgetItem *SessionDialog::getAddressTableWidgetItem(QString address)
@@ -90,35 +232,49 @@ QTableWidgetItem *SessionDialog::getAddressTableWidgetItem(QString address)
     return NULL;
 }
 
-int SessionDialog::addAddressToTable(QString address)
+void SessionDialog::addAddressToTable(int row, const SessionEntry &entry)
 {
-    QHostAddress hostAddress = IPTool::getQHostAddress(address);
-    if (hostAddress.isNull()) {
-        return -1;
-    }
+    static MetricHistogram *showLatencyHistogram = Metrics::histogram("session_show_latency_seconds", "Time from a packet being decoded to its address being on screen");
+    static MetricCounter *lookupCounter = Metrics::counter("geo_lookups_total", "Country lookups requested");
+    static MetricCounter *lookupErrorCounter = Metrics::counter("geo_lookup_errors_total", "Country lookups that failed or returned no country");
+    static MetricHistogram *lookupHistogram = Metrics::histogram("geo_lookup_seconds", "Round trip of a country lookup");
 
-    int row = 0;
-    for (int i = 0; i < addressTableWidget->rowCount(); i += 1) {
-        QHostAddress hostAddress2 = QHostAddress(addressTableWidget->item(i, 0)->text());
-        if (!hostAddress2.isNull() && hostAddress.toIPv4Address() < hostAddress2.toIPv4Address()) {
-            break;
-        }
+    QString address = entry.address;
 
-        row += 1;
-    }
+    // From the packet being decoded to its address being on screen
+    qint64 latencyNs = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs() - entry.firstSeenNs;
+    showLatencyHistogram->record(latencyNs);
+    maxShowLatencyNs = qMax(maxShowLatencyNs, latencyNs);
+    totalShowLatencyNs += latencyNs;
+    shownCount += 1;
 
     QTableWidgetItem *item = new QTableWidgetItem(address);
     addressTableWidget->insertRow(row);
     addressTableWidget->setItem(row, 0, item);
+    addressTableWidget->setRowHidden(row, !searchQuery.matches(address));
+
+    if (!lookupEnabled) {
+        return;
+    }
 
     QString url = QString(IPLOOKUP_SERVER).replace("{address}", address);
     QNetworkRequest request(url);
     QNetworkReply *reply = manager->get(request);
+    lookupCounter->add();
+
+    QElapsedTimer lookupTimer;
+    lookupTimer.start();
+
     connect(reply, &QNetworkReply::finished, [=]() {
-        if (item == getAddressTableWidgetItem(address)) {
-            QJsonDocument jsonDocument = QJsonDocument::fromJson(reply->readAll());
-            QJsonObject jsonObject = jsonDocument.object();
+        lookupHistogram->record(lookupTimer.nsecsElapsed());
+
+        QJsonDocument jsonDocument = QJsonDocument::fromJson(reply->readAll());
+        QJsonObject jsonObject = jsonDocument.object();
+        if (reply->error() != QNetworkReply::NoError || !jsonObject.contains("geoplugin_countryName")) {
+            lookupErrorCounter->add();
+        }
 
+        if (item == getAddressTableWidgetItem(address)) {
             if (jsonObject.contains("geoplugin_countryName")) {
                 QTableWidgetItem *itemCountry = new QTableWidgetItem(jsonObject["geoplugin_countryName"].toString());
                 addressTableWidget->setItem(item->row(), 1, itemCountry);
@@ -128,67 +284,19 @@ int SessionDialog::addAddressToTable(QString address)
         reply->deleteLater();
     });
 
-    return row;
 }
 
-void SessionDialog::onNewSniffResult(QMap<QString, QVariant> result)
+void SessionDialog::setFoundCount()
 {
-    QString sourceAddresss = result["saddr"].toString();
-    if (!isValidSource(sourceAddresss)) {
-        return;
-    }
-
-    int sourcePort = result["sport"].toInt();
-    if (sourcePort != SNIFF_PORT) {
+    if (!loaded) {
         return;
     }
 
-    QString destinationAddress = result["daddr"].toString();
-
-    QTableWidgetItem *item = getAddressTableWidgetItem(destinationAddress);
-    if (item == NULL) {
-        int row = addAddressToTable(destinationAddress);
-        if (row != -1) {
-            item = addressTableWidget->item(row, 0);
-            setFoundCount();
-        }
-    }
-
-    item->setData(Qt::UserRole, QDateTime::currentSecsSinceEpoch());
-}
-
-void SessionDialog::updateAddressTable()
-{
-    int rowCount = addressTableWidget->rowCount();
-    if (rowCount == 0) {
-        return;
-    }
-
-    qint64 epochTimeNow = QDateTime::currentSecsSinceEpoch();
-
-    QList<QTableWidgetItem *> itemsToRemove;
-
-    for (int i = 0; i < rowCount; i += 1) {
-        QTableWidgetItem *item = addressTableWidget->item(i, 0);
-        if (epochTimeNow - item->data(Qt::UserRole).toLongLong() > REMOVE_THRESHOLD) {
-            itemsToRemove.append(item);
-        }
-    }
-
-    for (int i = 0; i < itemsToRemove.count(); i += 1) {
-        QTableWidgetItem *item = itemsToRemove[i];
-        addressTableWidget->removeRow(item->row());
-    }
-
-    setFoundCount();
-}
-
-void SessionDialog::setFoundCount()
-{
     int rowCount = addressTableWidget->rowCount();
     QString text = QString("%1 found").arg(rowCount);
-
-    foundCountLabel->setText(text);
+    if (foundCountLabel->text() != text) {
+        foundCountLabel->setText(text);
+    }
 }
 
 QStringList SessionDialog::getSelectedAddresses()
@@ -198,6 +306,10 @@ QStringList SessionDialog::getSelectedAddresses()
     for (int i = 0; i < selectedRanges.count(); i += 1) {
         QTableWidgetSelectionRange selectedRange = selectedRanges[i];
         for (int j = selectedRange.topRow(); j <= selectedRange.bottomRow(); j += 1) {
+            if (addressTableWidget->isRowHidden(j)) {
+                continue;
+            }
+
             QTableWidgetItem *item = addressTableWidget->item(j, 0);
             addresses.append(item->text());
         }
@@ -205,3 +317,18 @@ QStringList SessionDialog::getSelectedAddresses()
 
     return addresses;
 }
+
+QStringList SessionDialog::getAddresses()
+{
+    QStringList addresses;
+    for (int i = 0; i < addressTableWidget->rowCount(); i += 1) {
+        addresses.append(addressTableWidget->item(i, 0)->text());
+    }
+
+    return addresses;
+}
+
+void SessionDialog::setLookupEnabled(bool enabled)
+{
+    lookupEnabled = enabled;
+}
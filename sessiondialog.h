@@ -1,22 +1,32 @@
 #include <QDialog>
 #include <QTableWidget>
 #include <QLabel>
+#include <QLineEdit>
 #include <QDateTime>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QMessageBox>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QPointer>
 
 #include "sniffer.h"
+#include "captureservice.h"
 #include "customaddresslistwidget.h"
+#include "addressquery.h"
+#include "sessiontracker.h"
+#include "metrics.h"
+#include "tracing.h"
 
 #ifndef SESSIONDIALOG_H
 #define SESSIONDIALOG_H
 
 #define REMOVE_THRESHOLD 5
 #define IPLOOKUP_SERVER "http://www.geoplugin.net/json.gp?ip={address}"
+#define SESSION_FRAME_RATE 10
+#define SESSION_FRAME_RATE_ENV "GTA5ONLINE_WHITELIST_SESSION_FPS"
 
 class SessionDialogThread;
 
@@ -29,28 +39,50 @@ class SessionDialog : public QDialog
     Q_OBJECT
 
 public:
-    explicit SessionDialog(Sniffer *sniffer, QString deviceName, QWidget *parent = nullptr);
+    explicit SessionDialog(CaptureService *captureService, QString deviceName, QWidget *parent = nullptr);
+    SessionDialog(Sniffer *sniffer, QStringList localAddresses, QWidget *parent = nullptr);
     ~SessionDialog();
     QStringList getSelectedAddresses();
+    QStringList getAddresses();
+    void setLookupEnabled(bool enabled);
+    void setFrameRate(int framesPerSecond);
+    QMap<QString, QVariant> getStats();
 
 private:
     Ui::SessionDialog *ui;
     QTableWidget *addressTableWidget;
     QLabel *selectCountLabel;
     QLabel *foundCountLabel;
-    Sniffer *sniffer;
-    QStringList addresses;
-    QTimer *updateTimer;
+    QLineEdit *searchLineEdit;
+    AddressQuery searchQuery;
+    QPointer<Sniffer> sniffer;
+    QPointer<CaptureService> captureService;
     QNetworkAccessManager *manager;
+    SessionTracker *sessionTracker;
+    QTimer *frameTimer;
+    QElapsedTimer frameClock;
+    bool loaded = false;
+    bool lookupEnabled = true;
+    quint64 renderedVersion = 0;
+    qint64 frameCount = 0;
+    qint64 renderCount = 0;
+    qint64 droppedFrameCount = 0;
+    qint64 lastRenderNs = 0;
+    qint64 maxRenderNs = 0;
+    qint64 totalRenderNs = 0;
+    qint64 shownCount = 0;
+    qint64 maxShowLatencyNs = 0;
+    qint64 totalShowLatencyNs = 0;
 
     void onFinished(int result);
-    bool isValidSource(QString address);
+    void releaseCapture();
     QTableWidgetItem *getAddressTableWidgetItem(QString address);
-    void onNewSniffResult(QMap<QString, QVariant> result);
-    void updateAddressTable();
+    void onFrameTimeout();
+    void renderSnapshot(const SessionSnapshot &snapshot);
     void setFoundCount();
-    int addAddressToTable(QString address);
+    void addAddressToTable(int row, const SessionEntry &entry);
     void onAddressTableItemSelectionChanged();
+    void onSearchTextChanged(QString text);
 };
 
 #endif // SESSIONDIALOG_H
@@ -0,0 +1,96 @@
+#include "sessiontracker.h"
+
+#include <algorithm>
+
+SessionTracker::SessionTracker(qint64 expireSecs, QObject *parent) : QObject(parent)
+{
+    this->expireSecs = expireSecs;
+
+    sightingCounter = Metrics::counter("session_sightings_total", "Session address sightings recorded");
+    joinedCounter = Metrics::counter("session_peers_joined_total", "Addresses that joined the session");
+    leftCounter = Metrics::counter("session_peers_left_total", "Addresses that expired from the session");
+    peerGauge = Metrics::gauge("session_peers", "Addresses currently in the session");
+}
+
+bool SessionTracker::recordSighting(QString address, qint64 time, qint64 decodedNs)
+{
+    QMutexLocker locker(&mutex);
+
+    sightingCount += 1;
+    sightingCounter->add();
+
+    QHash<QString, SessionEntry>::iterator it = entries.find(address);
+    if (it != entries.end()) {
+        it.value().lastSeen = time;
+        return true;
+    }
+
+    QHostAddress hostAddress = IPTool::getAnyQHostAddress(address);
+    if (hostAddress.isNull()) {
+        return false;
+    }
+
+    SessionEntry entry;
+    entry.address = address;
+    entry.hostAddress = hostAddress;
+    entry.lastSeen = time;
+    entry.firstSeenNs = (decodedNs > 0) ? decodedNs : QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+    entries.insert(address, entry);
+    changed = true;
+    joinedCounter->add();
+
+    return true;
+}
+
+SessionSnapshot SessionTracker::takeSnapshot(qint64 now)
+{
+    QMutexLocker locker(&mutex);
+
+    QHash<QString, SessionEntry>::iterator it = entries.begin();
+    while (it != entries.end()) {
+        if (now - it.value().lastSeen > expireSecs) {
+            it = entries.erase(it);
+            changed = true;
+            leftCounter->add();
+        } else {
+            ++it;
+        }
+    }
+
+    peerGauge->set(entries.count());
+
+    if (!changed) {
+        return snapshot;
+    }
+
+    QVector<SessionEntry> sorted;
+    sorted.reserve(entries.count());
+    for (it = entries.begin(); it != entries.end(); ++it) {
+        sorted.append(it.value());
+    }
+
+    std::sort(sorted.begin(), sorted.end(), [](const SessionEntry &entry1, const SessionEntry &entry2) {
+        return IPTool::lessThan(entry1.hostAddress, entry2.hostAddress);
+    });
+
+    snapshot.version += 1;
+    snapshot.entries = sorted;
+    changed = false;
+
+    return snapshot;
+}
+
+qint64 SessionTracker::getSightingCount()
+{
+    QMutexLocker locker(&mutex);
+
+    return sightingCount;
+}
+
+void SessionTracker::clear()
+{
+    QMutexLocker locker(&mutex);
+
+    changed = !entries.isEmpty();
+    entries.clear();
+}
@@ -0,0 +1,59 @@
+#include <QObject>
+#include <QHash>
+#include <QVector>
+#include <QMutex>
+#include <QHostAddress>
+#include <QDeadlineTimer>
+
+#include "iptool.h"
+#include "metrics.h"
+
+#ifndef SESSIONTRACKER_H
+#define SESSIONTRACKER_H
+
+struct SessionEntry
+{
+    QString address;
+    QHostAddress hostAddress;
+    qint64 lastSeen;
+    qint64 firstSeenNs;
+};
+
+/* Sorted addresses of the session at one instant. Copies share the entries and are never modified */
+struct SessionSnapshot
+{
+    quint64 version = 0;
+    QVector<SessionEntry> entries;
+};
+
+/*
+ * Collects sightings of session addresses between frames. Recording a sighting
+ * only updates a hash, whichever thread it comes from; the sorted snapshot the
+ * view renders is rebuilt only when an address joins or leaves.
+ */
+class SessionTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionTracker(qint64 expireSecs, QObject *parent = nullptr);
+    bool recordSighting(QString address, qint64 time, qint64 decodedNs = 0);
+    SessionSnapshot takeSnapshot(qint64 now);
+    qint64 getSightingCount();
+    void clear();
+
+private:
+    QMutex mutex;
+    qint64 expireSecs;
+    QHash<QString, SessionEntry> entries;
+    bool changed = false;
+    qint64 sightingCount = 0;
+    SessionSnapshot snapshot;
+
+    MetricCounter *sightingCounter;
+    MetricCounter *joinedCounter;
+    MetricCounter *leftCounter;
+    MetricGauge *peerGauge;
+};
+
+#endif // SESSIONTRACKER_H
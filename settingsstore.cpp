@@ -0,0 +1,328 @@
+#include "settingsstore.h"
+
+SettingsStore::SettingsStore(QString filename, QObject *parent) : QObject(parent)
+{
+    this->filename = filename;
+
+    load();
+    int replayedEntries = replayJournal();
+
+    writer = new SettingsWriter(filename, filename + SETTINGS_JOURNAL_SUFFIX);
+    writerThread = new QThread(this);
+    writerThread->setObjectName("Settings writer");
+    writer->moveToThread(writerThread);
+    connect(writer, &SettingsWriter::writeFailed, this, &SettingsStore::onWriteFailed);
+    connect(writer, &SettingsWriter::whitelistWritten, this, &SettingsStore::onWhitelistWritten);
+    writerThread->start();
+
+    debounceTimer = new QTimer(this);
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(SETTINGS_DEBOUNCE_MS);
+    connect(debounceTimer, &QTimer::timeout, this, [this]() { flush(); });
+
+    // Fold a journal left by the last run into a fresh snapshot
+    if (replayedEntries > 0) {
+        snapshotPending = true;
+        flush();
+    }
+}
+
+SettingsStore::~SettingsStore()
+{
+    flush(true);
+
+    writerThread->quit();
+    writerThread->wait();
+    delete writer;
+}
+
+void SettingsStore::load()
+{
+    QFile loadFile(filename);
+    if (!loadFile.exists()) {
+        return;
+    }
+
+    if (!loadFile.open(QIODevice::ReadOnly)) {
+        error = QString("Unable to read file\n%1").arg(filename);
+        return;
+    }
+
+    settings = QJsonDocument::fromJson(loadFile.readAll()).object();
+    sequence = settings.take(SETTINGS_SEQUENCE_KEY).toVariant().toLongLong();
+}
+
+int SettingsStore::replayJournal()
+{
+    static MetricCounter *badEntryCounter = Metrics::counter("settings_journal_bad_entries_total", "Settings journal lines that could not be read back");
+    static MetricCounter *replayCounter = Metrics::counter("settings_journal_replayed_entries_total", "Settings journal entries applied at startup");
+    static MetricCounter *skipCounter = Metrics::counter("settings_journal_skipped_entries_total", "Settings journal entries already held by the snapshot");
+
+    QFile journalFile(filename + SETTINGS_JOURNAL_SUFFIX);
+    if (!journalFile.exists() || !journalFile.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    qint64 snapshotSequence = sequence;
+    int count = 0;
+    QList<QByteArray> lines = journalFile.readAll().split('\n');
+    for (int i = 0; i < lines.count(); i += 1) {
+        if (lines[i].isEmpty()) {
+            continue;
+        }
+
+        // A crash mid-append leaves a torn last line, which is dropped
+        QJsonParseError parseError;
+        QJsonDocument entry = QJsonDocument::fromJson(lines[i], &parseError);
+        if (parseError.error != QJsonParseError::NoError || !entry.isObject()) {
+            badEntryCounter->add();
+            continue;
+        }
+
+        // Add and Remove do not commute, so an edit the snapshot already holds must not be applied again
+        qint64 entrySequence = entry.object()["Seq"].toVariant().toLongLong();
+        if (entry.object().contains("Seq") && entrySequence <= snapshotSequence) {
+            skipCounter->add();
+            continue;
+        }
+
+        applyEntry(&settings, entry.object());
+        sequence = qMax(sequence, entrySequence);
+        count += 1;
+    }
+
+    journalEntries = count;
+    replayCounter->add(count);
+
+    return count;
+}
+
+bool SettingsStore::applyEntry(QJsonObject *settings, QJsonObject entry)
+{
+    // Returns false for an edit that changes nothing, which is then not journalled
+    QString op = entry["Op"].toString();
+    QString key = entry["Key"].toString();
+    QJsonValue value = entry["Value"];
+
+    if (op == "Set") {
+        if (settings->value(key) == value) {
+            return false;
+        }
+
+        settings->insert(key, value);
+        return true;
+    }
+
+    // Add and Remove are single edits from older journals, a batch of edits is one AddMany or RemoveMany
+    if (op == "Add" || op == "AddMany") {
+        return addValues(settings, key, (op == "Add") ? QJsonArray({ value }) : value.toArray());
+    }
+
+    if (op == "Remove" || op == "RemoveMany") {
+        return removeValues(settings, key, (op == "Remove") ? QJsonArray({ value }) : value.toArray());
+    }
+
+    return false;
+}
+
+bool SettingsStore::addValues(QJsonObject *settings, QString key, QJsonArray values)
+{
+    // Membership of strings is a hash lookup, so a batch costs one pass over the array
+    QJsonArray array = settings->value(key).toArray();
+    QSet<QString> present;
+    for (int i = 0; i < array.count(); i += 1) {
+        if (array[i].isString()) {
+            present.insert(array[i].toString());
+        }
+    }
+
+    bool added = false;
+    for (int i = 0; i < values.count(); i += 1) {
+        QJsonValue value = values[i];
+        if (value.isString() ? present.contains(value.toString()) : array.contains(value)) {
+            continue;
+        }
+
+        if (value.isString()) {
+            present.insert(value.toString());
+        }
+        array.append(value);
+        added = true;
+    }
+
+    if (added) {
+        settings->insert(key, array);
+    }
+
+    return added;
+}
+
+bool SettingsStore::removeValues(QJsonObject *settings, QString key, QJsonArray values)
+{
+    QSet<QString> removedStrings;
+    QJsonArray removedOthers;
+    for (int i = 0; i < values.count(); i += 1) {
+        if (values[i].isString()) {
+            removedStrings.insert(values[i].toString());
+        } else {
+            removedOthers.append(values[i]);
+        }
+    }
+
+    // The array is rebuilt once rather than shifted for every removed value
+    QJsonArray array = settings->value(key).toArray();
+    QJsonArray kept;
+    for (int i = 0; i < array.count(); i += 1) {
+        QJsonValue value = array[i];
+        if (value.isString() ? !removedStrings.contains(value.toString()) : !removedOthers.contains(value)) {
+            kept.append(value);
+        }
+    }
+
+    if (kept.count() == array.count()) {
+        return false;
+    }
+
+    settings->insert(key, kept);
+    return true;
+}
+
+QJsonObject SettingsStore::getSettings()
+{
+    return settings;
+}
+
+QJsonValue SettingsStore::getValue(QString key)
+{
+    return settings.value(key);
+}
+
+void SettingsStore::setValue(QString key, QJsonValue value)
+{
+    QJsonObject entry;
+    entry["Op"] = "Set";
+    entry["Key"] = key;
+    entry["Value"] = value;
+    record(entry);
+}
+
+void SettingsStore::addToArray(QString key, QJsonArray values)
+{
+    if (values.isEmpty()) {
+        return;
+    }
+
+    QJsonObject entry;
+    entry["Op"] = "AddMany";
+    entry["Key"] = key;
+    entry["Value"] = values;
+    record(entry);
+}
+
+void SettingsStore::removeFromArray(QString key, QJsonArray values)
+{
+    if (values.isEmpty()) {
+        return;
+    }
+
+    QJsonObject entry;
+    entry["Op"] = "RemoveMany";
+    entry["Key"] = key;
+    entry["Value"] = values;
+    record(entry);
+}
+
+void SettingsStore::record(QJsonObject entry)
+{
+    if (!applyEntry(&settings, entry)) {
+        return;
+    }
+
+    sequence += 1;
+    entry["Seq"] = sequence;
+    pendingEntries.append(entry);
+    debounceTimer->start();
+}
+
+void SettingsStore::writeWhitelist(QString whitelistFilename, QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6)
+{
+    // The vectors are shared with the list until it changes, and only the latest one is written
+    this->whitelistFilename = whitelistFilename;
+    whitelistAddresses = addresses;
+    whitelistAddresses6 = addresses6;
+    whitelistPending = true;
+    debounceTimer->start();
+}
+
+bool SettingsStore::isWhitelistWritePending()
+{
+    return whitelistPending || whitelistWritesInFlight > 0;
+}
+
+void SettingsStore::flush(bool wait)
+{
+    debounceTimer->stop();
+
+    Qt::ConnectionType connectionType = wait ? Qt::BlockingQueuedConnection : Qt::QueuedConnection;
+
+    if (whitelistPending) {
+        SettingsWriter *writer = this->writer;
+        QString filename = whitelistFilename;
+        QVector<Ipv4Address> addresses = whitelistAddresses;
+        QVector<Ipv6Address> addresses6 = whitelistAddresses6;
+        QMetaObject::invokeMethod(writer, [writer, filename, addresses, addresses6]() { writer->writeWhitelist(filename, addresses, addresses6); }, connectionType);
+
+        whitelistAddresses = QVector<Ipv4Address>();
+        whitelistAddresses6 = QVector<Ipv6Address>();
+        whitelistPending = false;
+        whitelistWritesInFlight += 1;
+    }
+
+    if (pendingEntries.isEmpty() && !snapshotPending) {
+        return;
+    }
+
+    if (snapshotPending || journalEntries + pendingEntries.count() > SETTINGS_JOURNAL_MAX_ENTRIES) {
+        QJsonObject snapshot = settings;
+        snapshot[SETTINGS_SEQUENCE_KEY] = sequence;
+        QMetaObject::invokeMethod(writer, "writeSnapshot", connectionType, Q_ARG(QJsonObject, snapshot));
+        journalEntries = 0;
+        snapshotPending = false;
+    } else {
+        QMetaObject::invokeMethod(writer, "appendJournal", connectionType, Q_ARG(QJsonArray, pendingEntries));
+        journalEntries += pendingEntries.count();
+    }
+
+    pendingEntries = QJsonArray();
+}
+
+void SettingsStore::onWriteFailed(QString error)
+{
+    // Lost journal appends are recovered by rewriting the whole file on the next flush
+    this->error = error;
+    snapshotPending = true;
+
+    emit writeFailed(error);
+}
+
+void SettingsStore::onWhitelistWritten(bool success, QString error)
+{
+    whitelistWritesInFlight -= 1;
+
+    if (!success) {
+        this->error = error;
+        emit writeFailed(error);
+    }
+
+    emit whitelistWritten(success);
+}
+
+bool SettingsStore::hasError()
+{
+    return !error.isEmpty();
+}
+
+QString SettingsStore::getError()
+{
+    return error;
+}
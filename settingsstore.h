@@ -0,0 +1,81 @@
+#include <QObject>
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+#include <QThread>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSet>
+
+#include "settingswriter.h"
+
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#define SETTINGS_JOURNAL_SUFFIX ".journal"
+#define SETTINGS_DEBOUNCE_MS 500
+#define SETTINGS_JOURNAL_MAX_ENTRIES 256
+#define SETTINGS_SEQUENCE_KEY "JournalSequence"
+
+/*
+ * In-memory copy of the settings file with write-behind persistence. Edits are
+ * applied at once and flushed after SETTINGS_DEBOUNCE_MS of quiet. A flush
+ * appends the edits to a journal, and the whole file is only rewritten
+ * (atomically, from a background thread) when the journal gets long. Every
+ * edit carries a sequence number and the snapshot stores the last one it
+ * holds, so replay skips edits that are already in the snapshot. A batch of
+ * array edits is one journal line. The binary whitelist goes through the same
+ * debounce and writer thread.
+ */
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    SettingsStore(QString filename, QObject *parent = nullptr);
+    ~SettingsStore();
+
+    QJsonObject getSettings();
+    QJsonValue getValue(QString key);
+    void setValue(QString key, QJsonValue value);
+    void addToArray(QString key, QJsonArray values);
+    void removeFromArray(QString key, QJsonArray values);
+    void writeWhitelist(QString whitelistFilename, QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6);
+    bool isWhitelistWritePending();
+    void flush(bool wait = false);
+    bool hasError();
+    QString getError();
+
+private:
+    QString filename;
+    QJsonObject settings;
+    QJsonArray pendingEntries;
+    int journalEntries = 0;
+    qint64 sequence = 0;
+    bool snapshotPending = false;
+    QString whitelistFilename;
+    QVector<Ipv4Address> whitelistAddresses;
+    QVector<Ipv6Address> whitelistAddresses6;
+    bool whitelistPending = false;
+    int whitelistWritesInFlight = 0;
+    QString error;
+    QTimer *debounceTimer;
+    QThread *writerThread;
+    SettingsWriter *writer;
+
+    void load();
+    int replayJournal();
+    static bool applyEntry(QJsonObject *settings, QJsonObject entry);
+    static bool addValues(QJsonObject *settings, QString key, QJsonArray values);
+    static bool removeValues(QJsonObject *settings, QString key, QJsonArray values);
+    void record(QJsonObject entry);
+    void onWriteFailed(QString error);
+    void onWhitelistWritten(bool success, QString error);
+
+signals:
+    void writeFailed(QString error);
+    void whitelistWritten(bool success);
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,96 @@
+#include "settingswriter.h"
+
+SettingsWriter::SettingsWriter(QString filename, QString journalFilename, QObject *parent) : QObject(parent)
+{
+    this->filename = filename;
+    this->journalFilename = journalFilename;
+}
+
+void SettingsWriter::writeSnapshot(QJsonObject settings)
+{
+    static MetricCounter *failureCounter = Metrics::counter("settings_write_failures_total", "Settings snapshot and journal writes that failed");
+    static MetricHistogram *snapshotHistogram = Metrics::histogram("settings_snapshot_write_seconds", "Time to write the settings snapshot");
+
+    TraceSpan span("settings.writeSnapshot");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // QSaveFile writes to a temporary file and renames it over the old one on commit
+    QSaveFile saveFile(filename);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        failureCounter->add();
+        emit writeFailed(QString("Unable to write to file\n%1").arg(filename));
+        return;
+    }
+
+    saveFile.write(QJsonDocument(settings).toJson());
+    if (!saveFile.commit()) {
+        failureCounter->add();
+        emit writeFailed(QString("Unable to write to file\n%1\n\n%2").arg(filename).arg(saveFile.errorString()));
+        return;
+    }
+
+    snapshotHistogram->record(timer.nsecsElapsed());
+
+    // The snapshot now holds every journalled edit. If this fails, replay skips them by sequence number.
+    QFile journalFile(journalFilename);
+    if (journalFile.exists() && !journalFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        failureCounter->add();
+    }
+}
+
+void SettingsWriter::appendJournal(QJsonArray entries)
+{
+    static MetricCounter *failureCounter = Metrics::counter("settings_write_failures_total", "Settings snapshot and journal writes that failed");
+    static MetricCounter *entryCounter = Metrics::counter("settings_journal_entries_total", "Edits appended to the settings journal");
+    static MetricHistogram *journalHistogram = Metrics::histogram("settings_journal_append_seconds", "Time to append a batch to the settings journal");
+
+    TraceSpan span("settings.appendJournal");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile journalFile(journalFilename);
+    if (!journalFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        failureCounter->add();
+        emit writeFailed(QString("Unable to write to file\n%1").arg(journalFilename));
+        return;
+    }
+
+    QByteArray data;
+    for (int i = 0; i < entries.count(); i += 1) {
+        data.append(QJsonDocument(entries[i].toObject()).toJson(QJsonDocument::Compact));
+        data.append('\n');
+    }
+
+    if (journalFile.write(data) != data.size() || !journalFile.flush()) {
+        failureCounter->add();
+        emit writeFailed(QString("Unable to write to file\n%1").arg(journalFilename));
+        return;
+    }
+
+    entryCounter->add(entries.count());
+    journalHistogram->record(timer.nsecsElapsed());
+}
+
+void SettingsWriter::writeWhitelist(QString whitelistFilename, QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6)
+{
+    static MetricCounter *failureCounter = Metrics::counter("settings_write_failures_total", "Settings snapshot and journal writes that failed");
+    static MetricHistogram *whitelistHistogram = Metrics::histogram("whitelist_write_seconds", "Time to merge the list into ranges and write whitelist.bin");
+
+    TraceSpan span("whitelist.write");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QString error;
+    if (!WhitelistFile::write(whitelistFilename, addresses, addresses6, &error)) {
+        failureCounter->add();
+        emit whitelistWritten(false, error);
+        return;
+    }
+
+    whitelistHistogram->record(timer.nsecsElapsed());
+    emit whitelistWritten(true, QString());
+}
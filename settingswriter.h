@@ -0,0 +1,39 @@
+#include <QObject>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+
+#include "metrics.h"
+#include "tracing.h"
+#include "whitelistfile.h"
+
+#ifndef SETTINGSWRITER_H
+#define SETTINGSWRITER_H
+
+/* Does the file work for SettingsStore, lives on its own thread */
+class SettingsWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    SettingsWriter(QString filename, QString journalFilename, QObject *parent = nullptr);
+
+public slots:
+    void writeSnapshot(QJsonObject settings);
+    void appendJournal(QJsonArray entries);
+    void writeWhitelist(QString whitelistFilename, QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6);
+
+private:
+    QString filename;
+    QString journalFilename;
+
+signals:
+    void writeFailed(QString error);
+    void whitelistWritten(bool success, QString error);
+};
+
+#endif // SETTINGSWRITER_H
@@ -1,5 +1,7 @@
 #include "sniffer.h"
 
+#include <utility>
+
 Sniffer::Sniffer(QObject *parent) : QObject(parent)
 {
     if (LoadNpcapDlls()) {
@@ -7,18 +9,21 @@ Sniffer::Sniffer(QObject *parent) : QObject(parent)
     }
 
     loadDevices();
-
-    connect(this, &QObject::destroyed, this, &Sniffer::onDestroyed);
 }
 
-void Sniffer::onDestroyed()
+Sniffer::~Sniffer()
 {
-    freeDevices();
-    qDebug() << "Sniffer Destroyed";
+    stopSniffing();
+
+    if (deviceThread != nullptr) {
+        deviceThread->quit();
+        deviceThread->wait();
+    }
 }
 
-BOOL Sniffer::LoadNpcapDlls()
+bool Sniffer::LoadNpcapDlls()
 {
+#ifdef Q_OS_WIN
     _TCHAR npcap_dir[512];
     UINT len;
     len = GetSystemDirectory(npcap_dir, 480);
@@ -32,29 +37,9 @@ BOOL Sniffer::LoadNpcapDlls()
         qDebug() << "Error in SetDllDirectory: %x" << GetLastError();
         return FALSE;
     }
+#endif
 
-    return TRUE;
-}
-
-char *Sniffer::iptos(u_long in)
-{
-    static char output[IPTOSBUFFERS][3*4+3+1];
-    static short which;
-    u_char *p;
-
-    p = (u_char *)&in;
-    which = (which + 1 == IPTOSBUFFERS ? 0 : which + 1);
-    sprintf(output[which], "%d.%d.%d.%d", p[0], p[1], p[2], p[3]);
-    return output[which];
-}
-
-void Sniffer::freeDevices()
-{
-    if (devices != NULL) {
-        pcap_freealldevs(devices);
-    }
-
-    devices = NULL;
+    return true;
 }
 
 bool Sniffer::isDllLoaded()
@@ -64,53 +49,83 @@ bool Sniffer::isDllLoaded()
 
 bool Sniffer::loadDevices()
 {
-    freeDevices();
+    setDevices(QVector<CaptureDevice>());
 
     if (!dllLoaded) {
         return false;
     }
 
-    char errbuf[PCAP_ERRBUF_SIZE];
-
-    if (pcap_findalldevs_ex(PCAP_SRC_IF_STRING, NULL, &devices, errbuf) == -1)
-    {
-        qDebug() << "Error in pcap_findalldevs: " << QString(errbuf);
+    QVector<CaptureDevice> devices;
+    if (!DeviceLister::listDevices(&devices)) {
         return false;
     }
 
+    setDevices(devices);
+
     return true;
 }
 
-QStringList Sniffer::getDeviceNames()
+void Sniffer::setDevices(QVector<CaptureDevice> devices)
 {
-    if (devices == NULL) {
-        return QStringList();
+    // Lookups are hash hits
+    this->devices = devices;
+    deviceIndexes.clear();
+    for (int i = 0; i < devices.count(); i += 1) {
+        deviceIndexes.insert(devices[i].name, i);
     }
+}
 
-    QStringList deviceNames;
-    for (pcap_if_t *d = devices; d != NULL; d = d->next) {
-        deviceNames.append(QString(d->name));
+void Sniffer::refreshDevices()
+{
+    if (!dllLoaded) {
+        return;
     }
 
-    return deviceNames;
+    // Npcap is asked on a thread of its own, the first refresh starts it
+    if (deviceThread == nullptr) {
+        deviceLister = new DeviceLister();
+        deviceThread = new QThread(this);
+        deviceThread->setObjectName("Device lister");
+        deviceLister->moveToThread(deviceThread);
+        connect(deviceLister, &DeviceLister::devicesListed, this, &Sniffer::onDevicesListed);
+        connect(deviceThread, &QThread::finished, deviceLister, &QObject::deleteLater);
+        deviceThread->start();
+    }
+
+    deviceGeneration += 1;
+    quint64 generation = deviceGeneration;
+
+    DeviceLister *deviceLister = this->deviceLister;
+    QMetaObject::invokeMethod(deviceLister, [deviceLister, generation]() {
+        deviceLister->refreshDevices(generation);
+    }, Qt::QueuedConnection);
 }
 
-int Sniffer::getDeviceIndex(QString name)
+void Sniffer::onDevicesListed(quint64 generation, bool success, QVector<CaptureDevice> devices)
 {
-    if (devices == NULL) {
-        return -1;
+    // Only the latest refresh is applied, an older list may miss a change that came after it
+    if (generation != deviceGeneration || !success || devices == this->devices) {
+        return;
     }
 
-    int i = 0;
-    for (pcap_if_t *d = devices; d != NULL; d = d->next) {
-        if (QString::compare(QString(d->name), name, Qt::CaseSensitive) == 0) {
-            return i;
-        }
+    setDevices(devices);
 
-        i += 1;
+    emit devicesChanged();
+}
+
+QStringList Sniffer::getDeviceNames()
+{
+    QStringList deviceNames;
+    for (int i = 0; i < devices.count(); i += 1) {
+        deviceNames.append(devices[i].name);
     }
 
-    return -1;
+    return deviceNames;
+}
+
+int Sniffer::getDeviceIndex(QString name)
+{
+    return deviceIndexes.value(name, -1);
 }
 
 QMap<QString, QVariant> Sniffer::getDeviceInfo(QString name)
@@ -120,21 +135,13 @@ QMap<QString, QVariant> Sniffer::getDeviceInfo(QString name)
         return QMap<QString, QVariant>();
     }
 
-    pcap_if_t *device;
-    int i;
-    for (device = devices, i = 0; i < index; device = device->next, i += 1);
+    const CaptureDevice &device = devices[index];
 
     QMap<QString, QVariant> info;
-    info["Name"] = QString(device->name);
-    info["Description"] = QString(device->description);
-
-    if (device->flags & PCAP_IF_LOOPBACK) {
-        info["Loopback"] = true;
-    } else {
-        info["Loopback"] = false;
-    }
-
-    info["Addresses"] = getDeviceAddresses(name);
+    info["Name"] = device.name;
+    info["Description"] = device.description;
+    info["Loopback"] = device.loopback;
+    info["Addresses"] = device.addresses;
 
     return info;
 }
@@ -146,122 +153,185 @@ QList<QMap<QString, QVariant>> Sniffer::getDeviceAddressesWithInfo(QString name)
         return QList<QMap<QString, QVariant>>();
     }
 
-    QList<QMap<QString, QVariant>> addresses;
-
-    pcap_if_t *device;
-    int i;
-    for (device = devices, i = 0; i < index; device = device->next, i += 1);
-
-    for (pcap_addr_t *a = device->addresses; a; a = a->next) {
-        if (a->addr->sa_family == AF_INET) {
-            QMap<QString, QVariant> addressInfo;
-
-            if (a->addr) {
-                addressInfo["Address"] = QString(iptos(((struct sockaddr_in *)a->addr)->sin_addr.s_addr));
-            }
-
-            if (a->netmask) {
-                addressInfo["Netmask"] = QString(iptos(((struct sockaddr_in *)a->netmask)->sin_addr.s_addr));
-            }
-
-            if (a->broadaddr) {
-                addressInfo["Broadcast"] = QString(iptos(((struct sockaddr_in *)a->broadaddr)->sin_addr.s_addr));
-            }
-
-            if (a->dstaddr) {
-                addressInfo["Destination"] = QString(iptos(((struct sockaddr_in *)a->dstaddr)->sin_addr.s_addr));
-            }
-
-            addresses.append(addressInfo);
-        }
-    }
-
-    return addresses;
+    return devices[index].addressesWithInfo;
 }
 
 QStringList Sniffer::getDeviceAddresses(QString name)
 {
-    QList<QMap<QString, QVariant>> addressesWithInfo = getDeviceAddressesWithInfo(name);
-    if (addressesWithInfo.isEmpty()) {
+    int index = getDeviceIndex(name);
+    if (index == -1) {
         return QStringList();
     }
 
-    QStringList addresses;
-    for (int i = 0; i < addressesWithInfo.count(); i += 1) {
-        QMap<QString, QVariant> addressInfo = addressesWithInfo[i];
-
-        if (addressInfo.contains("Address")) {
-            addresses.append(addressInfo["Address"].toString());
-        }
-    }
+    return devices[index].addresses;
+}
 
-    return addresses;
+bool Sniffer::isSniffing(QString name)
+{
+    return !snifferThread.isNull() && snifferThread->isRunning() && sniffingDeviceName == name;
 }
 
 bool Sniffer::startSniffing(QString name)
 {
+    // An adapter that is already open and filtered is kept as it is
+    if (isSniffing(name)) {
+        return true;
+    }
+
+    TraceSpan span("capture.open");
+
     int index = getDeviceIndex(name);
     if (index == -1) {
         return false;
     }
 
-    pcap_if_t *device;
-    int i;
-    for (device = devices, i = 0; i < index; device = device->next, i += 1);
+    stopSniffing();
+
+    const CaptureDevice &device = devices[index];
 
-    pcap_t *adhandle;
     char errbuf[PCAP_ERRBUF_SIZE];
-    if ((adhandle = pcap_open(device->name,	65536, 0, 1000,	NULL, errbuf)) == NULL) {
-        qDebug() << "Unable to open the adapter. " << device->name << " is not supported by Npcap";
+    PcapHandle adhandle(pcap_open(device.name.toLocal8Bit().constData(), 65536, 0, 1000, NULL, errbuf));
+    if (adhandle.isNull()) {
+        qDebug() << "Unable to open the adapter. " << device.name << " is not supported by Npcap";
         return false;
     }
 
     /* Check the link layer. We support only Ethernet for simplicity. */
-    if (pcap_datalink(adhandle) != DLT_EN10MB)
+    if (pcap_datalink(adhandle.get()) != DLT_EN10MB)
     {
         qDebug() << "This program works only on Ethernet networks.";
         return false;
     }
 
-    u_int netmask;
-    if (device->addresses != NULL) {
-        /* Retrieve the mask of the first address of the interface */
-        netmask = ((struct sockaddr_in *)(device->addresses->netmask))->sin_addr.S_un.S_addr;
-    } else {
-        /* If the interface is without addresses we suppose to be in a C class network */
-        netmask=0xffffff;
+    if (!setFilter(adhandle.get(), device.netmask)) {
+        return false;
     }
 
-    QString packet_filter = QString("ip and udp port %1").arg(SNIFF_PORT);
-    struct bpf_program fcode;
-    if (pcap_compile(adhandle, &fcode, packet_filter.toLocal8Bit().data(), 1, netmask) < 0) {
+    startThread(std::move(adhandle), 0);
+    sniffingDeviceName = name;
+
+    return true;
+}
+
+bool Sniffer::startReplay(QString filename, double speed)
+{
+    stopSniffing();
+
+    char errbuf[PCAP_ERRBUF_SIZE];
+    PcapHandle adhandle(pcap_open_offline(filename.toLocal8Bit().constData(), errbuf));
+    if (adhandle.isNull()) {
+        qDebug() << "Unable to open the capture" << filename << QString(errbuf);
+        return false;
+    }
+
+    if (pcap_datalink(adhandle.get()) != DLT_EN10MB) {
+        qDebug() << "This program works only on Ethernet captures.";
+        return false;
+    }
+
+    if (!setFilter(adhandle.get(), PCAP_NETMASK_UNKNOWN)) {
+        return false;
+    }
+
+    startThread(std::move(adhandle), speed);
+
+    return true;
+}
+
+bool Sniffer::setFilter(pcap_t *adhandle, u_int netmask)
+{
+    QString packet_filter = QString("(ip or ip6) and udp port %1").arg(SNIFF_PORT);
+    BpfProgram fcode;
+    if (!fcode.compile(adhandle, packet_filter, netmask)) {
         qDebug() << "Unable to compile the packet filter. Check the syntax.";
         return false;
     }
 
-    if (pcap_setfilter(adhandle, &fcode) < 0) {
+    if (pcap_setfilter(adhandle, fcode.get()) < 0) {
         qDebug() << "Error setting the filter.";
         return false;
     }
 
-    snifferThread = new SnifferThread(adhandle, this);
-    snifferThread->start();
+    return true;
+}
 
-    connect(snifferThread, &SnifferThread::newResult, this, [=](QMap<QString, QVariant> result) {
-        emit newSniffResult(result);
+void Sniffer::startThread(PcapHandle &&adhandle, double replaySpeed)
+{
+    // Owned through the scoped pointer rather than a parent, so stopping tears it down on the spot
+    snifferThread.reset(new SnifferThread(std::move(adhandle)));
+    snifferThread->setReplaySpeed(replaySpeed);
+    snifferThread->setSightingSinks(sightingSinks);
+
+    // Signals still queued from a thread that was stopped must not reach whoever listens to the next one
+    threadGeneration += 1;
+    quint64 generation = threadGeneration;
+
+    connect(snifferThread.data(), &SnifferThread::timeout, this, [=]() {
+        if (generation == threadGeneration) {
+            emit sniffTimeout();
+        }
     });
-    connect(snifferThread, &SnifferThread::timeout, this, [=]() {
-        emit sniffTimeout();
+    connect(snifferThread.data(), &QThread::finished, this, [=]() {
+        if (generation == threadGeneration) {
+            emit sniffFinished();
+        }
     });
 
-    return true;
+    snifferThread->start();
 }
 
 void Sniffer::stopSniffing()
 {
-    if (snifferThread != NULL) {
-        snifferThread->stop();
-        snifferThread->quit();
-        snifferThread->wait();
+    static MetricHistogram *stopHistogram = Metrics::histogram("capture_stop_seconds", "Time to stop the capture thread and close the adapter");
+
+    if (snifferThread.isNull()) {
+        return;
+    }
+
+    TraceSpan span("capture.stop");
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Stops and joins the thread, which then closes the adapter
+    threadGeneration += 1;
+    snifferThread.reset();
+    sniffingDeviceName.clear();
+
+    lastStopNs = timer.nsecsElapsed();
+    stopHistogram->record(lastStopNs);
+}
+
+qint64 Sniffer::getLastStopNs()
+{
+    return lastStopNs;
+}
+
+void Sniffer::addSightingSink(SessionTracker *tracker, QStringList localAddresses)
+{
+    // Packets our own address sent from the game port, recorded on the capture thread
+    removeSightingSink(tracker);
+
+    SightingSink sink;
+    sink.tracker = tracker;
+    sink.localAddresses = localAddresses;
+    sink.sourcePort = SNIFF_PORT;
+    sightingSinks.append(sink);
+
+    if (!snifferThread.isNull()) {
+        snifferThread->setSightingSinks(sightingSinks);
+    }
+}
+
+void Sniffer::removeSightingSink(SessionTracker *tracker)
+{
+    for (int i = sightingSinks.count() - 1; i >= 0; i -= 1) {
+        if (sightingSinks[i].tracker == tracker) {
+            sightingSinks.removeAt(i);
+        }
+    }
+
+    if (!snifferThread.isNull()) {
+        snifferThread->setSightingSinks(sightingSinks);
     }
 }
@@ -2,15 +2,22 @@
 #include <QDebug>
 #include <QVariant>
 #include <QThread>
+#include <QVector>
+#include <QHash>
+#include <QScopedPointer>
 
+#ifdef Q_OS_WIN
 #include <tchar.h>
+#endif
 
 #include "snifferthread.h"
+#include "devicelister.h"
+#include "tracing.h"
+#include "metrics.h"
 
 #ifndef SNIFFER_H
 #define SNIFFER_H
 
-#define IPTOSBUFFERS 12
 #define SNIFF_PORT 6672
 
 class Sniffer : public QObject
@@ -19,6 +26,7 @@ class Sniffer : public QObject
 
 public:
     explicit Sniffer(QObject *parent = nullptr);
+    ~Sniffer();
 
     bool isDllLoaded();
     QStringList getDeviceNames();
@@ -26,23 +34,39 @@ public:
     QMap<QString, QVariant> getDeviceInfo(QString name);
     QList<QMap<QString, QVariant>> getDeviceAddressesWithInfo(QString name);
     QStringList getDeviceAddresses(QString name);
+    void refreshDevices();
     bool startSniffing(QString name);
+    bool startReplay(QString filename, double speed = 0);
     void stopSniffing();
+    bool isSniffing(QString name);
+    qint64 getLastStopNs();
+    void addSightingSink(SessionTracker *tracker, QStringList localAddresses);
+    void removeSightingSink(SessionTracker *tracker);
 
 private:
     bool dllLoaded = false;
-    pcap_if_t *devices = NULL;
-    SnifferThread *snifferThread = NULL;
+    QVector<CaptureDevice> devices;
+    QHash<QString, int> deviceIndexes;
+    QScopedPointer<SnifferThread> snifferThread;
+    QString sniffingDeviceName;
+    qint64 lastStopNs = 0;
+    quint64 threadGeneration = 0;
+    QList<SightingSink> sightingSinks;
+    QThread *deviceThread = nullptr;
+    DeviceLister *deviceLister = nullptr;
+    quint64 deviceGeneration = 0;
 
-    BOOL LoadNpcapDlls();
-    char *iptos(u_long in);
+    bool LoadNpcapDlls();
     bool loadDevices();
-    void onDestroyed();
-    void freeDevices();
+    void setDevices(QVector<CaptureDevice> devices);
+    void onDevicesListed(quint64 generation, bool success, QVector<CaptureDevice> devices);
+    bool setFilter(pcap_t *adhandle, u_int netmask);
+    void startThread(PcapHandle &&adhandle, double replaySpeed);
 
 signals:
-    void newSniffResult(QMap<QString, QVariant> result);
     void sniffTimeout();
+    void sniffFinished();
+    void devicesChanged();
 };
 
 #endif // SNIFFER_H
@@ -1,12 +1,28 @@
 #include "snifferthread.h"
 
-SnifferThread::SnifferThread(pcap_t *adhandle, QObject *parent): QThread(parent)
+#include <utility>
+
+QAtomicInt SnifferThread::liveCount;
+
+SnifferThread::SnifferThread(PcapHandle &&adhandle, QObject *parent): QThread(parent), adhandle(std::move(adhandle))
 {
-    this->adhandle = adhandle;
+    liveCount.ref();
 
-    connect(this, &QObject::destroyed, this, [=]() {
-        qDebug() << "SnifferThread Destroyed";
-    });
+    setObjectName("Capture");
+}
+
+SnifferThread::~SnifferThread()
+{
+    // The capture loop has to be out of the handle before it is closed
+    stop();
+    wait();
+
+    liveCount.deref();
+}
+
+int SnifferThread::getLiveCount()
+{
+    return liveCount.loadRelaxed();
 }
 
 void SnifferThread::run()
@@ -15,68 +31,235 @@ void SnifferThread::run()
     struct pcap_pkthdr *header;
     const u_char *pkt_data;
 
-    while (loop && (res = pcap_next_ex(adhandle, &header, &pkt_data)) >= 0) {
-        if (!loop) {
+    QElapsedTimer replayTimer;
+    qint64 firstPacketUs = -1;
+
+    MetricCounter *packetCounter = Metrics::counter("capture_packets_total", "Packets read from the capture");
+    MetricCounter *skippedCounter = Metrics::counter("capture_packets_skipped_total", "Captured packets that were not decodable UDP");
+    MetricHistogram *decodeHistogram = Metrics::histogram("capture_decode_seconds", "Time to decode one captured packet");
+
+    /* one span per CAPTURE_TRACE_BATCH packets, or per read timeout, so a busy lobby does not flood the trace */
+    qint64 traceStartNs = -1;
+    int tracePackets = 0;
+    auto endTraceBatch = [&]() {
+        if (traceStartNs >= 0) {
+            Tracing::record("capture.packets", traceStartNs, Tracing::now() - traceStartNs);
+            traceStartNs = -1;
+        }
+        tracePackets = 0;
+    };
+
+    /* pcap_breakloop makes a blocked read return PCAP_ERROR_BREAK, which ends the loop as well */
+    while (!stopRequested.loadAcquire() && (res = pcap_next_ex(adhandle.get(), &header, &pkt_data)) >= 0) {
+        if (stopRequested.loadAcquire()) {
             break;
         }
 
         if (res == 0) {
             /* Timeout elapsed */
+            endTraceBatch();
             emit timeout();
             continue;
         }
 
-        struct tm ltime;
-        char timestr[16];
-        ip_header *ih;
-        udp_header *uh;
-        u_int ip_len;
-        u_short sport,dport;
-        time_t local_tv_sec;
+        /* a replayed capture is paced by its timestamps, unless it runs as fast as it can */
+        if (replaySpeed > 0) {
+            qint64 packetUs = (qint64) header->ts.tv_sec * 1000000 + header->ts.tv_usec;
+            if (firstPacketUs == -1) {
+                firstPacketUs = packetUs;
+                replayTimer.start();
+            }
 
-        /* convert the timestamp to readable format */
-        local_tv_sec = header->ts.tv_sec;
-        localtime_s(&ltime, &local_tv_sec);
-        strftime(timestr, sizeof timestr, "%H:%M:%S", &ltime);
+            qint64 waitUs = (qint64) ((packetUs - firstPacketUs) / replaySpeed) - replayTimer.nsecsElapsed() / 1000;
+            if (waitUs > 0) {
+                /* waits on a condition rather than sleeping, so stop() cuts it short */
+                QDeadlineTimer deadline(Qt::PreciseTimer);
+                deadline.setPreciseRemainingTime(0, waitUs * 1000, Qt::PreciseTimer);
 
-        /* print timestamp and length of the packet */
-        //printf("%s.%.6d len:%d ", timestr, header->ts.tv_usec, header->len);
+                QMutexLocker locker(&pacingMutex);
+                while (!stopRequested.loadAcquire() && !deadline.hasExpired()) {
+                    pacingCondition.wait(&pacingMutex, deadline);
+                }
+            }
 
-        /* retireve the position of the ip header */
-        ih = (ip_header *) (pkt_data + 14); //length of ethernet header
-
-        /* retireve the position of the udp header */
-        ip_len = (ih->ver_ihl & 0xf) * 4;
-        uh = (udp_header *) ((u_char*)ih + ip_len);
-
-        /* convert from network byte order to host byte order */
-        sport = ntohs(uh->sport);
-        dport = ntohs(uh->dport);
-
-        /* print ip addresses and udp ports */
-        /*printf("%d.%d.%d.%d.%d -> %d.%d.%d.%d.%d\n",
-            ih->saddr.byte1,
-            ih->saddr.byte2,
-            ih->saddr.byte3,
-            ih->saddr.byte4,
-            sport,
-            ih->daddr.byte1,
-            ih->daddr.byte2,
-            ih->daddr.byte3,
-            ih->daddr.byte4,
-            dport);*/
+            if (stopRequested.loadAcquire()) {
+                break;
+            }
+        }
+
+        if (traceStartNs < 0 && Tracing::isEnabled()) {
+            traceStartNs = Tracing::now();
+        }
+        tracePackets += 1;
+        packetCounter->add();
 
+        qint64 decodeStartNs = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
         QMap<QString, QVariant> result;
-        result["saddr"] = QString("%1.%2.%3.%4").arg(ih->saddr.byte1).arg(ih->saddr.byte2).arg(ih->saddr.byte3).arg(ih->saddr.byte4);
-        result["sport"] = sport;
-        result["daddr"] = QString("%1.%2.%3.%4").arg(ih->daddr.byte1).arg(ih->daddr.byte2).arg(ih->daddr.byte3).arg(ih->daddr.byte4);
-        result["dport"] = dport;
+        if (!decodePacket(header, pkt_data, &result)) {
+            skippedCounter->add();
+            if (tracePackets >= CAPTURE_TRACE_BATCH) {
+                endTraceBatch();
+            }
+            continue;
+        }
+
+        /* monotonic time of the decode, for measuring how long the packet takes to show up */
+        qint64 decodedNs = QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs();
+        decodeHistogram->record(decodedNs - decodeStartNs);
+
+        recordSightings(result, decodedNs);
 
-        emit newResult(result);
+        if (tracePackets >= CAPTURE_TRACE_BATCH) {
+            endTraceBatch();
+        }
     }
+
+    endTraceBatch();
 }
 
 void SnifferThread::stop()
 {
-    loop = false;
+    /* may be called from any thread. The flag is set first, so the loop that the break wakes up sees it */
+    stopRequested.storeRelease(1);
+    pcap_breakloop(adhandle.get());
+
+    QMutexLocker locker(&pacingMutex);
+    pacingCondition.wakeAll();
+}
+
+void SnifferThread::setReplaySpeed(double speed)
+{
+    replaySpeed = speed;
+}
+
+void SnifferThread::setSightingSinks(QList<SightingSink> sinks)
+{
+    /* may be called from any thread. Once it returns, no removed tracker is touched any more */
+    QMutexLocker locker(&sinkMutex);
+    this->sinks = sinks;
+}
+
+void SnifferThread::recordSightings(const QMap<QString, QVariant> &result, qint64 decodedNs)
+{
+    /* the trackers take the sighting here, so nothing per packet has to reach the GUI thread */
+    QMutexLocker locker(&sinkMutex);
+    if (sinks.isEmpty()) {
+        return;
+    }
+
+    QString saddr = result["saddr"].toString();
+    int sport = result["sport"].toInt();
+    QString daddr = result["daddr"].toString();
+    qint64 now = QDateTime::currentSecsSinceEpoch();
+
+    for (int i = 0; i < sinks.count(); i += 1) {
+        if (sport == sinks[i].sourcePort && sinks[i].localAddresses.contains(saddr)) {
+            sinks[i].tracker->recordSighting(daddr, now, decodedNs);
+        }
+    }
+}
+
+bool SnifferThread::decodePacket(const struct pcap_pkthdr *header, const u_char *pkt_data, QMap<QString, QVariant> *result)
+{
+    u_int caplen = header->caplen;
+    if (caplen < ETHERNET_HEADER_LENGTH) {
+        return false;
+    }
+
+    /* retrieve the ethertype, skipping a single 802.1Q tag */
+    u_int offset = ETHERNET_HEADER_LENGTH;
+    u_short ethertype = (pkt_data[12] << 8) | pkt_data[13];
+    if (ethertype == ETHERTYPE_VLAN) {
+        if (caplen < ETHERNET_HEADER_LENGTH + VLAN_TAG_LENGTH) {
+            return false;
+        }
+
+        ethertype = (pkt_data[16] << 8) | pkt_data[17];
+        offset += VLAN_TAG_LENGTH;
+    }
+
+    QString saddr;
+    QString daddr;
+
+    if (ethertype == ETHERTYPE_IPV4) {
+        if (caplen < offset + IPV4_MIN_HEADER_LENGTH) {
+            return false;
+        }
+
+        /* retireve the position of the ip header */
+        ip_header *ih = (ip_header *) (pkt_data + offset);
+        if (ih->proto != IPPROTO_UDP_NUMBER) {
+            return false;
+        }
+
+        /* a header shorter than 20 bytes is malformed, and only the first fragment carries the ports */
+        u_int headerLength = (ih->ver_ihl & 0xf) * 4;
+        if (headerLength < IPV4_MIN_HEADER_LENGTH || (ntohs(ih->flags_fo) & IPV4_FRAGMENT_OFFSET_MASK) != 0) {
+            return false;
+        }
+
+        offset += headerLength;
+
+        saddr = AddressFormat::toString4((const quint8 *) &ih->saddr);
+        daddr = AddressFormat::toString4((const quint8 *) &ih->daddr);
+    } else if (ethertype == ETHERTYPE_IPV6) {
+        if (caplen < offset + IPV6_HEADER_LENGTH) {
+            return false;
+        }
+
+        ipv6_header *ih6 = (ipv6_header *) (pkt_data + offset);
+        u_char nxt = ih6->nxt;
+        offset += IPV6_HEADER_LENGTH;
+
+        /* walk the hop-by-hop, routing, fragment and destination options headers */
+        while (nxt == 0 || nxt == 43 || nxt == IPV6_FRAGMENT_HEADER || nxt == 60) {
+            u_char type = nxt;
+            u_int headerLength = sizeof(ipv6_ext_header);
+            if (type == IPV6_FRAGMENT_HEADER) {
+                headerLength = IPV6_FRAGMENT_HEADER_LENGTH;
+            }
+
+            if (caplen < offset + headerLength) {
+                return false;
+            }
+
+            /* the length of a header goes by its own type, the fragment header is always 8 bytes */
+            ipv6_ext_header *eh = (ipv6_ext_header *) (pkt_data + offset);
+            if (type == IPV6_FRAGMENT_HEADER) {
+                /* only the first fragment carries the ports */
+                u_short fragmentOffset = (pkt_data[offset + 2] << 8) | pkt_data[offset + 3];
+                if ((fragmentOffset & IPV6_FRAGMENT_OFFSET_MASK) != 0) {
+                    return false;
+                }
+            } else {
+                headerLength = (eh->len + 1) * 8;
+            }
+
+            nxt = eh->nxt;
+            offset += headerLength;
+        }
+
+        if (nxt != IPPROTO_UDP_NUMBER) {
+            return false;
+        }
+
+        saddr = AddressFormat::toString6((const quint8 *) ih6->saddr.bytes);
+        daddr = AddressFormat::toString6((const quint8 *) ih6->daddr.bytes);
+    } else {
+        return false;
+    }
+
+    if (caplen < offset + sizeof(udp_header)) {
+        return false;
+    }
+
+    /* retireve the position of the udp header */
+    udp_header *uh = (udp_header *) (pkt_data + offset);
+
+    (*result)["saddr"] = saddr;
+    (*result)["sport"] = ntohs(uh->sport);
+    (*result)["daddr"] = daddr;
+    (*result)["dport"] = ntohs(uh->dport);
+
+    return true;
 }
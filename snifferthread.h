@@ -1,13 +1,44 @@
 #include <QObject>
 #include <QThread>
 #include <QDebug>
+#include <QHostAddress>
+
+#include <QDeadlineTimer>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDateTime>
 
 #include <pcap.h>
+#ifdef Q_OS_WIN
 #include <Winsock2.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+#include "addressformat.h"
+#include "pcapresource.h"
+#include "metrics.h"
+#include "tracing.h"
+#include "sessiontracker.h"
 
 #ifndef SNIFFERTHREAD_H
 #define SNIFFERTHREAD_H
 
+#define ETHERNET_HEADER_LENGTH 14
+#define VLAN_TAG_LENGTH 4
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_IPV6 0x86DD
+#define ETHERTYPE_VLAN 0x8100
+#define IPV4_MIN_HEADER_LENGTH 20
+#define IPV4_FRAGMENT_OFFSET_MASK 0x1FFF
+#define IPV6_HEADER_LENGTH 40
+#define IPV6_FRAGMENT_HEADER 44
+#define IPV6_FRAGMENT_HEADER_LENGTH 8
+#define IPV6_FRAGMENT_OFFSET_MASK 0xFFF8
+#define IPPROTO_UDP_NUMBER 17
+#define CAPTURE_TRACE_BATCH 256
+
 /* 4 bytes IP address */
 typedef struct ip_address {
     u_char byte1;
@@ -31,6 +62,27 @@ typedef struct ip_header {
     u_int	op_pad;			// Option + Padding
 } ip_header;
 
+/* 16 bytes IPv6 address */
+typedef struct ipv6_address {
+    u_char bytes[16];
+} ipv6_address;
+
+/* IPv6 header */
+typedef struct ipv6_header {
+    u_int	ver_tc_fl;		// Version (4 bits) + Traffic class (8 bits) + Flow label (20 bits)
+    u_short plen;			// Payload length
+    u_char	nxt;			// Next header
+    u_char	hlim;			// Hop limit
+    ipv6_address saddr;		// Source address
+    ipv6_address daddr;		// Destination address
+} ipv6_header;
+
+/* IPv6 extension header */
+typedef struct ipv6_ext_header {
+    u_char	nxt;			// Next header
+    u_char	len;			// Header length in 8 byte units, not counting the first 8 bytes
+} ipv6_ext_header;
+
 /* UDP header*/
 typedef struct udp_header {
     u_short sport;			// Source port
@@ -39,22 +91,41 @@ typedef struct udp_header {
     u_short crc;			// Checksum
 } udp_header;
 
+/* Packets a local address sent from one port, whose destinations are recorded in a tracker */
+struct SightingSink
+{
+    SessionTracker *tracker;
+    QStringList localAddresses;
+    int sourcePort;
+};
+
 class SnifferThread : public QThread
 {
     Q_OBJECT
 public:
-    SnifferThread(pcap_t *adhandle, QObject *parent = nullptr);
+    SnifferThread(PcapHandle &&adhandle, QObject *parent = nullptr);
+    ~SnifferThread();
 
     void stop();
+    void setReplaySpeed(double speed);
+    void setSightingSinks(QList<SightingSink> sinks);
+    static bool decodePacket(const struct pcap_pkthdr *header, const u_char *pkt_data, QMap<QString, QVariant> *result);
+    static int getLiveCount();
 
 private:
-    pcap_t *adhandle;
-    bool loop = true;
+    PcapHandle adhandle;
+    static QAtomicInt liveCount;
+    QAtomicInt stopRequested;
+    QMutex pacingMutex;
+    QWaitCondition pacingCondition;
+    double replaySpeed = 0;
+    QMutex sinkMutex;
+    QList<SightingSink> sinks;
 
     void run() override;
+    void recordSightings(const QMap<QString, QVariant> &result, qint64 decodedNs);
 
 signals:
-    void newResult(QMap<QString, QVariant> result);
     void timeout();
 };
 
@@ -0,0 +1,22 @@
+QT -= gui
+QT += network
+
+CONFIG += c++14 console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+TARGET = lobbygen
+
+SOURCES += \
+    lobbygenerator.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../reservedranges.h \
+    lobbygenerator.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
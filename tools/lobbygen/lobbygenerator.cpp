@@ -0,0 +1,420 @@
+#include "lobbygenerator.h"
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <QtMath>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <vector>
+
+LobbyGenerator::LobbyGenerator(QObject *parent) : QObject(parent)
+{
+    for (size_t i = 0; i < RESERVED_RANGE_COUNT; i += 1) {
+        QPair<QHostAddress, int> subnet = QHostAddress::parseSubnet(RESERVED_RANGES[i]);
+        quint32 first = subnet.first.toIPv4Address();
+        quint32 last = first | (subnet.second == 0 ? 0xFFFFFFFFu : (0xFFFFFFFFu >> subnet.second));
+        reservedRanges.append(qMakePair(first, last));
+    }
+
+    setScenario(QJsonObject());
+}
+
+PacketRate LobbyGenerator::parseRate(QJsonValue value, double defaultMean)
+{
+    QJsonObject object = value.toObject();
+
+    PacketRate rate;
+    rate.distribution = object["Distribution"].toString("poisson");
+    rate.mean = object["Mean"].toDouble(defaultMean);
+    rate.min = object["Min"].toDouble(rate.mean / 2);
+    rate.max = object["Max"].toDouble(rate.mean * 2);
+
+    return rate;
+}
+
+bool LobbyGenerator::loadScenario(QString filename)
+{
+    QFile scenarioFile(filename);
+    if (!scenarioFile.open(QIODevice::ReadOnly)) {
+        error = QString("Unable to open %1: %2").arg(filename, scenarioFile.errorString());
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(scenarioFile.readAll(), &parseError);
+    if (!document.isObject()) {
+        error = QString("Invalid scenario %1: %2").arg(filename, parseError.errorString());
+        return false;
+    }
+
+    setScenario(document.object());
+
+    return true;
+}
+
+void LobbyGenerator::setScenario(QJsonObject scenario)
+{
+    duration = scenario["Duration"].toDouble(60);
+    startTime = scenario["StartTime"].toDouble(1600000000);
+    seed = (quint32) scenario["Seed"].toInt(1);
+    localAddress = QHostAddress(scenario["LocalAddress"].toString("192.168.1.10")).toIPv4Address();
+    localAddress6 = QHostAddress(scenario["LocalAddress6"].toString("2001:db8:1::10")).toIPv6Address();
+    peerCount = scenario["Peers"].toInt(29);
+    churnPerMinute = scenario["ChurnPerMinute"].toDouble(6);
+    peerRate = parseRate(scenario["PeerPacketRate"], 30);
+    relayCount = scenario["Relays"].toInt(2);
+    relayRate = parseRate(scenario["RelayPacketRate"], 60);
+    noiseRate = parseRate(scenario["NoisePacketRate"], 20);
+    ipv6Ratio = scenario["Ipv6Ratio"].toDouble(0);
+    outboundRatio = scenario["OutboundRatio"].toDouble(0.5);
+    vlanId = scenario["VlanId"].toInt(0);
+    malformedRatio = scenario["MalformedRatio"].toDouble(0.001);
+    payloadMin = qBound(0, scenario["PayloadMin"].toInt(80), LOBBY_MAX_PACKET_SIZE);
+    payloadMax = qBound(payloadMin, scenario["PayloadMax"].toInt(1200), LOBBY_MAX_PACKET_SIZE);
+    snaplen = qBound(64, scenario["Snaplen"].toInt(128), 65535);
+}
+
+QString LobbyGenerator::getError()
+{
+    return error;
+}
+
+qint64 LobbyGenerator::getPacketCount()
+{
+    return packetCount;
+}
+
+qint64 LobbyGenerator::getByteCount()
+{
+    return byteCount;
+}
+
+double LobbyGenerator::getInterval(const PacketRate &rate)
+{
+    if (rate.distribution == "constant") {
+        return 1.0 / qMax(rate.mean, 0.001);
+    }
+
+    if (rate.distribution == "uniform") {
+        double packetsPerSecond = rate.min + (rate.max - rate.min) * generator.generateDouble();
+        return 1.0 / qMax(packetsPerSecond, 0.001);
+    }
+
+    // Poisson arrivals have exponentially distributed gaps
+    return -qLn(1.0 - generator.generateDouble()) / qMax(rate.mean, 0.001);
+}
+
+double LobbyGenerator::getLifetime()
+{
+    // With churnPerMinute peers leaving a lobby of peerCount, each one stays peerCount / churn minutes on average
+    if (churnPerMinute <= 0) {
+        return INFINITY;
+    }
+
+    double meanSeconds = 60.0 * peerCount / churnPerMinute;
+    return -qLn(1.0 - generator.generateDouble()) * meanSeconds;
+}
+
+quint32 LobbyGenerator::getRandomPublicAddress()
+{
+    while (true) {
+        quint32 address = generator.generate();
+        bool reserved = false;
+        for (const QPair<quint32, quint32> &range : reservedRanges) {
+            if (address >= range.first && address <= range.second) {
+                reserved = true;
+                break;
+            }
+        }
+        if (!reserved) {
+            return address;
+        }
+    }
+}
+
+void LobbyGenerator::initFlow(Flow *flow, FlowKind kind, double now)
+{
+    flow->kind = kind;
+    flow->ipv6 = (kind != FlowNoise) && generator.generateDouble() < ipv6Ratio;
+    flow->remoteAddress = getRandomPublicAddress();
+    for (int i = 0; i < 16; i += 1) {
+        flow->remoteAddress6[i] = (quint8) generator.bounded(256);
+    }
+    flow->remoteAddress6[0] = 0x20 | (flow->remoteAddress6[0] & 0x0F);
+
+    // Most consoles and PCs keep the game port, the rest sit behind a NAT that remaps it
+    flow->remotePort = (kind == FlowPeer && generator.generateDouble() < 0.3) ? (quint16) generator.bounded(1024, 65536) : LOBBY_SESSION_PORT;
+    flow->rate = (kind == FlowPeer) ? peerRate : ((kind == FlowRelay) ? relayRate : noiseRate);
+    flow->leaveTime = (kind == FlowPeer) ? now + getLifetime() : INFINITY;
+}
+
+int LobbyGenerator::buildPacket(const Flow &flow, uchar *data, int *originalLength)
+{
+    bool outbound = generator.generateDouble() < outboundRatio;
+    int payloadLength = payloadMin + (int) generator.bounded(payloadMax - payloadMin + 1);
+
+    // The payload past the headers is never written, so it stays zero from the start of the run
+    memset(data, 0, LOBBY_HEADER_AREA_SIZE);
+
+    // Ethernet, with the local NIC as 02:00:00:00:00:01 and the gateway as 02:00:00:00:00:02
+    int offset = 0;
+    data[5] = outbound ? 0x02 : 0x01;
+    data[11] = outbound ? 0x01 : 0x02;
+    data[0] = 0x02;
+    data[6] = 0x02;
+    offset = 12;
+    if (vlanId > 0) {
+        qToBigEndian<quint16>(0x8100, data + offset);
+        qToBigEndian<quint16>((quint16) (vlanId & 0x0FFF), data + offset + 2);
+        offset += 4;
+    }
+
+    int ethertypeOffset = offset;
+    qToBigEndian<quint16>(flow.ipv6 ? 0x86DD : 0x0800, data + offset);
+    offset += 2;
+
+    int protocolOffset;
+    if (flow.ipv6) {
+        data[offset] = 0x60;
+        qToBigEndian<quint16>((quint16) (8 + payloadLength), data + offset + 4);
+        data[offset + 6] = 17;
+        data[offset + 7] = 64;
+        memcpy(data + offset + (outbound ? 8 : 24), localAddress6.c, 16);
+        memcpy(data + offset + (outbound ? 24 : 8), flow.remoteAddress6.c, 16);
+        protocolOffset = offset + 6;
+        offset += 40;
+    } else {
+        quint32 source = localAddress;
+        quint32 destination = flow.remoteAddress;
+        if (flow.kind == FlowNoise) {
+            // Another machine on the LAN, which the session view has to ignore
+            source = (localAddress & 0xFFFFFF00u) | (quint32) generator.bounded(2, 255);
+            if (source == localAddress) {
+                source ^= 1;
+            }
+            destination = getRandomPublicAddress();
+        }
+        if (!outbound) {
+            qSwap(source, destination);
+        }
+
+        data[offset] = 0x45;
+        qToBigEndian<quint16>((quint16) (20 + 8 + payloadLength), data + offset + 2);
+        qToBigEndian<quint16>(ipIdentification, data + offset + 4);
+        ipIdentification += 1;
+        qToBigEndian<quint16>(0x4000, data + offset + 6);
+        data[offset + 8] = outbound ? 64 : 52;
+        data[offset + 9] = 17;
+        qToBigEndian<quint32>(source, data + offset + 12);
+        qToBigEndian<quint32>(destination, data + offset + 16);
+
+        quint32 sum = 0;
+        for (int i = 0; i < 20; i += 2) {
+            sum += qFromBigEndian<quint16>(data + offset + i);
+        }
+        while (sum >> 16) {
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        }
+        qToBigEndian<quint16>((quint16) ~sum, data + offset + 10);
+
+        protocolOffset = offset + 9;
+        offset += 20;
+    }
+
+    qToBigEndian<quint16>(outbound ? LOBBY_SESSION_PORT : flow.remotePort, data + offset);
+    qToBigEndian<quint16>(outbound ? flow.remotePort : LOBBY_SESSION_PORT, data + offset + 2);
+    qToBigEndian<quint16>((quint16) (8 + payloadLength), data + offset + 4);
+    offset += 8;
+
+    *originalLength = offset + payloadLength;
+    int capturedLength = qMin(*originalLength, snaplen);
+
+    if (malformedRatio > 0 && generator.generateDouble() < malformedRatio) {
+        switch (generator.bounded(3)) {
+        case 0:
+            // Cut off inside the headers
+            capturedLength = (int) generator.bounded(1, offset);
+            break;
+        case 1:
+            data[protocolOffset] = 6;
+            break;
+        default:
+            qToBigEndian<quint16>(0x88B5, data + ethertypeOffset);
+            break;
+        }
+    }
+
+    return capturedLength;
+}
+
+void LobbyGenerator::append(const void *data, int length)
+{
+    buffer.append((const char *) data, length);
+}
+
+void LobbyGenerator::appendUInt16(quint16 value)
+{
+    value = qToLittleEndian(value);
+    append(&value, sizeof(value));
+}
+
+void LobbyGenerator::appendUInt32(quint32 value)
+{
+    value = qToLittleEndian(value);
+    append(&value, sizeof(value));
+}
+
+void LobbyGenerator::writeHeader()
+{
+    if (format == FormatPcap) {
+        appendUInt32(PCAP_MAGIC);
+        appendUInt16(2);
+        appendUInt16(4);
+        appendUInt32(0);
+        appendUInt32(0);
+        appendUInt32(snaplen);
+        appendUInt32(LINKTYPE_ETHERNET);
+        return;
+    }
+
+    appendUInt32(PCAPNG_SECTION_HEADER_BLOCK);
+    appendUInt32(28);
+    appendUInt32(PCAPNG_BYTE_ORDER_MAGIC);
+    appendUInt16(1);
+    appendUInt16(0);
+    appendUInt32(0xFFFFFFFFu);
+    appendUInt32(0xFFFFFFFFu);
+    appendUInt32(28);
+
+    appendUInt32(PCAPNG_INTERFACE_DESCRIPTION_BLOCK);
+    appendUInt32(20);
+    appendUInt16(LINKTYPE_ETHERNET);
+    appendUInt16(0);
+    appendUInt32(snaplen);
+    appendUInt32(20);
+}
+
+void LobbyGenerator::writePacket(double time, const uchar *data, int capturedLength, int originalLength)
+{
+    quint64 microseconds = (quint64) ((startTime + time) * 1000000.0);
+
+    if (format == FormatPcap) {
+        appendUInt32((quint32) (microseconds / 1000000));
+        appendUInt32((quint32) (microseconds % 1000000));
+        appendUInt32(capturedLength);
+        appendUInt32(originalLength);
+        append(data, capturedLength);
+    } else {
+        // Enhanced packet block, with the packet data padded to 32 bits
+        int padding = (4 - capturedLength % 4) % 4;
+        quint32 blockLength = 32 + capturedLength + padding;
+        static const char zeros[4] = { 0, 0, 0, 0 };
+
+        appendUInt32(PCAPNG_ENHANCED_PACKET_BLOCK);
+        appendUInt32(blockLength);
+        appendUInt32(0);
+        appendUInt32((quint32) (microseconds >> 32));
+        appendUInt32((quint32) microseconds);
+        appendUInt32(capturedLength);
+        appendUInt32(originalLength);
+        append(data, capturedLength);
+        append(zeros, padding);
+        appendUInt32(blockLength);
+    }
+
+    packetCount += 1;
+}
+
+bool LobbyGenerator::flush()
+{
+    if (file.write(buffer) != buffer.size()) {
+        error = QString("Unable to write %1: %2").arg(file.fileName(), file.errorString());
+        return false;
+    }
+
+    byteCount += buffer.size();
+    buffer.clear();
+
+    return true;
+}
+
+bool LobbyGenerator::generate(QString filename, Format format)
+{
+    this->format = format;
+    generator.seed(seed);
+    ipIdentification = 0;
+    packetCount = 0;
+    byteCount = 0;
+    error.clear();
+
+    file.setFileName(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = QString("Unable to open %1: %2").arg(filename, file.errorString());
+        return false;
+    }
+
+    buffer.clear();
+    buffer.reserve(LOBBY_BUFFER_SIZE + LOBBY_PACKET_BUFFER_SIZE + 64);
+    writeHeader();
+
+    QVector<Flow> flows;
+    for (int i = 0; i < peerCount; i += 1) {
+        Flow flow;
+        initFlow(&flow, FlowPeer, 0);
+        flows.append(flow);
+    }
+    for (int i = 0; i < relayCount; i += 1) {
+        Flow flow;
+        initFlow(&flow, FlowRelay, 0);
+        flows.append(flow);
+    }
+    if (noiseRate.mean > 0) {
+        Flow flow;
+        initFlow(&flow, FlowNoise, 0);
+        flows.append(flow);
+    }
+
+    // Every flow is an independent arrival process, merged in time order through a heap
+    typedef QPair<double, int> Event;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    for (int i = 0; i < flows.count(); i += 1) {
+        events.push(Event(getInterval(flows[i].rate), i));
+    }
+
+    uchar packet[LOBBY_PACKET_BUFFER_SIZE];
+    memset(packet, 0, sizeof(packet));
+    while (!events.empty()) {
+        Event event = events.top();
+        events.pop();
+
+        double time = event.first;
+        if (time > duration) {
+            continue;
+        }
+
+        Flow &flow = flows[event.second];
+        if (time >= flow.leaveTime) {
+            // The peer left and someone else took the slot
+            initFlow(&flow, FlowPeer, flow.leaveTime);
+        }
+
+        int originalLength = 0;
+        int capturedLength = buildPacket(flow, packet, &originalLength);
+        writePacket(time, packet, capturedLength, originalLength);
+
+        if (buffer.size() >= LOBBY_BUFFER_SIZE && !flush()) {
+            file.close();
+            return false;
+        }
+
+        events.push(Event(time + getInterval(flow.rate), event.second));
+    }
+
+    bool ok = flush();
+    file.close();
+
+    return ok;
+}
@@ -0,0 +1,114 @@
+#include <QObject>
+#include <QFile>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QPair>
+#include <QRandomGenerator>
+#include <QVector>
+
+#include "reservedranges.h"
+
+#ifndef LOBBYGENERATOR_H
+#define LOBBYGENERATOR_H
+
+#define LOBBY_SESSION_PORT 6672
+#define LOBBY_BUFFER_SIZE (4 * 1024 * 1024)
+#define LOBBY_MAX_PACKET_SIZE 1600
+#define LOBBY_HEADER_AREA_SIZE 128
+#define LOBBY_PACKET_BUFFER_SIZE (LOBBY_MAX_PACKET_SIZE + LOBBY_HEADER_AREA_SIZE)
+#define PCAP_MAGIC 0xA1B2C3D4u
+#define PCAPNG_SECTION_HEADER_BLOCK 0x0A0D0D0Au
+#define PCAPNG_INTERFACE_DESCRIPTION_BLOCK 1u
+#define PCAPNG_ENHANCED_PACKET_BLOCK 6u
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4Du
+#define LINKTYPE_ETHERNET 1
+
+/* Packets per second of one flow. "poisson" draws exponential gaps around Mean, "uniform" a rate between Min and Max */
+struct PacketRate
+{
+    QString distribution;
+    double mean;
+    double min;
+    double max;
+};
+
+/*
+ * Writes a pcap or pcapng capture of a simulated GTA Online lobby as seen from
+ * the local machine: peers that join and leave, relay servers and background
+ * noise, all on UDP 6672 over Ethernet (optionally VLAN tagged), with a share
+ * of malformed frames. Everything is driven by the scenario and its seed, so
+ * the same scenario always produces the same file.
+ */
+class LobbyGenerator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format { FormatPcap, FormatPcapng };
+
+    explicit LobbyGenerator(QObject *parent = nullptr);
+    bool loadScenario(QString filename);
+    void setScenario(QJsonObject scenario);
+    bool generate(QString filename, Format format);
+    QString getError();
+    qint64 getPacketCount();
+    qint64 getByteCount();
+
+private:
+    enum FlowKind { FlowPeer, FlowRelay, FlowNoise };
+
+    struct Flow
+    {
+        FlowKind kind;
+        bool ipv6;
+        quint32 remoteAddress;
+        Q_IPV6ADDR remoteAddress6;
+        quint16 remotePort;
+        PacketRate rate;
+        double leaveTime;
+    };
+
+    double duration;
+    double startTime;
+    quint32 seed;
+    quint32 localAddress;
+    Q_IPV6ADDR localAddress6;
+    int peerCount;
+    double churnPerMinute;
+    PacketRate peerRate;
+    int relayCount;
+    PacketRate relayRate;
+    PacketRate noiseRate;
+    double ipv6Ratio;
+    double outboundRatio;
+    int vlanId;
+    double malformedRatio;
+    int payloadMin;
+    int payloadMax;
+    int snaplen;
+
+    QVector<QPair<quint32, quint32>> reservedRanges;
+    QRandomGenerator generator;
+    Format format;
+    QFile file;
+    QByteArray buffer;
+    quint16 ipIdentification = 0;
+    qint64 packetCount = 0;
+    qint64 byteCount = 0;
+    QString error;
+
+    static PacketRate parseRate(QJsonValue value, double defaultMean);
+    double getInterval(const PacketRate &rate);
+    double getLifetime();
+    void initFlow(Flow *flow, FlowKind kind, double now);
+    quint32 getRandomPublicAddress();
+    int buildPacket(const Flow &flow, uchar *data, int *originalLength);
+    void writeHeader();
+    void writePacket(double time, const uchar *data, int capturedLength, int originalLength);
+    bool flush();
+    void append(const void *data, int length);
+    void appendUInt16(quint16 value);
+    void appendUInt32(quint32 value);
+};
+
+#endif // LOBBYGENERATOR_H
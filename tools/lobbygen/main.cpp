@@ -0,0 +1,60 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include "lobbygenerator.h"
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("lobbygen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Writes synthetic GTA Online lobby traffic to a pcap or pcapng file.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scenario", "Scenario JSON file.");
+    parser.addPositionalArgument("output", "Capture file to write.");
+    QCommandLineOption formatOption("format", "pcap or pcapng (default: from the output file extension).", "format");
+    parser.addOption(formatOption);
+    parser.process(a);
+
+    QStringList arguments = parser.positionalArguments();
+    if (arguments.count() != 2) {
+        parser.showHelp(1);
+    }
+
+    QString output = arguments[1];
+    QString formatName = parser.isSet(formatOption) ? parser.value(formatOption) : (output.endsWith(".pcapng", Qt::CaseInsensitive) ? "pcapng" : "pcap");
+
+    QTextStream errorStream(stderr);
+
+    if (formatName != "pcap" && formatName != "pcapng") {
+        errorStream << QString("Unknown format %1, expected pcap or pcapng").arg(formatName) << "\n";
+        return 1;
+    }
+
+    LobbyGenerator lobbyGenerator;
+    if (!lobbyGenerator.loadScenario(arguments[0])) {
+        errorStream << lobbyGenerator.getError() << "\n";
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    LobbyGenerator::Format format = (formatName == "pcapng") ? LobbyGenerator::FormatPcapng : LobbyGenerator::FormatPcap;
+    if (!lobbyGenerator.generate(output, format)) {
+        errorStream << lobbyGenerator.getError() << "\n";
+        return 1;
+    }
+
+    double seconds = qMax(timer.nsecsElapsed() / 1e9, 1e-9);
+    errorStream << QString("%1 packets, %2 bytes in %3 s (%4 packets/s)\n")
+                   .arg(lobbyGenerator.getPacketCount())
+                   .arg(lobbyGenerator.getByteCount())
+                   .arg(seconds, 0, 'f', 3)
+                   .arg(lobbyGenerator.getPacketCount() / seconds, 0, 'f', 0);
+
+    return 0;
+}
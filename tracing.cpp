@@ -0,0 +1,199 @@
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <atomic>
+
+QAtomicInt Tracing::enabled;
+
+namespace {
+
+struct TraceRegistry
+{
+    QMutex mutex;
+    QList<TraceBuffer *> buffers;
+    QList<TraceBuffer *> freeBuffers;
+    QAtomicInteger<qint64> sinceNs;
+};
+
+TraceRegistry &getRegistry()
+{
+    // Buffers outlive their threads so spans of finished threads can still be exported
+    static TraceRegistry *registry = new TraceRegistry();
+
+    return *registry;
+}
+
+/* Hands the buffer to the next new thread when its own exits, a capture session starts one each time */
+struct ThreadBufferHolder
+{
+    TraceBuffer *buffer = nullptr;
+
+    ~ThreadBufferHolder()
+    {
+        if (buffer != nullptr) {
+            TraceRegistry &registry = getRegistry();
+            QMutexLocker locker(&registry.mutex);
+            registry.freeBuffers.append(buffer);
+        }
+    }
+};
+
+TraceBuffer *getThreadBuffer()
+{
+    thread_local ThreadBufferHolder holder;
+    if (holder.buffer != nullptr) {
+        return holder.buffer;
+    }
+
+    TraceRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    int threadId = registry.freeBuffers.isEmpty() ? registry.buffers.count() + 1 : registry.freeBuffers.last()->getThreadId();
+    QThread *thread = QThread::currentThread();
+    QString threadName = thread->objectName();
+    if (threadName.isEmpty()) {
+        bool isMainThread = QCoreApplication::instance() != nullptr && QCoreApplication::instance()->thread() == thread;
+        threadName = isMainThread ? QString("Main") : QString("Thread %1").arg(threadId);
+    }
+
+    if (!registry.freeBuffers.isEmpty()) {
+        // Spans the exited thread left behind stay exportable, under the new thread's name
+        holder.buffer = registry.freeBuffers.takeLast();
+        holder.buffer->setThreadName(threadName);
+    } else {
+        holder.buffer = new TraceBuffer(threadId, threadName);
+        registry.buffers.append(holder.buffer);
+    }
+
+    return holder.buffer;
+}
+
+TraceBuffer::TraceBuffer(int threadId, QString threadName)
+{
+    this->threadId = threadId;
+    this->threadName = threadName;
+}
+
+void TraceBuffer::append(const char *name, qint64 startNs, qint64 durationNs)
+{
+    quint64 index = head.loadRelaxed();
+
+    Slot &slot = events[index % TRACE_BUFFER_EVENTS];
+    slot.name.storeRelaxed(name);
+    slot.startNs.storeRelaxed(startNs);
+    slot.durationNs.storeRelaxed(durationNs);
+
+    head.storeRelease(index + 1);
+}
+
+QVector<TraceEvent> TraceBuffer::read() const
+{
+    quint64 last = head.loadAcquire();
+    quint64 first = (last > TRACE_BUFFER_EVENTS) ? last - TRACE_BUFFER_EVENTS : 0;
+
+    QVector<TraceEvent> copied;
+    copied.reserve(last - first);
+    for (quint64 i = first; i < last; i += 1) {
+        const Slot &slot = events[i % TRACE_BUFFER_EVENTS];
+
+        TraceEvent event;
+        event.name = slot.name.loadRelaxed();
+        event.startNs = slot.startNs.loadRelaxed();
+        event.durationNs = slot.durationNs.loadRelaxed();
+        copied.append(event);
+    }
+
+    // The writer kept going meanwhile. A slot it has reused, or is reusing, belongs to a newer span
+    std::atomic_thread_fence(std::memory_order_acquire);
+    quint64 written = head.loadRelaxed();
+    quint64 valid = (written + 1 > TRACE_BUFFER_EVENTS) ? written + 1 - TRACE_BUFFER_EVENTS : 0;
+    if (valid > first) {
+        copied.remove(0, (int) qMin<quint64>(valid - first, copied.count()));
+    }
+
+    return copied;
+}
+
+int TraceBuffer::getThreadId() const
+{
+    return threadId;
+}
+
+QString TraceBuffer::getThreadName() const
+{
+    return threadName;
+}
+
+void TraceBuffer::setThreadName(QString threadName)
+{
+    this->threadName = threadName;
+}
+
+void Tracing::setEnabled(bool enabled)
+{
+    Tracing::enabled.storeRelaxed(enabled ? 1 : 0);
+}
+
+void Tracing::record(const char *name, qint64 startNs, qint64 durationNs)
+{
+    getThreadBuffer()->append(name, startNs, durationNs);
+}
+
+void Tracing::clear()
+{
+    // Writers are never stopped, older spans are only hidden from the next export
+    getRegistry().sinceNs.storeRelaxed(now());
+}
+
+QJsonObject Tracing::toChromeTrace()
+{
+    TraceRegistry &registry = getRegistry();
+    QMutexLocker locker(&registry.mutex);
+
+    qint64 sinceNs = registry.sinceNs.loadRelaxed();
+    qint64 pid = QCoreApplication::applicationPid();
+
+    // Trace event format: complete ("X") events in microseconds, plus the thread names as metadata
+    QJsonArray traceEvents;
+    for (int i = 0; i < registry.buffers.count(); i += 1) {
+        TraceBuffer *buffer = registry.buffers[i];
+
+        QJsonObject threadName;
+        threadName["name"] = buffer->getThreadName();
+
+        QJsonObject metadata;
+        metadata["name"] = "thread_name";
+        metadata["ph"] = "M";
+        metadata["pid"] = pid;
+        metadata["tid"] = buffer->getThreadId();
+        metadata["args"] = threadName;
+        traceEvents.append(metadata);
+
+        QVector<TraceEvent> events = buffer->read();
+        for (int j = 0; j < events.count(); j += 1) {
+            if (events[j].startNs < sinceNs) {
+                continue;
+            }
+
+            QJsonObject event;
+            event["name"] = QString::fromLatin1(events[j].name);
+            event["cat"] = TRACE_CATEGORY;
+            event["ph"] = "X";
+            event["ts"] = events[j].startNs / 1000.0;
+            event["dur"] = events[j].durationNs / 1000.0;
+            event["pid"] = pid;
+            event["tid"] = buffer->getThreadId();
+            traceEvents.append(event);
+        }
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+
+    return trace;
+}
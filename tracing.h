@@ -0,0 +1,86 @@
+#include <QObject>
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QDeadlineTimer>
+#include <QJsonObject>
+#include <QVector>
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#define TRACE_ENV "GTA5ONLINE_WHITELIST_TRACE"
+#define TRACE_BUFFER_EVENTS 16384
+#define TRACE_CATEGORY "gta5online_whitelist"
+
+struct TraceEvent
+{
+    const char *name;
+    qint64 startNs;
+    qint64 durationNs;
+};
+
+/*
+ * The most recent spans of one thread. Only the owning thread writes, so
+ * recording is three relaxed stores and a release of the head. The exporter
+ * copies behind the writer and drops whatever may have been overwritten while
+ * it was copying.
+ */
+class TraceBuffer
+{
+public:
+    TraceBuffer(int threadId, QString threadName);
+    void append(const char *name, qint64 startNs, qint64 durationNs);
+    QVector<TraceEvent> read() const;
+    int getThreadId() const;
+    QString getThreadName() const;
+    void setThreadName(QString threadName);
+
+private:
+    struct Slot {
+        QAtomicPointer<const char> name;
+        QAtomicInteger<qint64> startNs;
+        QAtomicInteger<qint64> durationNs;
+    };
+
+    Slot events[TRACE_BUFFER_EVENTS];
+    QAtomicInteger<quint64> head;
+    int threadId;
+    QString threadName;
+};
+
+/*
+ * Process wide switch and export. Each thread gets its own buffer the first
+ * time it records, so spans never contend; only that registration and the
+ * export take a lock. The buffer of an exited thread is reused by the next
+ * one, so there are only as many buffers as threads ever recorded at once.
+ * Names must be string literals, they are kept as pointers.
+ */
+class Tracing
+{
+public:
+    static bool isEnabled() { return enabled.loadRelaxed() != 0; }
+    static void setEnabled(bool enabled);
+    static qint64 now() { return QDeadlineTimer::current(Qt::PreciseTimer).deadlineNSecs(); }
+    static void record(const char *name, qint64 startNs, qint64 durationNs);
+    static void clear();
+    static QJsonObject toChromeTrace();
+
+private:
+    static QAtomicInt enabled;
+};
+
+/* Records the scope it lives in as one span. While tracing is off it only reads the switch */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name) : name(name), startNs(Tracing::isEnabled() ? Tracing::now() : -1) {}
+    ~TraceSpan() { if (startNs >= 0) { Tracing::record(name, startNs, Tracing::now() - startNs); } }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char *name;
+    qint64 startNs;
+};
+
+#endif // TRACING_H
@@ -0,0 +1,293 @@
+#include "whitelistfile.h"
+
+#include <cstring>
+
+WhitelistFile::WhitelistFile(QObject *parent) : QObject(parent)
+{
+
+}
+
+WhitelistFile::~WhitelistFile()
+{
+    close();
+}
+
+quint32 WhitelistFile::getChecksum(const uchar *data, qint64 size)
+{
+    quint32 hash = 2166136261u;
+    for (qint64 i = 0; i < size; i += 1) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+bool WhitelistFile::write(QString filename, QList<AddressRange> ranges, QList<Address6Range> ranges6, QString *error)
+{
+    QByteArray buffer(WHITELIST_FILE_HEADER_SIZE + ranges.count() * WHITELIST_FILE_RANGE_SIZE + ranges6.count() * WHITELIST_FILE_RANGE6_SIZE, '\0');
+    uchar *data = (uchar *) buffer.data();
+
+    uchar *p = data + WHITELIST_FILE_HEADER_SIZE;
+    for (int i = 0; i < ranges.count(); i += 1) {
+        qToLittleEndian<quint32>(ranges[i].first, p);
+        qToLittleEndian<quint32>(ranges[i].second, p + 4);
+        p += WHITELIST_FILE_RANGE_SIZE;
+    }
+
+    for (int i = 0; i < ranges6.count(); i += 1) {
+        qToLittleEndian<quint64>(ranges6[i].first.hi, p);
+        qToLittleEndian<quint64>(ranges6[i].first.lo, p + 8);
+        qToLittleEndian<quint64>(ranges6[i].second.hi, p + 16);
+        qToLittleEndian<quint64>(ranges6[i].second.lo, p + 24);
+        p += WHITELIST_FILE_RANGE6_SIZE;
+    }
+
+    memcpy(data, WHITELIST_FILE_MAGIC, 4);
+    qToLittleEndian<quint32>(WHITELIST_FILE_VERSION, data + 4);
+    qToLittleEndian<quint32>(ranges.count(), data + 8);
+    qToLittleEndian<quint32>(ranges6.count(), data + 12);
+    qToLittleEndian<quint32>(getChecksum(data + WHITELIST_FILE_HEADER_SIZE, buffer.size() - WHITELIST_FILE_HEADER_SIZE), data + 16);
+
+    QSaveFile saveFile(filename);
+    if (!saveFile.open(QIODevice::WriteOnly)) {
+        if (error != nullptr) {
+            *error = QString("Unable to write to file\n%1").arg(filename);
+        }
+
+        return false;
+    }
+
+    saveFile.write(buffer);
+    if (!saveFile.commit()) {
+        if (error != nullptr) {
+            *error = QString("Unable to write to file\n%1\n\n%2").arg(filename).arg(saveFile.errorString());
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+bool WhitelistFile::write(QString filename, QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6, QString *error)
+{
+    QList<AddressRange> ranges;
+    QList<Address6Range> ranges6;
+    getAddressRanges(addresses, addresses6, &ranges, &ranges6);
+
+    return write(filename, ranges, ranges6, error);
+}
+
+void WhitelistFile::getAddressRanges(QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6, QList<AddressRange> *ranges, QList<Address6Range> *ranges6)
+{
+    QList<AddressRange> singleRanges;
+    singleRanges.reserve(addresses.count());
+    for (int i = 0; i < addresses.count(); i += 1) {
+        singleRanges.append(AddressRange(addresses[i].toUInt32(), addresses[i].toUInt32()));
+    }
+
+    QList<Address6Range> singleRanges6;
+    singleRanges6.reserve(addresses6.count());
+    for (int i = 0; i < addresses6.count(); i += 1) {
+        singleRanges6.append(Address6Range(addresses6[i], addresses6[i]));
+    }
+
+    *ranges = ScopeTool::mergeRanges(singleRanges);
+    *ranges6 = ScopeTool::mergeRanges6(singleRanges6);
+}
+
+bool WhitelistFile::open(QString filename)
+{
+    close();
+
+    file.setFileName(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = QString("Unable to read file\n%1").arg(filename);
+        return false;
+    }
+
+    qint64 size = file.size();
+    if (size < WHITELIST_FILE_HEADER_SIZE) {
+        error = QString("Not a whitelist file\n%1").arg(filename);
+        close();
+        return false;
+    }
+
+    const uchar *mapped = file.map(0, size);
+    if (mapped == nullptr) {
+        error = QString("Unable to map file\n%1").arg(filename);
+        close();
+        return false;
+    }
+
+    if (memcmp(mapped, WHITELIST_FILE_MAGIC, 4) != 0 || qFromLittleEndian<quint32>(mapped + 4) != WHITELIST_FILE_VERSION) {
+        error = QString("Unsupported whitelist file\n%1").arg(filename);
+        file.unmap((uchar *) mapped);
+        close();
+        return false;
+    }
+
+    quint32 count = qFromLittleEndian<quint32>(mapped + 8);
+    quint32 count6 = qFromLittleEndian<quint32>(mapped + 12);
+    qint64 expectedSize = WHITELIST_FILE_HEADER_SIZE + (qint64) count * WHITELIST_FILE_RANGE_SIZE + (qint64) count6 * WHITELIST_FILE_RANGE6_SIZE;
+    if (size != expectedSize || qFromLittleEndian<quint32>(mapped + 16) != getChecksum(mapped + WHITELIST_FILE_HEADER_SIZE, size - WHITELIST_FILE_HEADER_SIZE)) {
+        error = QString("Corrupted whitelist file\n%1").arg(filename);
+        file.unmap((uchar *) mapped);
+        close();
+        return false;
+    }
+
+    data = mapped;
+    rangeCount = count;
+    range6Count = count6;
+
+    // The scope computation relies on the ranges being sorted and apart
+    if (!isSorted()) {
+        error = QString("Corrupted whitelist file\n%1").arg(filename);
+        close();
+        return false;
+    }
+
+    error.clear();
+
+    return true;
+}
+
+void WhitelistFile::close()
+{
+    // The mapping has to go before the file can be replaced on Windows
+    if (data != nullptr) {
+        file.unmap((uchar *) data);
+    }
+
+    data = nullptr;
+    rangeCount = 0;
+    range6Count = 0;
+
+    if (file.isOpen()) {
+        file.close();
+    }
+}
+
+bool WhitelistFile::isSorted()
+{
+    for (int i = 0; i < rangeCount; i += 1) {
+        AddressRange range = getRange(i);
+        if (range.first > range.second || (i > 0 && getRange(i - 1).second >= range.first)) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < range6Count; i += 1) {
+        Address6Range range = getRange6(i);
+        if (range.first > range.second || (i > 0 && getRange6(i - 1).second >= range.first)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool WhitelistFile::isOpen()
+{
+    return data != nullptr;
+}
+
+QString WhitelistFile::getError()
+{
+    return error;
+}
+
+int WhitelistFile::getRangeCount()
+{
+    return rangeCount;
+}
+
+int WhitelistFile::getRange6Count()
+{
+    return range6Count;
+}
+
+AddressRange WhitelistFile::getRange(int index)
+{
+    const uchar *p = data + WHITELIST_FILE_HEADER_SIZE + index * WHITELIST_FILE_RANGE_SIZE;
+
+    return AddressRange(qFromLittleEndian<quint32>(p), qFromLittleEndian<quint32>(p + 4));
+}
+
+Address6Range WhitelistFile::getRange6(int index)
+{
+    const uchar *p = data + WHITELIST_FILE_HEADER_SIZE + rangeCount * WHITELIST_FILE_RANGE_SIZE + index * WHITELIST_FILE_RANGE6_SIZE;
+
+    Ipv6Address first(qFromLittleEndian<quint64>(p), qFromLittleEndian<quint64>(p + 8));
+    Ipv6Address last(qFromLittleEndian<quint64>(p + 16), qFromLittleEndian<quint64>(p + 24));
+
+    return Address6Range(first, last);
+}
+
+QList<AddressRange> WhitelistFile::getRanges()
+{
+    QList<AddressRange> ranges;
+    ranges.reserve(rangeCount);
+    for (int i = 0; i < rangeCount; i += 1) {
+        ranges.append(getRange(i));
+    }
+
+    return ranges;
+}
+
+QList<Address6Range> WhitelistFile::getRanges6()
+{
+    QList<Address6Range> ranges;
+    ranges.reserve(range6Count);
+    for (int i = 0; i < range6Count; i += 1) {
+        ranges.append(getRange6(i));
+    }
+
+    return ranges;
+}
+
+bool WhitelistFile::getAddresses(QVector<Ipv4Address> *addresses, QVector<Ipv6Address> *addresses6)
+{
+    // Ranges only ever come from single addresses, a huge one means the file was not written by us
+    for (int i = 0; i < rangeCount; i += 1) {
+        AddressRange range = getRange(i);
+        if (range.second - range.first >= WHITELIST_MAX_EXPANDED_RANGE) {
+            error = QString("The whitelist file holds a range that is too large to list\n%1").arg(file.fileName());
+            return false;
+        }
+    }
+
+    for (int i = 0; i < range6Count; i += 1) {
+        Address6Range range = getRange6(i);
+        quint64 sizeLo = range.second.lo - range.first.lo;
+        quint64 sizeHi = range.second.hi - range.first.hi - (range.second.lo < range.first.lo ? 1 : 0);
+        if (sizeHi != 0 || sizeLo >= WHITELIST_MAX_EXPANDED_RANGE) {
+            error = QString("The whitelist file holds a range that is too large to list\n%1").arg(file.fileName());
+            return false;
+        }
+    }
+
+    for (int i = 0; i < rangeCount; i += 1) {
+        AddressRange range = getRange(i);
+        for (Ipv4Address address(range.first); ; ++address) {
+            addresses->append(address);
+            if (address.toUInt32() == range.second) {
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < range6Count; i += 1) {
+        Address6Range range = getRange6(i);
+        for (Ipv6Address address = range.first; ; address = address.next()) {
+            addresses6->append(address);
+            if (address == range.second) {
+                break;
+            }
+        }
+    }
+
+    return true;
+}
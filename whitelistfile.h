@@ -0,0 +1,63 @@
+#include <QObject>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QVector>
+
+#include "scopetool.h"
+
+#ifndef WHITELISTFILE_H
+#define WHITELISTFILE_H
+
+#define WHITELIST_FILE_MAGIC "GWLB"
+#define WHITELIST_FILE_VERSION 1
+#define WHITELIST_FILE_HEADER_SIZE 32
+#define WHITELIST_FILE_RANGE_SIZE 8
+#define WHITELIST_FILE_RANGE6_SIZE 32
+#define WHITELIST_MAX_EXPANDED_RANGE 65536
+
+/*
+ * Binary whitelist, all fields little endian:
+ *   header  magic[4] version:u32 rangeCount:u32 range6Count:u32 checksum:u32 reserved[12]
+ *   ranges  rangeCount x (first:u32 last:u32)
+ *   ranges6 range6Count x (firstHi:u64 firstLo:u64 lastHi:u64 lastLo:u64)
+ * Ranges are sorted, merged and inclusive. The checksum is FNV-1a over everything after the header.
+ * The file is memory mapped and read in place.
+ */
+class WhitelistFile : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WhitelistFile(QObject *parent = nullptr);
+    ~WhitelistFile();
+
+    static bool write(QString filename, QList<AddressRange> ranges, QList<Address6Range> ranges6, QString *error = nullptr);
+    static bool write(QString filename, QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6, QString *error = nullptr);
+    static void getAddressRanges(QVector<Ipv4Address> addresses, QVector<Ipv6Address> addresses6, QList<AddressRange> *ranges, QList<Address6Range> *ranges6);
+
+    bool open(QString filename);
+    void close();
+    bool isOpen();
+    QString getError();
+    int getRangeCount();
+    int getRange6Count();
+    AddressRange getRange(int index);
+    Address6Range getRange6(int index);
+    QList<AddressRange> getRanges();
+    QList<Address6Range> getRanges6();
+    bool getAddresses(QVector<Ipv4Address> *addresses, QVector<Ipv6Address> *addresses6);
+
+private:
+    QFile file;
+    const uchar *data = nullptr;
+    int rangeCount = 0;
+    int range6Count = 0;
+    QString error;
+
+    static quint32 getChecksum(const uchar *data, qint64 size);
+    bool isSorted();
+};
+
+#endif // WHITELISTFILE_H
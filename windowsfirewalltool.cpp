@@ -0,0 +1,502 @@
+#include "windowsfirewalltool.h"
+
+WindowsFirewallTool::WindowsFirewallTool(QObject *parent) : FirewallTool(parent)
+{
+    initSuccess = init();
+
+    connect(this, &QObject::destroyed, this, &WindowsFirewallTool::onDestroyed);
+}
+
+void WindowsFirewallTool::onDestroyed()
+{
+    cleanup();
+}
+
+bool WindowsFirewallTool::init()
+{
+    HRESULT hr = S_OK;
+
+    // Initialize COM.
+    hrComInit = CoInitializeEx(0, COINIT_APARTMENTTHREADED);
+
+    // Ignore RPC_E_CHANGED_MODE; this just means that COM has already been
+    // initialized with a different mode. Since we don't care what the mode is,
+    // we'll just use the existing mode.
+    if (hrComInit != RPC_E_CHANGED_MODE) {
+        if (FAILED(hrComInit)) {
+            if (error != nullptr) {
+                error = QString("CoInitializeEx failed: %1").arg(formatHResult(hrComInit));
+            }
+
+            cleanup();
+            return false;
+        }
+    }
+
+    // Retrieve INetFwPolicy2
+    hr = WFCOMInitialize(&pNetFwPolicy2);
+    if (FAILED(hr)) {
+        cleanup();
+        return false;
+    }
+
+    return true;
+}
+
+QString WindowsFirewallTool::formatHResult(HRESULT hr)
+{
+    QString str = QtWin::errorStringFromHresult(hr);
+    if (str.isEmpty()) {
+        QString hex = QByteArray::number((qint32) hr, 16);
+        for (int i = 0; i < (HEX_MIN_LENGTH - hex.count()); i += 1) {
+            hex.prepend('0');
+        }
+        str = QString("0x%1").arg(hex);
+    }
+
+    return str;
+}
+
+void WindowsFirewallTool::cleanup()
+{
+    // Release INetFwPolicy2
+    if (pNetFwPolicy2 != NULL) {
+        pNetFwPolicy2->Release();
+    }
+
+    // Uninitialize COM.
+    if (SUCCEEDED(hrComInit)) {
+        CoUninitialize();
+    }
+}
+
+long WindowsFirewallTool::getCurrentProfiles()
+{
+    error.clear();
+
+    if (!initSuccess) {
+        return 0;
+    }
+
+    QString profile;
+
+    HRESULT hr = S_OK;
+
+    long CurrentProfilesBitMask = 0;
+
+    // Retrieve Current Profiles bitmask
+    hr = pNetFwPolicy2->get_CurrentProfileTypes(&CurrentProfilesBitMask);
+    if (FAILED(hr)) {
+        error = QString("get_CurrentProfileTypes failed: %1").arg(formatHResult(hr));
+    }
+
+    return CurrentProfilesBitMask;
+}
+
+HRESULT WindowsFirewallTool::WFCOMInitialize(INetFwPolicy2** ppNetFwPolicy2)
+{
+    HRESULT hr = S_OK;
+
+    hr = CoCreateInstance(
+        __uuidof(NetFwPolicy2),
+        NULL,
+        CLSCTX_INPROC_SERVER,
+        __uuidof(INetFwPolicy2),
+        (void**)ppNetFwPolicy2);
+
+    if (FAILED(hr)) {
+        error = QString("CoCreateInstance for INetFwPolicy2 failed: %1").arg(formatHResult(hr));
+    }
+
+    return hr;
+}
+
+bool WindowsFirewallTool::isProfileEnabled(Profile profile)
+{
+    error.clear();
+
+    if (!initSuccess) {
+        return false;
+    }
+
+    VARIANT_BOOL bIsEnabled = FALSE;
+
+    if (SUCCEEDED(pNetFwPolicy2->get_FirewallEnabled((NET_FW_PROFILE_TYPE2) profile, &bIsEnabled))) {
+        return bIsEnabled;
+    }
+
+    return false;
+}
+
+bool WindowsFirewallTool::hasRule(QString name)
+{
+    TraceSpan span("firewall.com.hasRule");
+
+    error.clear();
+
+    bool found = false;
+
+    HRESULT hr = S_OK;
+    INetFwRules *pFwRules = NULL;
+    INetFwRule *pFwRule = NULL;
+
+    BSTR bstrRuleName = SysAllocString(name.toStdWString().c_str());
+
+    hr = pNetFwPolicy2->get_Rules(&pFwRules);
+    if (FAILED(hr)) {
+        error = QString("get_Rules failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    hr = pFwRules->Item(bstrRuleName, &pFwRule);
+    if (FAILED(hr)) {
+        error = QString("Firewall Rule Item failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    found = (pFwRule != NULL);
+
+Cleanup:
+    // Free BSTR's
+    SysFreeString(bstrRuleName);
+
+    // Release the INetFwRule object
+    if (pFwRule != NULL) {
+        pFwRule->Release();
+    }
+
+    // Release the INetFwRules object
+    if (pFwRules != NULL) {
+        pFwRules->Release();
+    }
+
+    return found;
+}
+
+bool WindowsFirewallTool::removeRule(QString name)
+{
+    TraceSpan span("firewall.com.removeRule");
+
+    error.clear();
+
+    bool success = false;
+
+    HRESULT hr = S_OK;
+    INetFwRules *pFwRules = NULL;
+
+    BSTR bstrRuleName = SysAllocString(name.toStdWString().c_str());
+
+    hr = pNetFwPolicy2->get_Rules(&pFwRules);
+    if (FAILED(hr)) {
+        error = QString("get_Rules failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    hr = pFwRules->Remove(bstrRuleName);
+    if (FAILED(hr)) {
+        error = QString("Firewall Rule Remove failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    success = true;
+
+Cleanup:
+    // Free BSTR's
+    SysFreeString(bstrRuleName);
+
+    // Release the INetFwRules object
+    if (pFwRules != NULL) {
+        pFwRules->Release();
+    }
+
+    return success;
+}
+
+bool WindowsFirewallTool::addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled)
+{
+    TraceSpan span("firewall.com.addRule");
+
+    error.clear();
+
+    bool success = false;
+
+    HRESULT hr = S_OK;
+    INetFwRules *pFwRules = NULL;
+    INetFwRule *pFwRule = NULL;
+
+    BSTR bstrRuleName = SysAllocString(name.toStdWString().c_str());
+    BSTR bstrRuleDescription = SysAllocString(description.toStdWString().c_str());
+    BSTR bstrRuleGroup = SysAllocString(group.toStdWString().c_str());
+    BSTR bstrRuleApplication = SysAllocString(application.toStdWString().c_str());
+    BSTR bstrRuleLAddresses = SysAllocString(laddresses.toStdWString().c_str());
+    BSTR bstrRuleLPorts = SysAllocString(lports.toStdWString().c_str());
+    BSTR bstrRuleRAddresses = SysAllocString(raddresses.toStdWString().c_str());
+    BSTR bstrRuleRPorts = SysAllocString(rports.toStdWString().c_str());
+
+    long CurrentProfilesBitMask = getCurrentProfiles();
+
+    // When possible we avoid adding firewall rules to the Public profile.
+    // If Public is currently active and it is not the only active profile, we remove it from the bitmask
+    if ((CurrentProfilesBitMask & NET_FW_PROFILE2_PUBLIC) && (CurrentProfilesBitMask != NET_FW_PROFILE2_PUBLIC)) {
+        CurrentProfilesBitMask ^= NET_FW_PROFILE2_PUBLIC;
+    }
+
+    // Retrieve INetFwRules
+    hr = pNetFwPolicy2->get_Rules(&pFwRules);
+    if (FAILED(hr)) {
+        error = QString("get_Rules failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    // Create a new Firewall Rule object.
+    hr = CoCreateInstance(
+        __uuidof(NetFwRule),
+        NULL,
+        CLSCTX_INPROC_SERVER,
+        __uuidof(INetFwRule),
+        (void**)&pFwRule);
+    if (FAILED(hr)) {
+        error = QString("CoCreateInstance for Firewall Rule failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    // Populate the Firewall Rule object
+    pFwRule->put_Name(bstrRuleName);
+    pFwRule->put_Description(bstrRuleDescription);
+    if (!application.isEmpty()) {
+        pFwRule->put_ApplicationName(bstrRuleApplication);
+    }
+    pFwRule->put_Protocol(protocol);
+    pFwRule->put_LocalAddresses(bstrRuleLAddresses);
+    pFwRule->put_LocalPorts(bstrRuleLPorts);
+    pFwRule->put_RemoteAddresses(bstrRuleRAddresses);
+    pFwRule->put_RemotePorts(bstrRuleRPorts);
+    pFwRule->put_Direction((NET_FW_RULE_DIRECTION) direction);
+    pFwRule->put_Grouping(bstrRuleGroup);
+    pFwRule->put_Profiles(CurrentProfilesBitMask);
+    pFwRule->put_Action((NET_FW_ACTION) action);
+
+    if (enabled) {
+        pFwRule->put_Enabled(VARIANT_TRUE);
+    } else {
+        pFwRule->put_Enabled(VARIANT_FALSE);
+    }
+
+    // Add the Firewall Rule
+    hr = pFwRules->Add(pFwRule);
+    if (FAILED(hr)) {
+        error = QString("Firewall Rule Add failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    success = true;
+
+Cleanup:
+    // Free BSTR's
+    SysFreeString(bstrRuleName);
+    SysFreeString(bstrRuleDescription);
+    SysFreeString(bstrRuleGroup);
+    SysFreeString(bstrRuleApplication);
+    SysFreeString(bstrRuleLAddresses);
+    SysFreeString(bstrRuleLPorts);
+    SysFreeString(bstrRuleRAddresses);
+    SysFreeString(bstrRuleRPorts);
+
+    // Release the INetFwRule object
+    if (pFwRule != NULL) {
+        pFwRule->Release();
+    }
+
+    // Release the INetFwRules object
+    if (pFwRules != NULL) {
+        pFwRules->Release();
+    }
+
+    return success;
+}
+
+QList<FirewallRule> WindowsFirewallTool::enumerateRules(QString grouping, QString namePrefix, RuleFields fields)
+{
+    TraceSpan span("firewall.com.enumerateRules");
+
+    QList<FirewallRule> rules;
+
+    HRESULT hr = S_OK;
+
+    ULONG cFetched = 0;
+    VARIANT vars[RULE_BATCH_SIZE];
+
+    IUnknown *pEnumerator = NULL;
+    IEnumVARIANT *pVariant = NULL;
+
+    INetFwRules *pFwRules = NULL;
+
+    for (int i = 0; i < RULE_BATCH_SIZE; i += 1) {
+        VariantInit(&vars[i]);
+    }
+
+    // Retrieve INetFwRules
+    hr = pNetFwPolicy2->get_Rules(&pFwRules);
+    if (FAILED(hr)) {
+        error = QString("get_Rules failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    hr = pFwRules->get__NewEnum(&pEnumerator);
+    if (SUCCEEDED(hr) && pEnumerator != NULL) {
+        hr = pEnumerator->QueryInterface(__uuidof(IEnumVARIANT), (void **) &pVariant);
+    }
+
+    if (FAILED(hr) || pVariant == NULL) {
+        error = QString("Firewall Rules enumeration failed: %1").arg(formatHResult(hr));
+        goto Cleanup;
+    }
+
+    // Fetch the rules in batches, Next returns S_FALSE once fewer than requested are left
+    do {
+        cFetched = 0;
+        hr = pVariant->Next(RULE_BATCH_SIZE, vars, &cFetched);
+        if (FAILED(hr)) {
+            error = QString("Firewall Rules Next failed: %1").arg(formatHResult(hr));
+            break;
+        }
+
+        for (ULONG i = 0; i < cFetched; i += 1) {
+            INetFwRule *pFwRule = NULL;
+
+            if (SUCCEEDED(VariantChangeType(&vars[i], &vars[i], 0, VT_DISPATCH))
+                    && SUCCEEDED(V_DISPATCH(&vars[i])->QueryInterface(__uuidof(INetFwRule), reinterpret_cast<void**>(&pFwRule)))) {
+                if (isRuleMatch(pFwRule, grouping, namePrefix)) {
+                    rules.append(getRuleInfo(pFwRule, fields));
+                }
+
+                pFwRule->Release();
+            }
+
+            VariantClear(&vars[i]);
+        }
+    } while (hr == S_OK);
+
+Cleanup:
+    if (pEnumerator != NULL) {
+        pEnumerator->Release();
+    }
+
+    if (pVariant != NULL) {
+        pVariant->Release();
+    }
+
+    // Release the INetFwRules object
+    if (pFwRules != NULL) {
+        pFwRules->Release();
+    }
+
+    return rules;
+}
+
+bool WindowsFirewallTool::isRuleMatch(INetFwRule* FwRule, QString grouping, QString namePrefix)
+{
+    BSTR bstrVal = NULL;
+
+    // Only the properties needed by the filter are fetched before deciding
+    QString ruleGrouping;
+    if (!grouping.isEmpty() && SUCCEEDED(FwRule->get_Grouping(&bstrVal))) {
+        ruleGrouping = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    QString ruleName;
+    if (!namePrefix.isEmpty() && SUCCEEDED(FwRule->get_Name(&bstrVal))) {
+        ruleName = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    return matchesFilter(ruleName, ruleGrouping, grouping, namePrefix);
+}
+
+FirewallRule WindowsFirewallTool::getRuleInfo(INetFwRule* FwRule, RuleFields fields)
+{
+    FirewallRule ruleInfo;
+
+    VARIANT_BOOL bEnabled;
+    BSTR bstrVal;
+
+    long lVal = 0;
+
+    NET_FW_RULE_DIRECTION fwDirection;
+    NET_FW_ACTION fwAction;
+
+    if ((fields & FieldName) && SUCCEEDED(FwRule->get_Name(&bstrVal))) {
+        ruleInfo.name = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    if ((fields & FieldDescription) && SUCCEEDED(FwRule->get_Description(&bstrVal))) {
+        ruleInfo.description = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    if ((fields & FieldGrouping) && SUCCEEDED(FwRule->get_Grouping(&bstrVal))) {
+        ruleInfo.grouping = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    if ((fields & FieldApplicationName) && SUCCEEDED(FwRule->get_ApplicationName(&bstrVal))) {
+        ruleInfo.applicationName = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    if ((fields & (FieldProtocol | FieldLocalPorts | FieldRemotePorts)) && SUCCEEDED(FwRule->get_Protocol(&lVal))) {
+        ruleInfo.protocol = lVal;
+
+        // Ports are only defined for TCP/UDP style protocols
+        if (lVal != NET_FW_IP_VERSION_V4 && lVal != NET_FW_IP_VERSION_V6) {
+            if ((fields & FieldLocalPorts) && SUCCEEDED(FwRule->get_LocalPorts(&bstrVal))) {
+                ruleInfo.localPorts = bStrToQString(bstrVal);
+                SysFreeString(bstrVal);
+            }
+
+            if ((fields & FieldRemotePorts) && SUCCEEDED(FwRule->get_RemotePorts(&bstrVal))) {
+                ruleInfo.remotePorts = bStrToQString(bstrVal);
+                SysFreeString(bstrVal);
+            }
+        }
+    }
+
+    if ((fields & FieldLocalAddresses) && SUCCEEDED(FwRule->get_LocalAddresses(&bstrVal))) {
+        ruleInfo.localAddresses = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    if ((fields & FieldRemoteAddresses) && SUCCEEDED(FwRule->get_RemoteAddresses(&bstrVal))) {
+        ruleInfo.remoteAddresses = bStrToQString(bstrVal);
+        SysFreeString(bstrVal);
+    }
+
+    if ((fields & FieldProfiles) && SUCCEEDED(FwRule->get_Profiles(&lVal))) {
+        ruleInfo.profiles = lVal;
+    }
+
+    if ((fields & FieldDirection) && SUCCEEDED(FwRule->get_Direction(&fwDirection))) {
+        ruleInfo.direction = fwDirection;
+    }
+
+    if ((fields & FieldAction) && SUCCEEDED(FwRule->get_Action(&fwAction))) {
+        ruleInfo.action = fwAction;
+    }
+
+    if ((fields & FieldEnabled) && SUCCEEDED(FwRule->get_Enabled(&bEnabled))) {
+        ruleInfo.enabled = (bEnabled != VARIANT_FALSE);
+    }
+
+    return ruleInfo;
+}
+
+QString WindowsFirewallTool::bStrToQString(BSTR bstr)
+{
+    char *text = _com_util::ConvertBSTRToString(bstr);
+    QString str = QString(text);
+    delete[] text;
+
+    return str;
+}
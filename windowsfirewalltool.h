@@ -0,0 +1,52 @@
+#include <QObject>
+#include <QDebug>
+#include <QVariant>
+#include <QtWin>
+#include <QByteArray>
+
+#include <windows.h>
+#include <netfw.h>
+#include <comutil.h>
+#include <atlcomcli.h>
+
+#include "firewalltool.h"
+
+#ifndef WINDOWSFIREWALLTOOL_H
+#define WINDOWSFIREWALLTOOL_H
+
+#define HEX_MIN_LENGTH 8
+#define RULE_BATCH_SIZE 64
+
+class WindowsFirewallTool : public FirewallTool
+{
+    Q_OBJECT
+
+public:
+    explicit WindowsFirewallTool(QObject *parent = nullptr);
+    long getCurrentProfiles() override;
+    bool isProfileEnabled(Profile profile) override;
+    bool removeRule(QString name) override;
+    bool addRule(QString name, QString description, QString group, QString application, Protocol protocol, QString laddresses, QString lports, QString raddresses, QString rports, Direction direction, Action action, bool enabled) override;
+    bool hasRule(QString name) override;
+
+protected:
+    QList<FirewallRule> enumerateRules(QString grouping, QString namePrefix, RuleFields fields) override;
+
+private:
+    HRESULT hrComInit = S_OK;
+    INetFwPolicy2 *pNetFwPolicy2 = NULL;
+
+    HRESULT WFCOMInitialize(INetFwPolicy2** ppNetFwPolicy2);
+    void onDestroyed();
+    bool init();
+    void cleanup();
+    QString formatHResult(HRESULT hr);
+    bool isRuleMatch(INetFwRule* FwRule, QString grouping, QString namePrefix);
+    FirewallRule getRuleInfo(INetFwRule* FwRule, RuleFields fields);
+    QString bStrToQString(BSTR bstr);
+
+signals:
+
+};
+
+#endif // WINDOWSFIREWALLTOOL_H